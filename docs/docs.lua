@@ -366,6 +366,10 @@ local types = {
   luv_work_ctx_t = cls('userdata'),
   luv_thread_t = cls('userdata'),
   luv_sem_t = cls('userdata'),
+  luv_buffer_t = cls('userdata'),
+  luv_timer_wheel_t = cls('userdata'),
+  luv_hrtimer_t = cls('userdata'),
+  luv_future_t = cls('userdata'),
 
   threadargs = union('number', 'boolean', 'string', 'userdata'),
 
@@ -576,6 +580,10 @@ local doc = {
         - [Threading and synchronization utilities][]
         - [Miscellaneous utilities][]
         - [Metrics operations][]
+        - [Byte buffers][]
+        - [Timer wheels][]
+        - [High resolution timers][]
+        - [Futures][]
       ]],
     },
     {
@@ -702,6 +710,16 @@ local doc = {
             necessary to explicitly call `loop_close()`. Call this function only after the
             loop has finished executing and all open handles and requests have been closed,
             or it will return `EBUSY`.
+
+            luv keeps a few handles of its own, for example for `uv.defer()` and batched
+            reads. They close themselves once they have nothing left to do, so they
+            are gone when `uv.run()` returns. If the loop didn't run since they were
+            last used, `loop_close()` starts closing them and returns `EBUSY`. Run the
+            loop again, for example with `uv.run("nowait")`, and then call
+            `loop_close()` again.
+
+            A running `uv.future_timeout()` or `uv.stream_send_file()` also counts as
+            pending work.
           ]],
           returns = success_ret,
         },
@@ -782,6 +800,54 @@ local doc = {
           ]],
           returns = { { opt_str } },
         },
+        {
+          name = 'batch_callbacks',
+          desc = [[
+            Enables or disables batching of handle callbacks. When enabled, the
+            callbacks of handles (timers, reads, closes, ...) are queued as they
+            happen and the queue is run from a single protected call, once before
+            polling for I/O and once after, instead of setting up a protected call
+            for every callback. Request callbacks (`fs_*`, `write`, ...) are not
+            affected.
+
+            Callbacks still run in the order their events happened, and an error
+            raised by one is reported the same way as without batching; the
+            callbacks queued after it still run. Returns the previous setting.
+          ]],
+          notes = {
+            [[
+              A callback runs a little later than its event, so changes it makes,
+              such as `stream:read_stop()`, don't hold back events that were already
+              queued. Reads into a caller provided buffer are never queued, and neither are
+              the frames of a framed read, so stopping the stream from a frame's callback
+              keeps the frames after it until reading resumes.
+            ]],
+          },
+          params = {
+            { name = 'enable', type = 'boolean' },
+          },
+          returns = 'boolean',
+        },
+        {
+          name = 'defer',
+          desc = [[
+            Calls `callback` with the given arguments soon, without creating a
+            handle. Deferred calls run in the order they were made, from the same
+            queue as batched callbacks (see `uv.batch_callbacks()`): right after
+            the I/O of the current loop iteration, or before polling if the loop
+            is not past that point yet. While calls are waiting the loop doesn't
+            block for I/O.
+
+            Calls deferred by a deferred call run on the next drain of the queue,
+            so a function that keeps deferring itself doesn't starve I/O. An error
+            raised by a deferred call is reported like one raised by a callback.
+          ]],
+          params = {
+            cb({ { '...', 'any', 'passed to `uv.defer(callback, ...)`' } }),
+            { name = '...', type = 'any', desc = 'passed to `callback`' },
+          },
+          returns = success_ret,
+        },
         {
           name = 'loop_alive',
           desc = [[
@@ -873,7 +939,16 @@ local doc = {
       title = '`uv_req_t` - Base request',
       id = 'uv_req_t--base-request',
       class = 'uv_req_t',
-      desc = '`uv_req_t` is the base type for all libuv request types.',
+      desc = [[
+        `uv_req_t` is the base type for all libuv request types.
+
+        Wherever a request function takes a callback, a coroutine can be passed
+        instead. When the request completes the coroutine is resumed with the
+        arguments the callback would have received, without a closure being created
+        for the call. The coroutine is expected to yield right after starting the
+        request; `uv.await()` does both in one call. A [future][Futures] can be passed
+        as well and is resolved with those arguments.
+      ]],
       funcs = {
         {
           name = 'cancel',
@@ -903,6 +978,66 @@ local doc = {
             { 'integer', 'enum' },
           },
         },
+        {
+          name = 'req_pool_configure',
+          desc = [[
+            Set how many finished request records the loop keeps for reuse. Every request
+            (writes, file system operations, connects, DNS lookups, ...) needs a small
+            piece of bookkeeping next to its `uv_req_t` userdata; it is taken from this
+            per-loop cache and returned to it when the request completes, so steady
+            traffic doesn't allocate it again. A cap of `0` disables the cache.
+
+            Only this bookkeeping is cached. The `uv_req_t` userdata is the request object
+            returned to Lua, which may keep it after the request completes, so every request
+            still allocates one.
+          ]],
+          params = {
+            { name = 'max', type = 'integer' },
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'req_pool_stats',
+          desc = [[
+            Returns the cap and counters of the request cache. `hits` counts requests
+            that reused a cached record and `misses` counts requests that had to allocate
+            one.
+          ]],
+          returns = {
+            {
+              table({
+                { 'max', 'integer' },
+                { 'cached', 'integer' },
+                { 'hits', 'integer' },
+                { 'misses', 'integer' },
+              }),
+              'stats',
+            },
+          },
+        },
+        {
+          name = 'await',
+          desc = [[
+            Calls the request function `fn` with the given arguments followed by the
+            running coroutine, then yields until the request completes and returns the
+            arguments its callback would have received. If `fn` fails right away its
+            results are returned without yielding. Must be called from a coroutine.
+          ]],
+          example = [[
+            ```lua
+            coroutine.wrap(function()
+              local err, stat = uv.await(uv.fs_stat, "README.md")
+              assert(not err, err)
+              print(stat.size)
+            end)()
+            ```
+          ]],
+          params = {
+            { name = 'fn', type = fun({ { '...', 'any' } }) },
+            { name = '...', type = 'any', desc = 'passed to `fn`' },
+          },
+          returns = { { 'any', '...' } },
+        },
       },
     },
     {
@@ -1947,16 +2082,39 @@ local doc = {
         },
         {
           name = 'listen',
-          method_form = 'stream:listen(backlog, callback)',
+          method_form = 'stream:listen(backlog, [options], callback)',
           desc = [[
             Start listening for incoming connections. `backlog` indicates the number of
             connections the kernel might queue, same as `listen(2)`. When a new incoming
             connection is received the callback is called.
+
+            When `options.batch` is set, connections are accepted in C instead: a client
+            handle of the same type as `stream` is created and accepted for every incoming
+            connection, and the callback receives them as an array, either once `batch` of
+            them are ready or at the end of the loop iteration. Connections accepted
+            before an error are delivered before it. When `options.read` is also given,
+            reading is started on every accepted connection and `read` is called as
+            `read(client, err, data)`, so no extra call into Lua is needed per
+            connection.
           ]],
           params = {
             { name = 'stream', type = 'uv_stream_t' },
             { name = 'backlog', type = 'integer' },
-            cb_err(),
+            {
+              name = 'options',
+              type = opt(table({
+                { 'batch', opt_int },
+                {
+                  'read',
+                  opt(fun({
+                    { 'client', 'uv_stream_t' },
+                    { 'err', opt_str },
+                    { 'data', opt_str },
+                  })),
+                },
+              })),
+            },
+            cb_err({ { 'clients', opt('uv_stream_t[]') } }),
           },
           returns = success_ret,
         },
@@ -1989,19 +2147,62 @@ local doc = {
         },
         {
           name = 'read_start',
-          method_form = 'stream:read_start(callback)',
+          method_form = 'stream:read_start([options], callback)',
           desc = [[
             Read data from an incoming stream. The callback will be made several times until
             there is no more data to read or `uv.read_stop()` is called. When we've reached
             EOF, `data` will be `nil`.
+
+            When `options.buffer` is set, data is read straight into that `luv_buffer_t`
+            starting at `options.offset` (default `0`) instead of being copied into a new
+            Lua string. The callback then receives the buffer itself along with the
+            `offset` and `length` of the bytes just read; they are only valid until the
+            callback returns, as the next read reuses the same region.
+
+            When `options.batch` is `"string"` or `"array"`, everything read from the
+            stream during one loop iteration is collected and handed to the callback in a
+            single call at the end of that iteration, either concatenated into one string
+            or as an array of the individual chunks. Data collected before an EOF or error
+            is delivered first. `batch` cannot be combined with `buffer`.
+
+            When `options.frame` is set, the stream is cut into frames in C and the
+            callback only ever receives whole frames, without their delimiter or length
+            prefix. Exactly one of `frame.delimiter` (e.g. `"\n"` or `"\r\n"`),
+            `frame.length` (a `"u16be"`, `"u16le"`, `"u32be"` or `"u32le"` length prefix)
+            or `frame.size` (fixed size records) must be given. A frame whose payload
+            would exceed `frame.max` (default 1 MiB) fails the read with `EMSGSIZE` and
+            stops reading. At EOF, trailing data without a delimiter is delivered as a
+            last frame while incomplete length prefixed or fixed size frames are dropped.
+            The framing may be changed by calling `read_start` again from the callback;
+            it then applies to the data that follows. Framed reads can be combined with
+            `batch = "array"` but not with `buffer`.
           ]],
           params = {
             { name = 'stream', type = 'uv_stream_t' },
+            {
+              name = 'options',
+              type = opt(table({
+                { 'buffer', opt('luv_buffer_t') },
+                { 'offset', opt_int },
+                { 'batch', opt_str },
+                {
+                  'frame',
+                  opt(table({
+                    { 'delimiter', opt_str },
+                    { 'length', opt_str },
+                    { 'size', opt_int },
+                    { 'max', opt_int },
+                  })),
+                },
+              })),
+            },
             {
               name = 'callback',
               type = fun({
                 { 'err', opt_str },
-                { 'data', opt_str },
+                { 'data', opt(union('string', 'luv_buffer_t', 'string[]')) },
+                { 'offset', opt_int },
+                { 'length', opt_int },
               }),
             },
           },
@@ -2043,6 +2244,10 @@ local doc = {
             in, the C backend will use writev to send all strings in a single system call.
 
             The optional `callback` is for knowing when the write is complete.
+
+            If watermarks are set with `uv.stream_set_watermarks()`, a second value is
+            returned: `false` when the stream is above its high watermark and the caller
+            should wait for the drain callback before writing more, `true` otherwise.
           ]],
           params = {
             { name = 'stream', type = 'uv_stream_t' },
@@ -2156,6 +2361,192 @@ local doc = {
           },
           returns = 'integer',
         },
+        {
+          name = 'stream_cork',
+          method_form = 'stream:cork([auto])',
+          desc = [[
+            Hold back writes made on the stream. Each `uv.write()` still returns its
+            request right away, but the data is only handed to the operating system when
+            the stream is uncorked, as a single vectored write carrying the buffers of
+            every held write in order. The callback of each original write is still
+            called once that combined write completes.
+
+            When `auto` is `true`, the held writes are also issued at the end of every
+            loop iteration, so that everything written during one iteration goes out
+            together. The stream stays in this mode until `uv.stream_uncork()` is called.
+
+            Held writes are issued before `uv.shutdown()`, `uv.write2()`,
+            `uv.try_write()` and `uv.close()` so that ordering is preserved.
+            Closing the stream cancels them with `ECANCELED`, and writes made after
+            `uv.close()` fail with `EBADF`. If the combined write is refused by
+            libuv, the held writes get the error at the end of the loop iteration
+            rather than from within the call that issued them.
+          ]],
+          params = {
+            { name = 'stream', type = 'uv_stream_t' },
+            { name = 'auto', type = opt_bool, default = 'false' },
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'stream_uncork',
+          method_form = 'stream:uncork()',
+          desc = 'Issue the writes held by `uv.stream_cork()` and stop holding new ones.',
+          params = {
+            { name = 'stream', type = 'uv_stream_t' },
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'stream_set_watermarks',
+          method_form = 'stream:set_watermarks(high, [low], [callback])',
+          desc = [[
+            Set write watermarks on the stream. Once the bytes queued for writing
+            (including writes held by `uv.stream_cork()`) exceed `high`, `uv.write()` and
+            `uv.write2()` return `false` as a second value next to the request. When
+            enough of the queue has been flushed for it to fall to `low` or below, the
+            optional `callback` is called so the writer can resume. A `high` of `0`
+            removes the watermarks.
+
+            Returns `false` if the stream is already above `high`, `true` otherwise.
+          ]],
+          params = {
+            { name = 'stream', type = 'uv_stream_t' },
+            { name = 'high', type = 'integer' },
+            { name = 'low', type = opt_int, default = '0' },
+            cb({}, true),
+          },
+          returns = 'boolean',
+        },
+        {
+          name = 'stream_set_timeouts',
+          method_form = 'stream:set_timeouts(timeouts, [callback])',
+          desc = [[
+            Enforce deadlines on the stream in C, so idle or slow peers can be evicted
+            without a timer per stream. `timeouts.read_idle` is the time in milliseconds
+            the stream may read without receiving data, `timeouts.write_stall` the time
+            its queued writes may go without any progress. A value of `0` or `nil`
+            turns a deadline off. Reading data, writes completing and bytes leaving the
+            write queue start the periods over.
+            `read_idle` only runs while the stream is reading, whether reading was
+            started before or after the timeouts were set.
+
+            All streams of a loop are checked by one shared timer, so a deadline may be
+            reported up to an eighth of the shortest timeout late. When one passes the
+            optional `callback` is called with `"read_idle"` or `"write_stall"` and the
+            period starts over. Without a `callback` the stream is closed instead.
+          ]],
+          params = {
+            { name = 'stream', type = 'uv_stream_t' },
+            {
+              name = 'timeouts',
+              type = table({
+                { 'read_idle', opt_int },
+                { 'write_stall', opt_int },
+              }),
+            },
+            cb({ { 'kind', 'string' } }, true),
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'pipe_streams',
+          desc = [[
+            Relay everything read from `src` to `dst` in C, without calling into Lua
+            for each chunk. Reading from `src` pauses while more than `options.high`
+            bytes (default 256 KiB) are queued for writing on `dst` and resumes once
+            the queue has drained to `options.low` (default half of `high`). When
+            `options.shutdown` is `true`, `dst` is shut down with `uv.shutdown()` after
+            `src` reaches EOF.
+
+            The optional `callback` is called once the relay is over, with the number of
+            bytes written to `dst`. It ends without error at EOF of `src` (after the
+            shutdown, if requested) and with an error when reading, writing or the
+            shutdown fails or either stream is closed. A stream can only be the source
+            of one relay and the destination of one relay at a time, and `src` must not
+            be reading already; while it is relayed, `uv.read_start()` and
+            `uv.read_stop()` fail with `EBUSY`. Lua may still write to `dst`.
+          ]],
+          params = {
+            { name = 'src', type = 'uv_stream_t' },
+            { name = 'dst', type = 'uv_stream_t' },
+            {
+              name = 'options',
+              type = opt(table({
+                { 'high', opt_int },
+                { 'low', opt_int },
+                { 'shutdown', opt_bool },
+              })),
+            },
+            cb_err({ { 'bytes', 'integer' } }, true),
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'stream_send_file',
+          method_form = 'stream:send_file(fd, offset, length, [callback])',
+          desc = [[
+            Send `length` bytes of the open file `fd`, starting at `offset`, over the
+            stream without copying them through Lua. On Linux, TCP and pipe streams hand
+            the file to `sendfile(2)` each time the stream is writable, so the data goes
+            straight from the page cache to the socket and partial sends resume where
+            they stopped. When `sendfile(2)` can't be used (other platforms, TTYs or a
+            file the kernel refuses), the file is read into pooled buffers on the
+            threadpool and written one chunk at a time.
+
+            Writes made on the stream while the file is sent are held and go out after
+            it. Only one file can be sent on a stream at a time. The optional `callback`
+            is called with the number of bytes sent once the file is out, the end of the
+            file is reached, an error occurs or the stream is closed.
+          ]],
+          params = {
+            { name = 'stream', type = 'uv_stream_t' },
+            { name = 'fd', type = 'integer' },
+            { name = 'offset', type = 'integer' },
+            { name = 'length', type = 'integer' },
+            cb_err({ { 'bytes', 'integer' } }, true),
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'buffer_pool_configure',
+          desc = [[
+            Configure the pool of read buffers shared by every stream on the loop.
+            Stream reads take their buffer from this pool and give it back as soon as
+            the data has been copied into a Lua string, so busy connections don't pay
+            for a `malloc`/`free` pair on every read.
+
+            `size` is the size in bytes of every pooled buffer (default 65536, at least
+            64) and `max` is the number of free buffers the pool keeps cached (default
+            16, `0` disables caching). Omitted values keep their current setting.
+            Changing `size` releases all cached buffers.
+          ]],
+          params = {
+            { name = 'size', type = opt_int },
+            { name = 'max', type = opt_int },
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'buffer_pool_stats',
+          desc = [[
+            Returns the current configuration and counters of the read buffer pool.
+            `hits` counts reads that reused a cached buffer and `misses` counts reads
+            that had to allocate one.
+          ]],
+          returns = {
+            {
+              table({
+                { 'size', 'integer' },
+                { 'max', 'integer' },
+                { 'cached', 'integer' },
+                { 'hits', 'integer' },
+                { 'misses', 'integer' },
+              }),
+              'stats',
+            },
+          },
+        },
       },
     },
     {
@@ -3268,10 +3659,12 @@ local doc = {
         },
         {
           name = 'fs_poll_start',
-          method_form = 'fs_poll:start(path, interval, callback)',
+          method_form = 'fs_poll:start(path, interval, [fields], callback)',
           desc = [[
             Check the file at `path` for changes every `interval` milliseconds.
 
+            `fields` selects the fields of `prev` and `curr` as for `uv.fs_stat()`.
+
             **Note:** For maximum portability, use multi-second intervals. Sub-second
             intervals will not detect all changes on many file systems.
           ]],
@@ -3279,6 +3672,7 @@ local doc = {
             { name = 'fs_poll', type = 'uv_fs_poll_t' },
             { name = 'path', type = 'string' },
             { name = 'interval', type = 'integer' },
+            { name = 'fields', type = opt('string[]') },
             cb_err({
               { 'prev', opt('table'), '(see `uv.fs_stat`)' },
               { 'curr', opt('table'), '(see `uv.fs_stat`)' },
@@ -3409,6 +3803,28 @@ local doc = {
           returns_sync = ret_or_fail('string', 'data'),
           returns_async = 'uv_fs_t',
         },
+        {
+          name = 'fs_read_into',
+          desc = [[
+              Like `uv.fs_read()`, but reads into `buffer` at `buf_offset` instead of
+              returning a new string, so one buffer can be reused for every read. At most
+              `len` bytes are read, by default up to the end of the buffer. Returns the
+              number of bytes read; 0 indicates EOF. The buffer is kept alive until the
+              read completes and should not be used for anything else until then.
+
+              If `file_offset` is nil or omitted, it will default to `-1`, which indicates 'use and update the current file offset.'
+            ]],
+          params = {
+            { name = 'fd', type = 'integer' },
+            { name = 'buffer', type = 'luv_buffer_t' },
+            { name = 'buf_offset', type = opt_int, default = '0' },
+            { name = 'len', type = opt_int },
+            { name = 'file_offset', type = opt_int },
+            async_cb({ { 'bytes', opt_int } }),
+          },
+          returns_sync = ret_or_fail('integer', 'bytes'),
+          returns_async = 'uv_fs_t',
+        },
         {
           name = 'fs_unlink',
           desc = 'Equivalent to `unlink(2)`.',
@@ -3529,9 +3945,18 @@ local doc = {
         -- fs_stat.result
         {
           name = 'fs_stat',
-          desc = 'Equivalent to `stat(2)`.',
+          desc = [[
+            Equivalent to `stat(2)`.
+
+            If `fields` is given, the result has only the fields it lists, which saves
+            building the rest. Besides the fields of the full table these can be
+            `atime_ns`, `mtime_ns`, `ctime_ns` and `birthtime_ns`, the timestamps as
+            integer nanoseconds. These need 64 bit integers and are only available with
+            Lua 5.3 and later, not with Lua 5.1, 5.2 or LuaJIT.
+          ]],
           params = {
             { name = 'path', type = 'string' },
+            { name = 'fields', type = opt('string[]') },
             async_cb({ { 'stat', opt('fs_stat.result') } }),
           },
           returns_sync = ret_or_fail('fs_stat.result', 'stat'),
@@ -3539,9 +3964,10 @@ local doc = {
         },
         {
           name = 'fs_fstat',
-          desc = 'Equivalent to `fstat(2)`.',
+          desc = 'Equivalent to `fstat(2)`. `fields` selects fields as for `uv.fs_stat()`.',
           params = {
             { name = 'fd', type = 'integer' },
+            { name = 'fields', type = opt('string[]') },
             async_cb({ { 'stat', opt('fs_stat.result') } }),
           },
           returns_sync = ret_or_fail('fs_stat.result', 'stat'),
@@ -3549,9 +3975,10 @@ local doc = {
         },
         {
           name = 'fs_lstat',
-          desc = 'Equivalent to `lstat(2)`.',
+          desc = 'Equivalent to `lstat(2)`. `fields` selects fields as for `uv.fs_stat()`.',
           params = {
             { name = 'path', type = 'string' },
+            { name = 'fields', type = opt('string[]') },
             async_cb({ { 'stat', opt('fs_stat.result') } }),
           },
           returns_sync = ret_or_fail('fs_stat.result', 'stat'),
@@ -3900,6 +4327,101 @@ local doc = {
           returns_sync = ret_or_fail('fs_statfs.result', 'stat'),
           returns_async = 'uv_fs_t',
         },
+        {
+          name = 'fs_readfile',
+          desc = [[
+            Reads the whole file at `path`. Opening, reading and closing run in one
+            threadpool task, so the callback is called once with the content.
+          ]],
+          params = {
+            { name = 'path', type = 'string' },
+            async_cb({ { 'data', opt_str } }),
+          },
+          returns_sync = ret_or_fail('string', 'data'),
+          returns_async = 'uv_work_t',
+        },
+        {
+          name = 'fs_writefile',
+          desc = [[
+            Writes `data` to the file at `path`, replacing its content, and returns the
+            number of bytes written. Opening, writing and closing run in one threadpool
+            task. `flags` are the `uv.fs_open()` flags, `"w"` by default, or a table
+            with those as `flags`, the `mode` a created file gets and `atomic`.
+
+            An atomic write goes to a temporary file next to `path` that is flushed to
+            disk and renamed over it, so readers see either the old or the new content.
+            It ignores `flags`. A new file gets `mode` less the umask like a plain
+            write. An existing file is replaced rather than rewritten: its mode is
+            copied to the new file, and so is its owner when the process may set it,
+            but other metadata such as hard links is not kept. It needs libuv 1.34.0
+            or later and fails with `ENOTSUP` otherwise. If the `flags` parameter is
+            omitted, then the 3rd parameter will be treated as the `callback`.
+          ]],
+          params = {
+            { name = 'path', type = 'string' },
+            { name = 'data', type = 'string' },
+            {
+              name = 'flags',
+              type = opt(union(
+                'string',
+                'integer',
+                table({
+                  { 'flags', opt(union('string', 'integer')) },
+                  { 'mode', opt_int, '0644' },
+                  { 'atomic', opt_bool },
+                })
+              )),
+              default = '"w"',
+            },
+            async_cb({ { 'bytes', opt_int } }),
+          },
+          returns_sync = ret_or_fail('integer', 'bytes'),
+          returns_async = 'uv_work_t',
+        },
+        {
+          name = 'fs_walk',
+          desc = [[
+            Walks the directory tree under `root` in the threadpool and calls `callback`
+            with its entries in batches: `names` holds the paths relative to `root` and
+            `types` their types, as in `uv.fs_scandir_next()`. A directory that can't be
+            read is reported by a call with just `err`, and the walk goes on. The last
+            call has neither `names` nor `err`.
+
+            Each threadpool task reads directories depth first until it has at least
+            `batch` entries, so a tree costs one callback per batch rather than one per
+            directory. With `parallel` above 1, up to that many tasks read different
+            subtrees at the same time.
+
+            - `max_depth` limits how deep the walk goes, `1` being the entries of `root`
+              only. `0` means no limit.
+            - `follow_symlinks` walks into linked directories, skipping links back to a
+              directory above, and reports links by the type of their target.
+            - `prefix` keeps only paths that start with it and skips directories off it.
+            - `glob` keeps only entries whose name matches it, where `*` matches any run
+              of characters and `?` any one character. Directories are still walked.
+
+            If the `opts` parameter is omitted, then the 2nd parameter will be treated as the `callback`.
+          ]],
+          params = {
+            { name = 'root', type = 'string' },
+            {
+              name = 'opts',
+              type = opt(table({
+                { 'max_depth', opt_int, '0' },
+                { 'follow_symlinks', opt_bool },
+                { 'prefix', opt_str },
+                { 'glob', opt_str },
+                { 'batch', opt_int, '1024' },
+                { 'parallel', opt_int, '1' },
+              })),
+            },
+            cb_err({
+              { 'names', opt('string[]') },
+              { 'types', opt('string[]') },
+            }),
+          },
+          returns = success_ret,
+        },
       },
     },
     {
@@ -4813,6 +5335,342 @@ local doc = {
         },
       },
     },
+    {
+      title = 'Byte buffers',
+      id = 'byte-buffers',
+      desc = [[
+        A `luv_buffer_t` is a fixed-size block of memory owned by Lua. It can be handed
+        to `uv.read_start()` so that incoming stream data is written into it directly,
+        avoiding an intermediate Lua string per read. Offsets are zero-based.
+      ]],
+      funcs = {
+        {
+          name = 'new_buffer',
+          desc = 'Creates a zero-filled buffer of `size` bytes.',
+          params = {
+            { name = 'size', type = 'integer' },
+          },
+          returns = { { 'luv_buffer_t', 'buffer' } },
+        },
+        {
+          name = 'buffer_size',
+          method_form = 'buffer:size()',
+          desc = 'Returns the size of the buffer in bytes. Equivalent to `#buffer`.',
+          params = {
+            { name = 'buffer', type = 'luv_buffer_t' },
+          },
+          returns = 'integer',
+        },
+        {
+          name = 'buffer_get_string',
+          method_form = 'buffer:get_string([offset], [length])',
+          desc = [[
+            Copies `length` bytes starting at `offset` out of the buffer into a Lua
+            string. `offset` defaults to `0` and `length` to the rest of the buffer.
+          ]],
+          params = {
+            { name = 'buffer', type = 'luv_buffer_t' },
+            { name = 'offset', type = opt_int, default = '0' },
+            { name = 'length', type = opt_int },
+          },
+          returns = 'string',
+        },
+        {
+          name = 'buffer_set_string',
+          method_form = 'buffer:set_string(offset, data)',
+          desc = [[
+            Copies `data` into the buffer starting at `offset` and returns the number of
+            bytes written. It is an error for `data` to extend past the end of the buffer.
+          ]],
+          params = {
+            { name = 'buffer', type = 'luv_buffer_t' },
+            { name = 'offset', type = 'integer' },
+            { name = 'data', type = 'string' },
+          },
+          returns = 'integer',
+        },
+      },
+    },
+    {
+      title = 'Timer wheels',
+      id = 'timer-wheels',
+      desc = [[
+        A `luv_timer_wheel_t` manages many one-shot timers without a handle for each
+        of them, e.g. one idle timeout per connection. Starting, stopping and
+        restarting a timer takes constant time. The wheel is driven by a single
+        internal timer that ticks every `tick_ms` while any timer is started, and
+        timeouts are rounded up to whole ticks.
+
+        Timers are identified by integer ids. An id goes stale once its timer fired
+        or was stopped. While a timer is started the wheel keeps the loop alive
+        and is not garbage collected. A wheel that is no longer needed can be closed
+        right away, otherwise a stopped wheel is released when it is collected or
+        when the loop is closed.
+      ]],
+      funcs = {
+        {
+          name = 'new_timer_wheel',
+          desc = [[
+            Creates a timer wheel with a resolution of `tick_ms` milliseconds. The
+            callback is called with the timers that expired in a tick as one batch.
+          ]],
+          params = {
+            { name = 'tick_ms', type = 'integer' },
+            cb({
+              { 'expired', 'any[]', 'the value of each expired timer, or its id if it has none' },
+            }),
+          },
+          returns = { { 'luv_timer_wheel_t', 'wheel' } },
+        },
+        {
+          name = 'timer_wheel_start',
+          method_form = 'wheel:start(timeout, [value])',
+          desc = [[
+            Starts a timer that expires after `timeout` milliseconds and returns its
+            id. `value` is handed to the callback when the timer expires.
+          ]],
+          params = {
+            { name = 'wheel', type = 'luv_timer_wheel_t' },
+            { name = 'timeout', type = 'integer' },
+            { name = 'value', type = opt('any') },
+          },
+          returns = { { 'integer', 'id' } },
+        },
+        {
+          name = 'timer_wheel_restart',
+          method_form = 'wheel:restart(id, timeout)',
+          desc = [[
+            Makes a started timer expire `timeout` milliseconds from now instead. Returns
+            `false` if the id is stale.
+          ]],
+          params = {
+            { name = 'wheel', type = 'luv_timer_wheel_t' },
+            { name = 'id', type = 'integer' },
+            { name = 'timeout', type = 'integer' },
+          },
+          returns = 'boolean',
+        },
+        {
+          name = 'timer_wheel_stop',
+          method_form = 'wheel:stop(id)',
+          desc = 'Stops a timer. Returns `false` if the id is stale.',
+          params = {
+            { name = 'wheel', type = 'luv_timer_wheel_t' },
+            { name = 'id', type = 'integer' },
+          },
+          returns = 'boolean',
+        },
+        {
+          name = 'timer_wheel_count',
+          method_form = 'wheel:count()',
+          desc = 'Returns the number of started timers.',
+          params = {
+            { name = 'wheel', type = 'luv_timer_wheel_t' },
+          },
+          returns = 'integer',
+        },
+        {
+          name = 'timer_wheel_close',
+          method_form = 'wheel:close()',
+          desc = 'Stop every timer without calling back and release the wheel. The wheel can no longer be used.',
+          params = {
+            { name = 'wheel', type = 'luv_timer_wheel_t' },
+          },
+        },
+      },
+    },
+    {
+      title = 'High resolution timers',
+      id = 'hrtimers',
+      desc = [[
+        A `luv_hrtimer_t` is a timer with deadlines in nanoseconds, measured on the
+        same clock as `uv.hrtime()`, for pacing that milliseconds are too coarse for.
+        On Linux it is backed by a `timerfd`. Elsewhere it falls back to a libuv timer
+        and fires within a millisecond after its deadline.
+
+        A repeating timer keeps its deadlines at `timeout + n * repeat` from the time
+        it was started, so a late callback doesn't delay the ones after it. While
+        started the timer keeps the loop alive and is not garbage collected.
+      ]],
+      funcs = {
+        {
+          name = 'new_hrtimer',
+          desc = 'Creates a new high resolution timer.',
+          returns = ret_or_fail('luv_hrtimer_t', 'hrtimer'),
+        },
+        {
+          name = 'hrtimer_start',
+          method_form = 'hrtimer:start(timeout, repeat, callback)',
+          desc = [[
+            Start the timer. `timeout` and `repeat` are in nanoseconds. If `repeat` is
+            non-zero, the timer fires first after `timeout` nanoseconds and then every
+            `repeat` nanoseconds. Starting a started timer sets its deadlines anew.
+
+            The callback receives the number of deadlines that passed since the last call,
+            which is more than 1 if the loop was too busy to run it in time.
+          ]],
+          params = {
+            { name = 'hrtimer', type = 'luv_hrtimer_t' },
+            { name = 'timeout', type = 'integer' },
+            { name = 'repeat', type = 'integer' },
+            cb({
+              { 'count', 'integer', 'the number of deadlines that passed' },
+            }),
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'hrtimer_stop',
+          method_form = 'hrtimer:stop()',
+          desc = 'Stop the timer.',
+          params = {
+            { name = 'hrtimer', type = 'luv_hrtimer_t' },
+          },
+          returns = success_ret,
+        },
+        {
+          name = 'hrtimer_get_due_in',
+          method_form = 'hrtimer:get_due_in()',
+          desc = 'Get the nanoseconds until the next deadline, or 0 if it has passed or the timer is stopped.',
+          params = {
+            { name = 'hrtimer', type = 'luv_hrtimer_t' },
+          },
+          returns = { { 'integer', 'due_in' } },
+        },
+        {
+          name = 'hrtimer_close',
+          method_form = 'hrtimer:close()',
+          desc = 'Stop the timer and release its resources. The timer can no longer be used.',
+          params = {
+            { name = 'hrtimer', type = 'luv_hrtimer_t' },
+          },
+        },
+      },
+    },
+    {
+      title = 'Futures',
+      id = 'futures',
+      desc = [[
+        A `luv_future_t` holds the result of an operation that has not finished yet.
+        It is resolved once with a list of values, normally by passing it to a request
+        function in place of the callback, which resolves it with the arguments the
+        callback would have received. Functions and coroutines waiting for it are then
+        called with those values.
+
+        The combinators make a future out of others and are resolved in C as those
+        settle, so Lua code only runs once for the combined result. Like the error
+        argument of a callback, a first value that is not `nil` counts as failure.
+
+        ```lua
+        local list = {}
+        for i, path in ipairs({ "a.txt", "b.txt", "c.txt" }) do
+          list[i] = uv.new_future()
+          uv.fs_stat(path, list[i])
+        end
+        uv.future_timeout(uv.future_all(list), 1000):wait(function(err, stats)
+          assert(not err, err)
+          print(stats[1].size, stats[2].size, stats[3].size)
+        end)
+        ```
+      ]],
+      funcs = {
+        {
+          name = 'new_future',
+          desc = 'Creates a new unresolved future.',
+          returns = { { 'luv_future_t', 'future' } },
+        },
+        {
+          name = 'future_resolve',
+          method_form = 'future:resolve(...)',
+          desc = [[
+            Resolve the future with the given values. Returns `false` if it was resolved
+            already, in which case the values are dropped.
+          ]],
+          params = {
+            { name = 'future', type = 'luv_future_t' },
+            { name = '...', type = 'any' },
+          },
+          returns = { { 'boolean', 'resolved' } },
+        },
+        {
+          name = 'future_wait',
+          method_form = 'future:wait(continuation)',
+          desc = [[
+            Call a function, resume a coroutine or resolve another future with the values
+            of the future once it is resolved. If it is resolved already, functions and
+            coroutines are called on the next loop iteration like with `uv.defer()`, so
+            `uv.await(uv.future_wait, future)` works either way.
+          ]],
+          params = {
+            { name = 'future', type = 'luv_future_t' },
+            {
+              name = 'continuation',
+              type = union(fun({ { '...', 'any' } }), 'thread', 'luv_future_t'),
+            },
+          },
+          returns = { { 'luv_future_t', 'future' } },
+        },
+        {
+          name = 'future_get',
+          method_form = 'future:get()',
+          desc = 'Returns whether the future is resolved, followed by its values if it is.',
+          params = {
+            { name = 'future', type = 'luv_future_t' },
+          },
+          returns = { { 'boolean', 'resolved' }, { 'any', '...' } },
+        },
+        {
+          name = 'future_all',
+          desc = [[
+            Returns a future resolved when all futures in the list have succeeded, with
+            `nil` and a table holding the second value of each in list order (the first
+            result after the error argument), with its length in the field `n`. As soon as
+            one fails it is resolved with the values of that one instead. An empty list
+            resolves it right away.
+          ]],
+          params = {
+            { name = 'futures', type = 'luv_future_t[]' },
+          },
+          returns = { { 'luv_future_t', 'future' } },
+        },
+        {
+          name = 'future_any',
+          desc = [[
+            Returns a future resolved with the values of the first future in the list that
+            succeeds, or with those of the last to fail if none does.
+          ]],
+          params = {
+            { name = 'futures', type = 'luv_future_t[]' },
+          },
+          returns = { { 'luv_future_t', 'future' } },
+        },
+        {
+          name = 'future_race',
+          desc = [[
+            Returns a future resolved with the values of the first future in the list to
+            be resolved, whether it succeeded or not.
+          ]],
+          params = {
+            { name = 'futures', type = 'luv_future_t[]' },
+          },
+          returns = { { 'luv_future_t', 'future' } },
+        },
+        {
+          name = 'future_timeout',
+          method_form = 'future:timeout(timeout)',
+          desc = [[
+            Returns a future resolved with the values of `future`, or with `"ETIMEDOUT"` if
+            that is not resolved within `timeout` milliseconds. The timer is internal and
+            keeps the loop alive until one of them happens.
+          ]],
+          params = {
+            { name = 'future', type = 'luv_future_t' },
+            { name = 'timeout', type = 'integer' },
+          },
+          returns = { { 'luv_future_t', 'future' } },
+        },
+      },
+    },
     {
       title = 'String manipulation functions',
       desc = [[
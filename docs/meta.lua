@@ -116,6 +116,10 @@ uv.constants = {}
 --- - [Threading and synchronization utilities][]
 --- - [Miscellaneous utilities][]
 --- - [Metrics operations][]
+--- - [Byte buffers][]
+--- - [Timer wheels][]
+--- - [High resolution timers][]
+--- - [Futures][]
 
 --- # Constants
 ---
@@ -346,6 +350,16 @@ function uv.version_string() end
 --- necessary to explicitly call `loop_close()`. Call this function only after the
 --- loop has finished executing and all open handles and requests have been closed,
 --- or it will return `EBUSY`.
+---
+--- luv keeps a few handles of its own, for example for `uv.defer()` and batched
+--- reads. They close themselves once they have nothing left to do, so they
+--- are gone when `uv.run()` returns. If the loop didn't run since they were
+--- last used, `loop_close()` starts closing them and returns `EBUSY`. Run the
+--- loop again, for example with `uv.run("nowait")`, and then call
+--- `loop_close()` again.
+---
+--- A running `uv.future_timeout()` or `uv.stream_send_file()` also counts as
+--- pending work.
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
@@ -411,6 +425,43 @@ function uv.loop_configure(option, ...) end
 --- @return string?
 function uv.loop_mode() end
 
+--- Enables or disables batching of handle callbacks. When enabled, the
+--- callbacks of handles (timers, reads, closes, ...) are queued as they
+--- happen and the queue is run from a single protected call, once before
+--- polling for I/O and once after, instead of setting up a protected call
+--- for every callback. Request callbacks (`fs_*`, `write`, ...) are not
+--- affected.
+---
+--- Callbacks still run in the order their events happened, and an error
+--- raised by one is reported the same way as without batching; the
+--- callbacks queued after it still run. Returns the previous setting.
+--- **Note**:
+--- A callback runs a little later than its event, so changes it makes,
+--- such as `stream:read_stop()`, don't hold back events that were already
+--- queued. Reads into a caller provided buffer are never queued, and neither are
+--- the frames of a framed read, so stopping the stream from a frame's callback
+--- keeps the frames after it until reading resumes.
+--- @param enable boolean
+--- @return boolean
+function uv.batch_callbacks(enable) end
+
+--- Calls `callback` with the given arguments soon, without creating a
+--- handle. Deferred calls run in the order they were made, from the same
+--- queue as batched callbacks (see `uv.batch_callbacks()`): right after
+--- the I/O of the current loop iteration, or before polling if the loop
+--- is not past that point yet. While calls are waiting the loop doesn't
+--- block for I/O.
+---
+--- Calls deferred by a deferred call run on the next drain of the queue,
+--- so a function that keeps deferring itself doesn't starve I/O. An error
+--- raised by a deferred call is reported like one raised by a callback.
+--- @param callback fun(...: any)
+--- @param ... any passed to `callback`
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.defer(callback, ...) end
+
 --- Returns `true` if there are referenced active handles, active requests, or
 --- closing handles in the loop; otherwise, `false`.
 --- @return boolean? alive
@@ -473,6 +524,13 @@ function uv.walk(callback) end
 --- # `uv_req_t` - Base request
 ---
 --- `uv_req_t` is the base type for all libuv request types.
+---
+--- Wherever a request function takes a callback, a coroutine can be passed
+--- instead. When the request completes the coroutine is resumed with the
+--- arguments the callback would have received, without a closure being created
+--- for the call. The coroutine is expected to yield right after starting the
+--- request; `uv.await()` does both in one call. A [future][Futures] can be passed
+--- as well and is resolved with those arguments.
 --- @class uv.uv_req_t : userdata
 local uv_req_t = {}
 
@@ -506,6 +564,50 @@ function uv.req_get_type(req) end
 --- @return integer enum
 function uv_req_t:get_type() end
 
+--- Set how many finished request records the loop keeps for reuse. Every request
+--- (writes, file system operations, connects, DNS lookups, ...) needs a small
+--- piece of bookkeeping next to its `uv_req_t` userdata; it is taken from this
+--- per-loop cache and returned to it when the request completes, so steady
+--- traffic doesn't allocate it again. A cap of `0` disables the cache.
+---
+--- Only this bookkeeping is cached. The `uv_req_t` userdata is the request object
+--- returned to Lua, which may keep it after the request completes, so every request
+--- still allocates one.
+--- @param max integer
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.req_pool_configure(max) end
+
+--- @class uv.req_pool_stats.stats
+--- @field max integer
+--- @field cached integer
+--- @field hits integer
+--- @field misses integer
+
+--- Returns the cap and counters of the request cache. `hits` counts requests
+--- that reused a cached record and `misses` counts requests that had to allocate
+--- one.
+--- @return uv.req_pool_stats.stats stats
+function uv.req_pool_stats() end
+
+--- Calls the request function `fn` with the given arguments followed by the
+--- running coroutine, then yields until the request completes and returns the
+--- arguments its callback would have received. If `fn` fails right away its
+--- results are returned without yielding. Must be called from a coroutine.
+---
+--- ```lua
+--- coroutine.wrap(function()
+---   local err, stat = uv.await(uv.fs_stat, "README.md")
+---   assert(not err, err)
+---   print(stat.size)
+--- end)()
+--- ```
+--- @param fn fun(...: any)
+--- @param ... any passed to `fn`
+--- @return any ...
+function uv.await(fn, ...) end
+
 
 --- # `uv_handle_t` - Base handle
 ---
@@ -1546,23 +1648,43 @@ function uv_stream_t:shutdown(callback) end
 --- Start listening for incoming connections. `backlog` indicates the number of
 --- connections the kernel might queue, same as `listen(2)`. When a new incoming
 --- connection is received the callback is called.
+---
+--- When `options.batch` is set, connections are accepted in C instead: a client
+--- handle of the same type as `stream` is created and accepted for every incoming
+--- connection, and the callback receives them as an array, either once `batch` of
+--- them are ready or at the end of the loop iteration. Connections accepted
+--- before an error are delivered before it. When `options.read` is also given,
+--- reading is started on every accepted connection and `read` is called as
+--- `read(client, err, data)`, so no extra call into Lua is needed per
+--- connection.
 --- @param stream uv.uv_stream_t
 --- @param backlog integer
---- @param callback fun(err: string?)
+--- @param options { batch: integer?, read: fun(client: uv.uv_stream_t, err: string?, data: string?)? }?
+--- @param callback fun(err: string?, clients: uv.uv_stream_t[]?)
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
-function uv.listen(stream, backlog, callback) end
+function uv.listen(stream, backlog, options, callback) end
 
 --- Start listening for incoming connections. `backlog` indicates the number of
 --- connections the kernel might queue, same as `listen(2)`. When a new incoming
 --- connection is received the callback is called.
+---
+--- When `options.batch` is set, connections are accepted in C instead: a client
+--- handle of the same type as `stream` is created and accepted for every incoming
+--- connection, and the callback receives them as an array, either once `batch` of
+--- them are ready or at the end of the loop iteration. Connections accepted
+--- before an error are delivered before it. When `options.read` is also given,
+--- reading is started on every accepted connection and `read` is called as
+--- `read(client, err, data)`, so no extra call into Lua is needed per
+--- connection.
 --- @param backlog integer
---- @param callback fun(err: string?)
+--- @param options { batch: integer?, read: fun(client: uv.uv_stream_t, err: string?, data: string?)? }?
+--- @param callback fun(err: string?, clients: uv.uv_stream_t[]?)
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
-function uv_stream_t:listen(backlog, callback) end
+function uv_stream_t:listen(backlog, options, callback) end
 
 --- This call is used in conjunction with `uv.listen()` to accept incoming
 --- connections. Call this function after receiving a callback to accept the
@@ -1607,9 +1729,48 @@ function uv.accept(stream, client_stream) end
 --- @return uv.error_name? err_name
 function uv_stream_t:accept(client_stream) end
 
+--- @alias uv.read_start.callback
+--- | fun(err: string?, data: string|uv.luv_buffer_t|string[]?, offset: integer?, length: integer?)
+
+--- @class uv.read_start.options
+--- @field buffer uv.luv_buffer_t?
+--- @field offset integer?
+--- @field batch string?
+--- @field frame uv.read_start.options.frame?
+
+--- @class uv.read_start.options.frame
+--- @field delimiter string?
+--- @field length string?
+--- @field size integer?
+--- @field max integer?
+
 --- Read data from an incoming stream. The callback will be made several times until
 --- there is no more data to read or `uv.read_stop()` is called. When we've reached
 --- EOF, `data` will be `nil`.
+---
+--- When `options.buffer` is set, data is read straight into that `luv_buffer_t`
+--- starting at `options.offset` (default `0`) instead of being copied into a new
+--- Lua string. The callback then receives the buffer itself along with the
+--- `offset` and `length` of the bytes just read; they are only valid until the
+--- callback returns, as the next read reuses the same region.
+
+--- When `options.batch` is `"string"` or `"array"`, everything read from the
+--- stream during one loop iteration is collected and handed to the callback in a
+--- single call at the end of that iteration, either concatenated into one string
+--- or as an array of the individual chunks. Data collected before an EOF or error
+--- is delivered first. `batch` cannot be combined with `buffer`.
+
+--- When `options.frame` is set, the stream is cut into frames in C and the
+--- callback only ever receives whole frames, without their delimiter or length
+--- prefix. Exactly one of `frame.delimiter` (e.g. `"\n"` or `"\r\n"`),
+--- `frame.length` (a `"u16be"`, `"u16le"`, `"u32be"` or `"u32le"` length prefix)
+--- or `frame.size` (fixed size records) must be given. A frame whose payload
+--- would exceed `frame.max` (default 1 MiB) fails the read with `EMSGSIZE` and
+--- stops reading. At EOF, trailing data without a delimiter is delivered as a
+--- last frame while incomplete length prefixed or fixed size frames are dropped.
+--- The framing may be changed by calling `read_start` again from the callback;
+--- it then applies to the data that follows. Framed reads can be combined with
+--- `batch = "array"` but not with `buffer`.
 --- Example
 --- ```lua
 --- stream:read_start(function (err, chunk)
@@ -1623,15 +1784,40 @@ function uv_stream_t:accept(client_stream) end
 --- end)
 --- ```
 --- @param stream uv.uv_stream_t
---- @param callback fun(err: string?, data: string?)
+--- @param options uv.read_start.options?
+--- @param callback uv.read_start.callback
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
-function uv.read_start(stream, callback) end
+function uv.read_start(stream, options, callback) end
 
 --- Read data from an incoming stream. The callback will be made several times until
 --- there is no more data to read or `uv.read_stop()` is called. When we've reached
 --- EOF, `data` will be `nil`.
+---
+--- When `options.buffer` is set, data is read straight into that `luv_buffer_t`
+--- starting at `options.offset` (default `0`) instead of being copied into a new
+--- Lua string. The callback then receives the buffer itself along with the
+--- `offset` and `length` of the bytes just read; they are only valid until the
+--- callback returns, as the next read reuses the same region.
+
+--- When `options.batch` is `"string"` or `"array"`, everything read from the
+--- stream during one loop iteration is collected and handed to the callback in a
+--- single call at the end of that iteration, either concatenated into one string
+--- or as an array of the individual chunks. Data collected before an EOF or error
+--- is delivered first. `batch` cannot be combined with `buffer`.
+
+--- When `options.frame` is set, the stream is cut into frames in C and the
+--- callback only ever receives whole frames, without their delimiter or length
+--- prefix. Exactly one of `frame.delimiter` (e.g. `"\n"` or `"\r\n"`),
+--- `frame.length` (a `"u16be"`, `"u16le"`, `"u32be"` or `"u32le"` length prefix)
+--- or `frame.size` (fixed size records) must be given. A frame whose payload
+--- would exceed `frame.max` (default 1 MiB) fails the read with `EMSGSIZE` and
+--- stops reading. At EOF, trailing data without a delimiter is delivered as a
+--- last frame while incomplete length prefixed or fixed size frames are dropped.
+--- The framing may be changed by calling `read_start` again from the callback;
+--- it then applies to the data that follows. Framed reads can be combined with
+--- `batch = "array"` but not with `buffer`.
 --- Example
 --- ```lua
 --- stream:read_start(function (err, chunk)
@@ -1644,11 +1830,12 @@ function uv.read_start(stream, callback) end
 ---   end
 --- end)
 --- ```
---- @param callback fun(err: string?, data: string?)
+--- @param options uv.read_start.options?
+--- @param callback uv.read_start.callback
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
-function uv_stream_t:read_start(callback) end
+function uv_stream_t:read_start(options, callback) end
 
 --- Stop reading data from the stream. The read callback will no longer be called.
 ---
@@ -1673,6 +1860,10 @@ function uv_stream_t:read_stop() end
 --- in, the C backend will use writev to send all strings in a single system call.
 ---
 --- The optional `callback` is for knowing when the write is complete.
+---
+--- If watermarks are set with `uv.stream_set_watermarks()`, a second value is
+--- returned: `false` when the stream is above its high watermark and the caller
+--- should wait for the drain callback before writing more, `true` otherwise.
 --- @param stream uv.uv_stream_t
 --- @param data uv.buffer
 --- @param callback fun(err: string?)?
@@ -1687,6 +1878,10 @@ function uv.write(stream, data, callback) end
 --- in, the C backend will use writev to send all strings in a single system call.
 ---
 --- The optional `callback` is for knowing when the write is complete.
+---
+--- If watermarks are set with `uv.stream_set_watermarks()`, a second value is
+--- returned: `false` when the stream is above its high watermark and the caller
+--- should wait for the drain callback before writing more, `true` otherwise.
 --- @param data uv.buffer
 --- @param callback fun(err: string?)?
 --- @return uv.uv_write_t? write
@@ -1829,6 +2024,238 @@ function uv.stream_get_write_queue_size(stream) end
 --- @return integer
 function uv_stream_t:get_write_queue_size() end
 
+--- Hold back writes made on the stream. Each `uv.write()` still returns its
+--- request right away, but the data is only handed to the operating system when
+--- the stream is uncorked, as a single vectored write carrying the buffers of
+--- every held write in order. The callback of each original write is still
+--- called once that combined write completes.
+
+--- When `auto` is `true`, the held writes are also issued at the end of every
+--- loop iteration, so that everything written during one iteration goes out
+--- together. The stream stays in this mode until `uv.stream_uncork()` is called.
+
+--- Held writes are issued before `uv.shutdown()`, `uv.write2()`,
+--- `uv.try_write()` and `uv.close()` so that ordering is preserved.
+--- Closing the stream cancels them with `ECANCELED`, and writes made after
+--- `uv.close()` fail with `EBADF`. If the combined write is refused by
+--- libuv, the held writes get the error at the end of the loop iteration
+--- rather than from within the call that issued them.
+--- @param stream uv.uv_stream_t
+--- @param auto boolean?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.stream_cork(stream, auto) end
+
+--- Hold back writes made on the stream. Each `uv.write()` still returns its
+--- request right away, but the data is only handed to the operating system when
+--- the stream is uncorked, as a single vectored write carrying the buffers of
+--- every held write in order. The callback of each original write is still
+--- called once that combined write completes.
+
+--- When `auto` is `true`, the held writes are also issued at the end of every
+--- loop iteration, so that everything written during one iteration goes out
+--- together. The stream stays in this mode until `uv.stream_uncork()` is called.
+
+--- Held writes are issued before `uv.shutdown()`, `uv.write2()`,
+--- `uv.try_write()` and `uv.close()` so that ordering is preserved.
+--- Closing the stream cancels them with `ECANCELED`, and writes made after
+--- `uv.close()` fail with `EBADF`. If the combined write is refused by
+--- libuv, the held writes get the error at the end of the loop iteration
+--- rather than from within the call that issued them.
+--- @param auto boolean?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv_stream_t:cork(auto) end
+
+--- Issue the writes held by `uv.stream_cork()` and stop holding new ones.
+--- @param stream uv.uv_stream_t
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.stream_uncork(stream) end
+
+--- Issue the writes held by `uv.stream_cork()` and stop holding new ones.
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv_stream_t:uncork() end
+
+--- Set write watermarks on the stream. Once the bytes queued for writing
+--- (including writes held by `uv.stream_cork()`) exceed `high`, `uv.write()` and
+--- `uv.write2()` return `false` as a second value next to the request. When
+--- enough of the queue has been flushed for it to fall to `low` or below, the
+--- optional `callback` is called so the writer can resume. A `high` of `0`
+--- removes the watermarks.
+---
+--- Returns `false` if the stream is already above `high`, `true` otherwise.
+--- @param stream uv.uv_stream_t
+--- @param high integer
+--- @param low integer?
+--- @param callback fun()?
+--- @return boolean
+function uv.stream_set_watermarks(stream, high, low, callback) end
+
+--- Set write watermarks on the stream. Once the bytes queued for writing
+--- (including writes held by `uv.stream_cork()`) exceed `high`, `uv.write()` and
+--- `uv.write2()` return `false` as a second value next to the request. When
+--- enough of the queue has been flushed for it to fall to `low` or below, the
+--- optional `callback` is called so the writer can resume. A `high` of `0`
+--- removes the watermarks.
+---
+--- Returns `false` if the stream is already above `high`, `true` otherwise.
+--- @param high integer
+--- @param low integer?
+--- @param callback fun()?
+--- @return boolean
+function uv_stream_t:set_watermarks(high, low, callback) end
+
+--- @class uv.stream_set_timeouts.timeouts
+--- @field read_idle integer?
+--- @field write_stall integer?
+
+--- Enforce deadlines on the stream in C, so idle or slow peers can be evicted
+--- without a timer per stream. `timeouts.read_idle` is the time in milliseconds
+--- the stream may read without receiving data, `timeouts.write_stall` the time
+--- its queued writes may go without any progress. A value of `0` or `nil`
+--- turns a deadline off. Reading data, writes completing and bytes leaving the
+--- write queue start the periods over.
+--- `read_idle` only runs while the stream is reading, whether reading was
+--- started before or after the timeouts were set.
+---
+--- All streams of a loop are checked by one shared timer, so a deadline may be
+--- reported up to an eighth of the shortest timeout late. When one passes the
+--- optional `callback` is called with `"read_idle"` or `"write_stall"` and the
+--- period starts over. Without a `callback` the stream is closed instead.
+--- @param stream uv.uv_stream_t
+--- @param timeouts uv.stream_set_timeouts.timeouts
+--- @param callback fun(kind: string)?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.stream_set_timeouts(stream, timeouts, callback) end
+
+--- Enforce deadlines on the stream in C, so idle or slow peers can be evicted
+--- without a timer per stream. `timeouts.read_idle` is the time in milliseconds
+--- the stream may read without receiving data, `timeouts.write_stall` the time
+--- its queued writes may go without any progress. A value of `0` or `nil`
+--- turns a deadline off. Reading data, writes completing and bytes leaving the
+--- write queue start the periods over.
+--- `read_idle` only runs while the stream is reading, whether reading was
+--- started before or after the timeouts were set.
+---
+--- All streams of a loop are checked by one shared timer, so a deadline may be
+--- reported up to an eighth of the shortest timeout late. When one passes the
+--- optional `callback` is called with `"read_idle"` or `"write_stall"` and the
+--- period starts over. Without a `callback` the stream is closed instead.
+--- @param timeouts uv.stream_set_timeouts.timeouts
+--- @param callback fun(kind: string)?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv_stream_t:set_timeouts(timeouts, callback) end
+
+--- @class uv.pipe_streams.options
+--- @field high integer?
+--- @field low integer?
+--- @field shutdown boolean?
+
+--- Relay everything read from `src` to `dst` in C, without calling into Lua
+--- for each chunk. Reading from `src` pauses while more than `options.high`
+--- bytes (default 256 KiB) are queued for writing on `dst` and resumes once
+--- the queue has drained to `options.low` (default half of `high`). When
+--- `options.shutdown` is `true`, `dst` is shut down with `uv.shutdown()` after
+--- `src` reaches EOF.
+---
+--- The optional `callback` is called once the relay is over, with the number of
+--- bytes written to `dst`. It ends without error at EOF of `src` (after the
+--- shutdown, if requested) and with an error when reading, writing or the
+--- shutdown fails or either stream is closed. A stream can only be the source
+--- of one relay and the destination of one relay at a time, and `src` must not
+--- be reading already; while it is relayed, `uv.read_start()` and
+--- `uv.read_stop()` fail with `EBUSY`. Lua may still write to `dst`.
+--- @param src uv.uv_stream_t
+--- @param dst uv.uv_stream_t
+--- @param options uv.pipe_streams.options?
+--- @param callback fun(err: string?, bytes: integer)?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.pipe_streams(src, dst, options, callback) end
+
+--- Send `length` bytes of the open file `fd`, starting at `offset`, over the
+--- stream without copying them through Lua. On Linux, TCP and pipe streams hand
+--- the file to `sendfile(2)` each time the stream is writable, so the data goes
+--- straight from the page cache to the socket and partial sends resume where
+--- they stopped. When `sendfile(2)` can't be used (other platforms, TTYs or a
+--- file the kernel refuses), the file is read into pooled buffers on the
+--- threadpool and written one chunk at a time.
+---
+--- Writes made on the stream while the file is sent are held and go out after
+--- it. Only one file can be sent on a stream at a time. The optional `callback`
+--- is called with the number of bytes sent once the file is out, the end of the
+--- file is reached, an error occurs or the stream is closed.
+--- @param stream uv.uv_stream_t
+--- @param fd integer
+--- @param offset integer
+--- @param length integer
+--- @param callback fun(err: string?, bytes: integer)?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.stream_send_file(stream, fd, offset, length, callback) end
+
+--- Send `length` bytes of the open file `fd`, starting at `offset`, over the
+--- stream without copying them through Lua. On Linux, TCP and pipe streams hand
+--- the file to `sendfile(2)` each time the stream is writable, so the data goes
+--- straight from the page cache to the socket and partial sends resume where
+--- they stopped. When `sendfile(2)` can't be used (other platforms, TTYs or a
+--- file the kernel refuses), the file is read into pooled buffers on the
+--- threadpool and written one chunk at a time.
+---
+--- Writes made on the stream while the file is sent are held and go out after
+--- it. Only one file can be sent on a stream at a time. The optional `callback`
+--- is called with the number of bytes sent once the file is out, the end of the
+--- file is reached, an error occurs or the stream is closed.
+--- @param fd integer
+--- @param offset integer
+--- @param length integer
+--- @param callback fun(err: string?, bytes: integer)?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv_stream_t:send_file(fd, offset, length, callback) end
+
+--- Configure the pool of read buffers shared by every stream on the loop.
+--- Stream reads take their buffer from this pool and give it back as soon as
+--- the data has been copied into a Lua string, so busy connections don't pay
+--- for a `malloc`/`free` pair on every read.
+---
+--- `size` is the size in bytes of every pooled buffer (default 65536, at least
+--- 64) and `max` is the number of free buffers the pool keeps cached (default
+--- 16, `0` disables caching). Omitted values keep their current setting.
+--- Changing `size` releases all cached buffers.
+--- @param size integer?
+--- @param max integer?
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.buffer_pool_configure(size, max) end
+
+--- @class uv.buffer_pool_stats.stats
+--- @field size integer
+--- @field max integer
+--- @field cached integer
+--- @field hits integer
+--- @field misses integer
+
+--- Returns the current configuration and counters of the read buffer pool.
+--- `hits` counts reads that reused a cached buffer and `misses` counts reads
+--- that had to allocate one.
+--- @return uv.buffer_pool_stats.stats stats
+function uv.buffer_pool_stats() end
+
 
 --- # `uv_tcp_t` - TCP handle
 ---
@@ -3138,28 +3565,34 @@ function uv.new_fs_poll() end
 
 --- Check the file at `path` for changes every `interval` milliseconds.
 ---
+--- `fields` selects the fields of `prev` and `curr` as for `uv.fs_stat()`.
+---
 --- **Note:** For maximum portability, use multi-second intervals. Sub-second
 --- intervals will not detect all changes on many file systems.
 --- @param fs_poll uv.uv_fs_poll_t
 --- @param path string
 --- @param interval integer
+--- @param fields string[]?
 --- @param callback uv.fs_poll_start.callback
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
-function uv.fs_poll_start(fs_poll, path, interval, callback) end
+function uv.fs_poll_start(fs_poll, path, interval, fields, callback) end
 
 --- Check the file at `path` for changes every `interval` milliseconds.
 ---
+--- `fields` selects the fields of `prev` and `curr` as for `uv.fs_stat()`.
+---
 --- **Note:** For maximum portability, use multi-second intervals. Sub-second
 --- intervals will not detect all changes on many file systems.
 --- @param path string
 --- @param interval integer
+--- @param fields string[]?
 --- @param callback uv.fs_poll_start.callback
 --- @return 0? success
 --- @return string? err
 --- @return uv.error_name? err_name
-function uv_fs_poll_t:start(path, interval, callback) end
+function uv_fs_poll_t:start(path, interval, fields, callback) end
 
 --- Stop the handle, the callback will no longer be called.
 --- @param fs_poll uv.uv_fs_poll_t
@@ -3271,6 +3704,24 @@ function uv.fs_open(path, flags, mode) end
 --- @overload fun(fd: integer, size: integer, offset: integer?, callback: fun(err: string?, data: string?)): uv.uv_fs_t
 function uv.fs_read(fd, size, offset) end
 
+--- Like `uv.fs_read()`, but reads into `buffer` at `buf_offset` instead of
+--- returning a new string, so one buffer can be reused for every read. At most
+--- `len` bytes are read, by default up to the end of the buffer. Returns the
+--- number of bytes read; 0 indicates EOF. The buffer is kept alive until the
+--- read completes and should not be used for anything else until then.
+---
+--- If `file_offset` is nil or omitted, it will default to `-1`, which indicates 'use and update the current file offset.'
+--- @param fd integer
+--- @param buffer uv.luv_buffer_t
+--- @param buf_offset integer?
+--- @param len integer?
+--- @param file_offset integer?
+--- @return integer? bytes
+--- @return string? err
+--- @return uv.error_name? err_name
+--- @overload fun(fd: integer, buffer: uv.luv_buffer_t, buf_offset: integer?, len: integer?, file_offset: integer?, callback: fun(err: string?, bytes: integer?)): uv.uv_fs_t
+function uv.fs_read_into(fd, buffer, buf_offset, len, file_offset) end
+
 --- Equivalent to `unlink(2)`.
 --- @param path string
 --- @return boolean? success
@@ -3388,28 +3839,37 @@ function uv.fs_scandir_next(fs) end
 --- @field frsize integer?
 
 --- Equivalent to `stat(2)`.
+---
+--- If `fields` is given, the result has only the fields it lists, which saves
+--- building the rest. Besides the fields of the full table these can be
+--- `atime_ns`, `mtime_ns`, `ctime_ns` and `birthtime_ns`, the timestamps as
+--- integer nanoseconds. These need 64 bit integers and are only available with
+--- Lua 5.3 and later, not with Lua 5.1, 5.2 or LuaJIT.
 --- @param path string
+--- @param fields string[]?
 --- @return uv.fs_stat.result? stat
 --- @return string? err
 --- @return uv.error_name? err_name
---- @overload fun(path: string, callback: fun(err: string?, stat: uv.fs_stat.result?)): uv.uv_fs_t
-function uv.fs_stat(path) end
+--- @overload fun(path: string, fields: string[]?, callback: fun(err: string?, stat: uv.fs_stat.result?)): uv.uv_fs_t
+function uv.fs_stat(path, fields) end
 
---- Equivalent to `fstat(2)`.
+--- Equivalent to `fstat(2)`. `fields` selects fields as for `uv.fs_stat()`.
 --- @param fd integer
+--- @param fields string[]?
 --- @return uv.fs_stat.result? stat
 --- @return string? err
 --- @return uv.error_name? err_name
---- @overload fun(fd: integer, callback: fun(err: string?, stat: uv.fs_stat.result?)): uv.uv_fs_t
-function uv.fs_fstat(fd) end
+--- @overload fun(fd: integer, fields: string[]?, callback: fun(err: string?, stat: uv.fs_stat.result?)): uv.uv_fs_t
+function uv.fs_fstat(fd, fields) end
 
---- Equivalent to `lstat(2)`.
+--- Equivalent to `lstat(2)`. `fields` selects fields as for `uv.fs_stat()`.
 --- @param path string
+--- @param fields string[]?
 --- @return uv.fs_stat.result? stat
 --- @return string? err
 --- @return uv.error_name? err_name
---- @overload fun(path: string, callback: fun(err: string?, stat: uv.fs_stat.result?)): uv.uv_fs_t
-function uv.fs_lstat(path) end
+--- @overload fun(path: string, fields: string[]?, callback: fun(err: string?, stat: uv.fs_stat.result?)): uv.uv_fs_t
+function uv.fs_lstat(path, fields) end
 
 --- Equivalent to `rename(2)`.
 --- @param path string
@@ -3678,6 +4138,79 @@ function luv_dir_t:closedir() end
 --- @overload fun(path: string, callback: fun(err: string?, stat: uv.fs_statfs.result?)): uv.uv_fs_t
 function uv.fs_statfs(path) end
 
+--- Reads the whole file at `path`. Opening, reading and closing run in one
+--- threadpool task, so the callback is called once with the content.
+--- @param path string
+--- @return string? data
+--- @return string? err
+--- @return uv.error_name? err_name
+--- @overload fun(path: string, callback: fun(err: string?, data: string?)): uv.uv_work_t
+function uv.fs_readfile(path) end
+
+--- @class uv.fs_writefile.flags
+--- @field flags string|integer?
+--- @field mode integer?
+--- @field atomic boolean?
+
+--- Writes `data` to the file at `path`, replacing its content, and returns the
+--- number of bytes written. Opening, writing and closing run in one threadpool
+--- task. `flags` are the `uv.fs_open()` flags, `"w"` by default, or a table
+--- with those as `flags`, the `mode` a created file gets and `atomic`.
+---
+--- An atomic write goes to a temporary file next to `path` that is flushed to
+--- disk and renamed over it, so readers see either the old or the new content.
+--- It ignores `flags`. A new file gets `mode` less the umask like a plain
+--- write. An existing file is replaced rather than rewritten: its mode is
+--- copied to the new file, and so is its owner when the process may set it,
+--- but other metadata such as hard links is not kept. It needs libuv 1.34.0
+--- or later and fails with `ENOTSUP` otherwise. If the `flags` parameter is
+--- omitted, then the 3rd parameter will be treated as the `callback`.
+--- @param path string
+--- @param data string
+--- @param flags string|integer|uv.fs_writefile.flags?
+--- @return integer? bytes
+--- @return string? err
+--- @return uv.error_name? err_name
+--- @overload fun(path: string, data: string, flags: string|integer|uv.fs_writefile.flags?, callback: fun(err: string?, bytes: integer?)): uv.uv_work_t
+function uv.fs_writefile(path, data, flags) end
+
+--- @class uv.fs_walk.opts
+--- @field max_depth integer?
+--- @field follow_symlinks boolean?
+--- @field prefix string?
+--- @field glob string?
+--- @field batch integer?
+--- @field parallel integer?
+
+--- Walks the directory tree under `root` in the threadpool and calls `callback`
+--- with its entries in batches: `names` holds the paths relative to `root` and
+--- `types` their types, as in `uv.fs_scandir_next()`. A directory that can't be
+--- read is reported by a call with just `err`, and the walk goes on. The last
+--- call has neither `names` nor `err`.
+---
+--- Each threadpool task reads directories depth first until it has at least
+--- `batch` entries, so a tree costs one callback per batch rather than one per
+--- directory. With `parallel` above 1, up to that many tasks read different
+--- subtrees at the same time.
+---
+--- - `max_depth` limits how deep the walk goes, `1` being the entries of `root`
+---   only. `0` means no limit.
+--- - `follow_symlinks` walks into linked directories, skipping links back to a
+---   directory above, and reports links by the type of their target.
+--- - `prefix` keeps only paths that start with it and skips directories off it.
+--- - `glob` keeps only entries whose name matches it, where `*` matches any run
+---   of characters and `?` any one character. Directories are still walked.
+---
+--- If the `opts` parameter is omitted, then the 2nd parameter will be treated as the `callback`.
+--- @param root string
+--- @param opts uv.fs_walk.opts?
+--- @param callback fun(err: string?, names: string[]?, types: string[]?)
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+--- @overload fun(root: string, callback: fun(err: string?, names: string[]?, types: string[]?)): 0?, string?, uv.error_name?
+function uv.fs_walk(root, opts, callback) end
+
 
 --- # Thread pool work scheduling
 ---
@@ -4540,6 +5073,328 @@ function uv.metrics_idle_time() end
 function uv.metrics_info() end
 
 
+--- # Byte buffers
+---
+--- A `luv_buffer_t` is a fixed-size block of memory owned by Lua. It can be handed
+--- to `uv.read_start()` so that incoming stream data is written into it directly,
+--- avoiding an intermediate Lua string per read. Offsets are zero-based.
+
+--- Creates a zero-filled buffer of `size` bytes.
+--- @param size integer
+--- @return uv.luv_buffer_t buffer
+function uv.new_buffer(size) end
+
+--- Returns the size of the buffer in bytes. Equivalent to `#buffer`.
+--- @param buffer uv.luv_buffer_t
+--- @return integer
+function uv.buffer_size(buffer) end
+
+--- @class uv.luv_buffer_t : userdata
+local luv_buffer_t = {}
+
+--- Returns the size of the buffer in bytes. Equivalent to `#buffer`.
+--- @return integer
+function luv_buffer_t:size() end
+
+--- Copies `length` bytes starting at `offset` out of the buffer into a Lua
+--- string. `offset` defaults to `0` and `length` to the rest of the buffer.
+--- @param buffer uv.luv_buffer_t
+--- @param offset integer?
+--- @param length integer?
+--- @return string
+function uv.buffer_get_string(buffer, offset, length) end
+
+--- Copies `length` bytes starting at `offset` out of the buffer into a Lua
+--- string. `offset` defaults to `0` and `length` to the rest of the buffer.
+--- @param offset integer?
+--- @param length integer?
+--- @return string
+function luv_buffer_t:get_string(offset, length) end
+
+--- Copies `data` into the buffer starting at `offset` and returns the number of
+--- bytes written. It is an error for `data` to extend past the end of the buffer.
+--- @param buffer uv.luv_buffer_t
+--- @param offset integer
+--- @param data string
+--- @return integer
+function uv.buffer_set_string(buffer, offset, data) end
+
+--- Copies `data` into the buffer starting at `offset` and returns the number of
+--- bytes written. It is an error for `data` to extend past the end of the buffer.
+--- @param offset integer
+--- @param data string
+--- @return integer
+function luv_buffer_t:set_string(offset, data) end
+
+--- # Timer wheels
+---
+--- A `luv_timer_wheel_t` manages many one-shot timers without a handle for each
+--- of them, e.g. one idle timeout per connection. Starting, stopping and
+--- restarting a timer takes constant time. The wheel is driven by a single
+--- internal timer that ticks every `tick_ms` while any timer is started, and
+--- timeouts are rounded up to whole ticks.
+---
+--- Timers are identified by integer ids. An id goes stale once its timer fired
+--- or was stopped. While a timer is started the wheel keeps the loop alive
+--- and is not garbage collected. A wheel that is no longer needed can be closed
+--- right away, otherwise a stopped wheel is released when it is collected or
+--- when the loop is closed.
+
+--- Creates a timer wheel with a resolution of `tick_ms` milliseconds. The
+--- callback is called with the timers that expired in a tick as one batch.
+--- @param tick_ms integer
+--- @param callback fun(expired: any[])
+--- @return uv.luv_timer_wheel_t wheel
+function uv.new_timer_wheel(tick_ms, callback) end
+
+--- Starts a timer that expires after `timeout` milliseconds and returns its
+--- id. `value` is handed to the callback when the timer expires.
+--- @param wheel uv.luv_timer_wheel_t
+--- @param timeout integer
+--- @param value any?
+--- @return integer id
+function uv.timer_wheel_start(wheel, timeout, value) end
+
+--- @class uv.luv_timer_wheel_t : userdata
+local luv_timer_wheel_t = {}
+
+--- Starts a timer that expires after `timeout` milliseconds and returns its
+--- id. `value` is handed to the callback when the timer expires.
+--- @param timeout integer
+--- @param value any?
+--- @return integer id
+function luv_timer_wheel_t:start(timeout, value) end
+
+--- Makes a started timer expire `timeout` milliseconds from now instead. Returns
+--- `false` if the id is stale.
+--- @param wheel uv.luv_timer_wheel_t
+--- @param id integer
+--- @param timeout integer
+--- @return boolean
+function uv.timer_wheel_restart(wheel, id, timeout) end
+
+--- Makes a started timer expire `timeout` milliseconds from now instead. Returns
+--- `false` if the id is stale.
+--- @param id integer
+--- @param timeout integer
+--- @return boolean
+function luv_timer_wheel_t:restart(id, timeout) end
+
+--- Stops a timer. Returns `false` if the id is stale.
+--- @param wheel uv.luv_timer_wheel_t
+--- @param id integer
+--- @return boolean
+function uv.timer_wheel_stop(wheel, id) end
+
+--- Stops a timer. Returns `false` if the id is stale.
+--- @param id integer
+--- @return boolean
+function luv_timer_wheel_t:stop(id) end
+
+--- Returns the number of started timers.
+--- @param wheel uv.luv_timer_wheel_t
+--- @return integer
+function uv.timer_wheel_count(wheel) end
+
+--- Returns the number of started timers.
+--- @return integer
+function luv_timer_wheel_t:count() end
+
+--- Stop every timer without calling back and release the wheel. The wheel can no longer be used.
+--- @param wheel uv.luv_timer_wheel_t
+function uv.timer_wheel_close(wheel) end
+
+--- Stop every timer without calling back and release the wheel. The wheel can no longer be used.
+function luv_timer_wheel_t:close() end
+
+--- # High resolution timers
+---
+--- A `luv_hrtimer_t` is a timer with deadlines in nanoseconds, measured on the
+--- same clock as `uv.hrtime()`, for pacing that milliseconds are too coarse for.
+--- On Linux it is backed by a `timerfd`. Elsewhere it falls back to a libuv timer
+--- and fires within a millisecond after its deadline.
+---
+--- A repeating timer keeps its deadlines at `timeout + n * repeat` from the time
+--- it was started, so a late callback doesn't delay the ones after it. While
+--- started the timer keeps the loop alive and is not garbage collected.
+
+--- Creates a new high resolution timer.
+--- @return uv.luv_hrtimer_t? hrtimer
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.new_hrtimer() end
+
+--- Start the timer. `timeout` and `repeat` are in nanoseconds. If `repeat` is
+--- non-zero, the timer fires first after `timeout` nanoseconds and then every
+--- `repeat` nanoseconds. Starting a started timer sets its deadlines anew.
+---
+--- The callback receives the number of deadlines that passed since the last call,
+--- which is more than 1 if the loop was too busy to run it in time.
+--- @param hrtimer uv.luv_hrtimer_t
+--- @param timeout integer
+--- @param repeat_ integer
+--- @param callback fun(count: integer)
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.hrtimer_start(hrtimer, timeout, repeat_, callback) end
+
+--- @class uv.luv_hrtimer_t : userdata
+local luv_hrtimer_t = {}
+
+--- Start the timer. `timeout` and `repeat` are in nanoseconds. If `repeat` is
+--- non-zero, the timer fires first after `timeout` nanoseconds and then every
+--- `repeat` nanoseconds. Starting a started timer sets its deadlines anew.
+---
+--- The callback receives the number of deadlines that passed since the last call,
+--- which is more than 1 if the loop was too busy to run it in time.
+--- @param timeout integer
+--- @param repeat_ integer
+--- @param callback fun(count: integer)
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function luv_hrtimer_t:start(timeout, repeat_, callback) end
+
+--- Stop the timer.
+--- @param hrtimer uv.luv_hrtimer_t
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function uv.hrtimer_stop(hrtimer) end
+
+--- Stop the timer.
+--- @return 0? success
+--- @return string? err
+--- @return uv.error_name? err_name
+function luv_hrtimer_t:stop() end
+
+--- Get the nanoseconds until the next deadline, or 0 if it has passed or the timer is stopped.
+--- @param hrtimer uv.luv_hrtimer_t
+--- @return integer due_in
+function uv.hrtimer_get_due_in(hrtimer) end
+
+--- Get the nanoseconds until the next deadline, or 0 if it has passed or the timer is stopped.
+--- @return integer due_in
+function luv_hrtimer_t:get_due_in() end
+
+--- Stop the timer and release its resources. The timer can no longer be used.
+--- @param hrtimer uv.luv_hrtimer_t
+function uv.hrtimer_close(hrtimer) end
+
+--- Stop the timer and release its resources. The timer can no longer be used.
+function luv_hrtimer_t:close() end
+
+
+--- # Futures
+---
+--- A `luv_future_t` holds the result of an operation that has not finished yet.
+--- It is resolved once with a list of values, normally by passing it to a request
+--- function in place of the callback, which resolves it with the arguments the
+--- callback would have received. Functions and coroutines waiting for it are then
+--- called with those values.
+---
+--- The combinators make a future out of others and are resolved in C as those
+--- settle, so Lua code only runs once for the combined result. Like the error
+--- argument of a callback, a first value that is not `nil` counts as failure.
+---
+--- ```lua
+--- local list = {}
+--- for i, path in ipairs({ "a.txt", "b.txt", "c.txt" }) do
+---   list[i] = uv.new_future()
+---   uv.fs_stat(path, list[i])
+--- end
+--- uv.future_timeout(uv.future_all(list), 1000):wait(function(err, stats)
+---   assert(not err, err)
+---   print(stats[1].size, stats[2].size, stats[3].size)
+--- end)
+--- ```
+
+--- Creates a new unresolved future.
+--- @return uv.luv_future_t future
+function uv.new_future() end
+
+--- Resolve the future with the given values. Returns `false` if it was resolved
+--- already, in which case the values are dropped.
+--- @param future uv.luv_future_t
+--- @param ... any
+--- @return boolean resolved
+function uv.future_resolve(future, ...) end
+
+--- @class uv.luv_future_t : userdata
+local luv_future_t = {}
+
+--- Resolve the future with the given values. Returns `false` if it was resolved
+--- already, in which case the values are dropped.
+--- @param ... any
+--- @return boolean resolved
+function luv_future_t:resolve(...) end
+
+--- Call a function, resume a coroutine or resolve another future with the values
+--- of the future once it is resolved. If it is resolved already, functions and
+--- coroutines are called on the next loop iteration like with `uv.defer()`, so
+--- `uv.await(uv.future_wait, future)` works either way.
+--- @param future uv.luv_future_t
+--- @param continuation fun(...: any)|thread|uv.luv_future_t
+--- @return uv.luv_future_t future
+function uv.future_wait(future, continuation) end
+
+--- Call a function, resume a coroutine or resolve another future with the values
+--- of the future once it is resolved. If it is resolved already, functions and
+--- coroutines are called on the next loop iteration like with `uv.defer()`, so
+--- `uv.await(uv.future_wait, future)` works either way.
+--- @param continuation fun(...: any)|thread|uv.luv_future_t
+--- @return uv.luv_future_t future
+function luv_future_t:wait(continuation) end
+
+--- Returns whether the future is resolved, followed by its values if it is.
+--- @param future uv.luv_future_t
+--- @return boolean resolved
+--- @return any ...
+function uv.future_get(future) end
+
+--- Returns whether the future is resolved, followed by its values if it is.
+--- @return boolean resolved
+--- @return any ...
+function luv_future_t:get() end
+
+--- Returns a future resolved when all futures in the list have succeeded, with
+--- `nil` and a table holding the second value of each in list order (the first
+--- result after the error argument), with its length in the field `n`. As soon as
+--- one fails it is resolved with the values of that one instead. An empty list
+--- resolves it right away.
+--- @param futures uv.luv_future_t[]
+--- @return uv.luv_future_t future
+function uv.future_all(futures) end
+
+--- Returns a future resolved with the values of the first future in the list that
+--- succeeds, or with those of the last to fail if none does.
+--- @param futures uv.luv_future_t[]
+--- @return uv.luv_future_t future
+function uv.future_any(futures) end
+
+--- Returns a future resolved with the values of the first future in the list to
+--- be resolved, whether it succeeded or not.
+--- @param futures uv.luv_future_t[]
+--- @return uv.luv_future_t future
+function uv.future_race(futures) end
+
+--- Returns a future resolved with the values of `future`, or with `"ETIMEDOUT"` if
+--- that is not resolved within `timeout` milliseconds. The timer is internal and
+--- keeps the loop alive until one of them happens.
+--- @param future uv.luv_future_t
+--- @param timeout integer
+--- @return uv.luv_future_t future
+function uv.future_timeout(future, timeout) end
+
+--- Returns a future resolved with the values of `future`, or with `"ETIMEDOUT"` if
+--- that is not resolved within `timeout` milliseconds. The timer is internal and
+--- keeps the loop alive until one of them happens.
+--- @param timeout integer
+--- @return uv.luv_future_t future
+function luv_future_t:timeout(timeout) end
+
+
 --- # String manipulation functions
 ---
 --- These string utilities are needed internally for dealing with Windows, and are exported to allow clients to work uniformly with this data when the libuv API is not complete.
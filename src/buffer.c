@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+// A fixed size, mutable block of bytes owned by Lua.  The bytes are stored
+// inline right after this header so a buffer is a single allocation.
+typedef struct {
+  size_t size;
+  char* base;
+} luv_buffer_t;
+
+static luv_buffer_t* luv_check_buffer(lua_State* L, int index) {
+  return (luv_buffer_t*)luaL_checkudata(L, index, "uv_buffer");
+}
+
+// Checks that [offset, offset + length) lies within the buffer, where the
+// offset is at index and the length at index + 1.  A missing length means
+// "up to the end of the buffer".
+static void luv_check_buffer_range(lua_State* L, luv_buffer_t* buf, int index, size_t* offset, size_t* length) {
+  lua_Integer off = luaL_optinteger(L, index, 0);
+  lua_Integer len;
+  luaL_argcheck(L, off >= 0 && (size_t)off <= buf->size, index, "offset out of range");
+  len = luaL_optinteger(L, index + 1, buf->size - off);
+  luaL_argcheck(L, len >= 0 && (size_t)len <= buf->size - off, index + 1, "length out of range");
+  *offset = (size_t)off;
+  *length = (size_t)len;
+}
+
+static int luv_new_buffer(lua_State* L) {
+  lua_Integer size = luaL_checkinteger(L, 1);
+  luv_buffer_t* buf;
+  luaL_argcheck(L, size > 0, 1, "size must be > 0");
+  buf = (luv_buffer_t*)lua_newuserdata(L, sizeof(*buf) + (size_t)size);
+  buf->size = (size_t)size;
+  buf->base = (char*)(buf + 1);
+  memset(buf->base, 0, buf->size);
+  luaL_getmetatable(L, "uv_buffer");
+  lua_setmetatable(L, -2);
+  return 1;
+}
+
+static int luv_buffer_size(lua_State* L) {
+  luv_buffer_t* buf = luv_check_buffer(L, 1);
+  lua_pushinteger(L, buf->size);
+  return 1;
+}
+
+static int luv_buffer_get_string(lua_State* L) {
+  luv_buffer_t* buf = luv_check_buffer(L, 1);
+  size_t offset, length;
+  luv_check_buffer_range(L, buf, 2, &offset, &length);
+  lua_pushlstring(L, buf->base + offset, length);
+  return 1;
+}
+
+static int luv_buffer_set_string(lua_State* L) {
+  luv_buffer_t* buf = luv_check_buffer(L, 1);
+  lua_Integer offset = luaL_checkinteger(L, 2);
+  size_t len;
+  const char* data = luaL_checklstring(L, 3, &len);
+  luaL_argcheck(L, offset >= 0 && (size_t)offset <= buf->size, 2, "offset out of range");
+  luaL_argcheck(L, len <= buf->size - offset, 3, "data does not fit in the buffer");
+  memcpy(buf->base + offset, data, len);
+  lua_pushinteger(L, len);
+  return 1;
+}
+
+static int luv_buffer_tostring(lua_State* L) {
+  luv_buffer_t* buf = luv_check_buffer(L, 1);
+  lua_pushfstring(L, "uv_buffer: %p", buf);
+  return 1;
+}
+
+static const luaL_Reg luv_buffer_methods[] = {
+  {"size", luv_buffer_size},
+  {"get_string", luv_buffer_get_string},
+  {"set_string", luv_buffer_set_string},
+  {NULL, NULL}
+};
+
+static void luv_buffer_init(lua_State* L) {
+  luaL_newmetatable(L, "uv_buffer");
+  lua_pushcfunction(L, luv_buffer_tostring);
+  lua_setfield(L, -2, "__tostring");
+  lua_pushcfunction(L, luv_buffer_size);
+  lua_setfield(L, -2, "__len");
+  lua_newtable(L);
+  luaL_setfuncs(L, luv_buffer_methods, 0);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+}
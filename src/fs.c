@@ -54,68 +54,103 @@ static void luv_push_timespec_table(lua_State* L, const uv_timespec_t* t) {
   lua_setfield(L, -2, "nsec");
 }
 
-static void luv_push_stats_table(lua_State* L, const uv_stat_t* s) {
-  const char* type = NULL;
-  lua_createtable(L, 0, 23);
-  lua_pushinteger(L, s->st_dev);
-  lua_setfield(L, -2, "dev");
-  lua_pushinteger(L, s->st_mode);
-  lua_setfield(L, -2, "mode");
-  lua_pushinteger(L, s->st_nlink);
-  lua_setfield(L, -2, "nlink");
-  lua_pushinteger(L, s->st_uid);
-  lua_setfield(L, -2, "uid");
-  lua_pushinteger(L, s->st_gid);
-  lua_setfield(L, -2, "gid");
-  lua_pushinteger(L, s->st_rdev);
-  lua_setfield(L, -2, "rdev");
-  lua_pushinteger(L, s->st_ino);
-  lua_setfield(L, -2, "ino");
-  lua_pushinteger(L, s->st_size);
-  lua_setfield(L, -2, "size");
-  lua_pushinteger(L, s->st_blksize);
-  lua_setfield(L, -2, "blksize");
-  lua_pushinteger(L, s->st_blocks);
-  lua_setfield(L, -2, "blocks");
-  lua_pushinteger(L, s->st_flags);
-  lua_setfield(L, -2, "flags");
-  lua_pushinteger(L, s->st_gen);
-  lua_setfield(L, -2, "gen");
-  luv_push_timespec_table(L, &s->st_atim);
-  lua_setfield(L, -2, "atime");
-  luv_push_timespec_table(L, &s->st_mtim);
-  lua_setfield(L, -2, "mtime");
-  luv_push_timespec_table(L, &s->st_ctim);
-  lua_setfield(L, -2, "ctime");
-  luv_push_timespec_table(L, &s->st_birthtim);
-  lua_setfield(L, -2, "birthtime");
-  if (S_ISREG(s->st_mode)) {
-    type = "file";
-  }
-  else if (S_ISDIR(s->st_mode)) {
-    type = "directory";
-  }
-  else if (S_ISLNK(s->st_mode)) {
-    type = "link";
-  }
-  else if (S_ISFIFO(s->st_mode)) {
-    type = "fifo";
-  }
+// The fields of a stat result, which fs_stat, fs_fstat and fs_lstat can be
+// asked for a selection of.  Those after "type" are nanosecond timestamps as
+// single integers and only there when asked for.  Before Lua 5.3, LuaJIT
+// included, integers are pushed as doubles which can't hold them exactly,
+// so they aren't offered there.
+static const char* const luv_stat_fields[] = {
+  "dev", "mode", "nlink", "uid", "gid", "rdev", "ino", "size", "blksize",
+  "blocks", "flags", "gen", "atime", "mtime", "ctime", "birthtime", "type",
+#if LUA_VERSION_NUM >= 503
+  "atime_ns", "mtime_ns", "ctime_ns", "birthtime_ns",
+#endif
+  NULL
+};
+
+#define LUV_STAT_ALL ((1 << 17) - 1)
+
+static const char* luv_stat_type(const uv_stat_t* s) {
+  if (S_ISREG(s->st_mode)) return "file";
+  if (S_ISDIR(s->st_mode)) return "directory";
+  if (S_ISLNK(s->st_mode)) return "link";
+  if (S_ISFIFO(s->st_mode)) return "fifo";
 #ifdef S_ISSOCK
-  else if (S_ISSOCK(s->st_mode)) {
-    type = "socket";
-  }
+  if (S_ISSOCK(s->st_mode)) return "socket";
 #endif
-  else if (S_ISCHR(s->st_mode)) {
-    type = "char";
+  if (S_ISCHR(s->st_mode)) return "char";
+  if (S_ISBLK(s->st_mode)) return "block";
+  return NULL;
+}
+
+static void luv_push_stat_field(lua_State* L, const uv_stat_t* s, int field) {
+  const uv_timespec_t* t;
+  switch (field) {
+    case 0: lua_pushinteger(L, s->st_dev); return;
+    case 1: lua_pushinteger(L, s->st_mode); return;
+    case 2: lua_pushinteger(L, s->st_nlink); return;
+    case 3: lua_pushinteger(L, s->st_uid); return;
+    case 4: lua_pushinteger(L, s->st_gid); return;
+    case 5: lua_pushinteger(L, s->st_rdev); return;
+    case 6: lua_pushinteger(L, s->st_ino); return;
+    case 7: lua_pushinteger(L, s->st_size); return;
+    case 8: lua_pushinteger(L, s->st_blksize); return;
+    case 9: lua_pushinteger(L, s->st_blocks); return;
+    case 10: lua_pushinteger(L, s->st_flags); return;
+    case 11: lua_pushinteger(L, s->st_gen); return;
+    case 12: luv_push_timespec_table(L, &s->st_atim); return;
+    case 13: luv_push_timespec_table(L, &s->st_mtim); return;
+    case 14: luv_push_timespec_table(L, &s->st_ctim); return;
+    case 15: luv_push_timespec_table(L, &s->st_birthtim); return;
+    case 16: {
+      // Left out for types that have no name
+      const char* type = luv_stat_type(s);
+      if (type) lua_pushstring(L, type);
+      else lua_pushnil(L);
+      return;
+    }
+    case 17: t = &s->st_atim; break;
+    case 18: t = &s->st_mtim; break;
+    case 19: t = &s->st_ctim; break;
+    default: t = &s->st_birthtim; break;
   }
-  else if (S_ISBLK(s->st_mode)) {
-    type = "block";
+  lua_pushinteger(L, (lua_Integer)t->tv_sec * 1000000000 + t->tv_nsec);
+}
+
+// Pushes a table with the fields whose bits are set in mask
+static void luv_push_stats_fields(lua_State* L, const uv_stat_t* s, int mask) {
+  int i, n = 0;
+  for (i = 0; luv_stat_fields[i]; i++)
+    if (mask & (1 << i)) n++;
+  lua_createtable(L, 0, n);
+  for (i = 0; luv_stat_fields[i]; i++) {
+    if (!(mask & (1 << i))) continue;
+    luv_push_stat_field(L, s, i);
+    lua_setfield(L, -2, luv_stat_fields[i]);
   }
-  if (type) {
-    lua_pushstring(L, type);
-    lua_setfield(L, -2, "type");
+}
+
+static void luv_push_stats_table(lua_State* L, const uv_stat_t* s) {
+  luv_push_stats_fields(L, s, LUV_STAT_ALL);
+}
+
+// Checks a list of stat field names and returns their mask
+static int luv_check_stat_fields(lua_State* L, int index) {
+  int i, j, n, mask = 0;
+  n = (int)lua_rawlen(L, index);
+  for (i = 1; i <= n; i++) {
+    const char* name;
+    lua_rawgeti(L, index, i);
+    name = lua_tostring(L, -1);
+    for (j = 0; name && luv_stat_fields[j]; j++) {
+      if (strcmp(name, luv_stat_fields[j]) == 0) break;
+    }
+    if (!name || !luv_stat_fields[j])
+      return luaL_argerror(L, index, lua_pushfstring(L, "unknown stat field '%s'", luaL_tolstring(L, -1, NULL)));
+    mask |= 1 << j;
+    lua_pop(L, 1);
   }
+  return mask;
 }
 
 static int luv_push_dirent(lua_State* L, const uv_dirent_t* ent, int table) {
@@ -264,12 +299,12 @@ static int push_fs_result(lua_State* L, uv_fs_t* req) {
       // We need to unref the luv_fs_scandir_t userdata to allow it to be garbage collected.
       // The scandir callback can only be called once, so we now know that the
       // req can be safely garbage collected.
-      luaL_unref(L, LUA_REGISTRYINDEX, data->data_ref);
-      data->data_ref = LUA_NOREF;
+      lua_pushnil(L);
+      luv_req_set_data(L, data);
     }
     lua_pushnil(L);
     if (fs_req_has_dest_path(req)) {
-      lua_rawgeti(L, LUA_REGISTRYINDEX, data->data_ref);
+      luv_req_push_data(L, data);
       const char* dest_path = lua_tostring(L, -1);
       lua_pop(L, 1);
       lua_pushfstring(L, "%s: %s: %s -> %s", uv_err_name(req->result), uv_strerror(req->result), req->path, dest_path);
@@ -321,6 +356,15 @@ static int push_fs_result(lua_State* L, uv_fs_t* req) {
     case UV_FS_STAT:
     case UV_FS_LSTAT:
     case UV_FS_FSTAT:
+      // A selection of fields is pinned to the request as their mask
+      if (data->has_data) {
+        int mask;
+        luv_req_push_data(L, data);
+        mask = (int)lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        luv_push_stats_fields(L, &req->statbuf, mask);
+        return 1;
+      }
       luv_push_stats_table(L, &req->statbuf);
       return 1;
 
@@ -348,19 +392,24 @@ static int push_fs_result(lua_State* L, uv_fs_t* req) {
       return 1;
 
     case UV_FS_READ:
+      // fs_read_into read into the uv_buffer pinned to the request
+      if (!data->data) {
+        lua_pushinteger(L, req->result);
+        return 1;
+      }
       lua_pushlstring(L, (const char*)data->data, req->result);
       return 1;
 
     case UV_FS_SCANDIR:
-      // The luv_fs_scandir_t userdata is stored in data_ref.
+      // The luv_fs_scandir_t userdata is pinned to the request.
       // We want to return this instead of the uv_req_t because the
       // luv_fs_scandir_t userdata has a gc method.
-      lua_rawgeti(L, LUA_REGISTRYINDEX, data->data_ref);
-      // We now want to unref the userdata to allow it to be garbage collected.
+      luv_req_push_data(L, data);
+      // We now want to unpin the userdata to allow it to be garbage collected.
       // The scandir callback can only be called once, so we now know that the
       // req can be safely garbage collected.
-      luaL_unref(L, LUA_REGISTRYINDEX, data->data_ref);
-      data->data_ref = LUA_NOREF;
+      lua_pushnil(L);
+      luv_req_set_data(L, data);
       return 1;
 
 #if LUV_UV_VERSION_GEQ(1, 28, 0)
@@ -368,11 +417,11 @@ static int push_fs_result(lua_State* L, uv_fs_t* req) {
       int nentries;
       uv_dir_t* dir = (uv_dir_t*)req->ptr;
 
-      lua_rawgeti(L, LUA_REGISTRYINDEX, data->data_ref);
+      luv_req_push_data(L, data);
       nentries = luaL_checkinteger(L, -1);
       lua_pop(L, 1);
-      luaL_unref(L, LUA_REGISTRYINDEX, data->data_ref);
-      data->data_ref = LUA_NOREF;
+      lua_pushnil(L);
+      luv_req_set_data(L, data);
 
       luv_dir_t* luv_dir = lua_newuserdata(L, sizeof(*luv_dir));
       luaL_getmetatable(L, "uv_dir");
@@ -386,8 +435,8 @@ static int push_fs_result(lua_State* L, uv_fs_t* req) {
       return 1;
     }
     case UV_FS_READDIR: {
-      luaL_unref(L, LUA_REGISTRYINDEX, data->data_ref);
-      data->data_ref = LUA_NOREF;
+      lua_pushnil(L);
+      luv_req_set_data(L, data);
 
       if(req->result > 0) {
         size_t i;
@@ -455,13 +504,13 @@ static void luv_fs_cb(uv_fs_t* req) {
 #define FS_CALL_NORETURN(func, req, ...) {                \
   int ret, sync;                                          \
   luv_req_t* lreq = (luv_req_t*)req->data;                \
-  sync = lreq->callback_ref == LUA_NOREF;                 \
+  sync = !lreq->has_callback;                             \
   ret = func(lreq->ctx->loop, req, __VA_ARGS__,           \
                      sync ? NULL : luv_fs_cb);            \
   if (req->fs_type != UV_FS_ACCESS && ret < 0) {          \
     lua_pushnil(L);                                       \
     if (fs_req_has_dest_path(req)) {                      \
-      lua_rawgeti(L, LUA_REGISTRYINDEX, lreq->data_ref);  \
+      luv_req_push_data(L, lreq);                         \
       const char* dest_path = lua_tostring(L, -1);        \
       lua_pop(L, 1);                                      \
       lua_pushfstring(L, "%s: %s: %s -> %s",              \
@@ -496,7 +545,7 @@ static void luv_fs_cb(uv_fs_t* req) {
     }                                                     \
   }                                                       \
   else {                                                  \
-    lua_rawgeti(L, LUA_REGISTRYINDEX, lreq->req_ref);     \
+    luv_req_push(L, lreq);                                \
     nargs = 1;                                            \
   }                                                       \
 }
@@ -511,7 +560,7 @@ static int luv_fs_close(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   uv_file file = luaL_checkinteger(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_close, req, file);
 }
@@ -522,7 +571,7 @@ static int luv_fs_open(lua_State* L) {
   int flags = luv_check_flags(L, 2);
   int mode = luaL_checkinteger(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_open, req, path, flags, mode);
 }
@@ -536,7 +585,7 @@ static int luv_fs_read(lua_State* L) {
   int ref;
   char* data;
   // both offset and callback are optional
-  if (luv_is_callable(L, 3) && lua_isnoneornil(L, 4)) {
+  if (luv_is_continuation(L, 3) && lua_isnoneornil(L, 4)) {
     ref = luv_check_continuation(L, 3);
   }
   else {
@@ -547,22 +596,49 @@ static int luv_fs_read(lua_State* L) {
     return luaL_error(L, "Length must be non-negative");
   data = (char*)malloc(len);
   if (!data) {
-    luaL_unref(L, LUA_REGISTRYINDEX, ref);
     return luaL_error(L, "Failure to allocate buffer");
   }
   uv_buf_t buf = uv_buf_init(data, len);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   // TODO: find out why we can't just use req->ptr for the base
   ((luv_req_t*)req->data)->data = buf.base;
   FS_CALL(uv_fs_read, req, file, &buf, 1, offset);
 }
 
+// Like fs_read, but into a range of a uv_buffer that can be reused for every
+// read instead of a fresh string
+static int luv_fs_read_into(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  uv_file file = luaL_checkinteger(L, 1);
+  luv_buffer_t* buffer = luv_check_buffer(L, 2);
+  // -1 offset means "the current file offset is used and updated"
+  int64_t offset = -1;
+  size_t buf_offset, len;
+  int ref;
+  luv_check_buffer_range(L, buffer, 3, &buf_offset, &len);
+  // both file offset and callback are optional
+  if (luv_is_continuation(L, 5) && lua_isnoneornil(L, 6)) {
+    ref = luv_check_continuation(L, 5);
+  }
+  else {
+    offset = luaL_optinteger(L, 5, offset);
+    ref = luv_check_continuation(L, 6);
+  }
+  uv_buf_t buf = uv_buf_init(buffer->base + buf_offset, len);
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
+  req->data = luv_setup_req(L, ctx, ref);
+  // ref the buffer so it stays alive while the read fills it
+  lua_pushvalue(L, 2);
+  luv_req_set_data(L, (luv_req_t*)req->data);
+  FS_CALL(uv_fs_read, req, file, &buf, 1, offset);
+}
+
 static int luv_fs_unlink(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_unlink, req, path);
 }
@@ -574,14 +650,14 @@ static int luv_fs_write(lua_State* L) {
   int64_t offset = -1;
   int ref;
   // both offset and callback are optional
-  if (luv_is_callable(L, 3) && lua_isnoneornil(L, 4)) {
+  if (luv_is_continuation(L, 3) && lua_isnoneornil(L, 4)) {
     ref = luv_check_continuation(L, 3);
   }
   else {
     offset = luaL_optinteger(L, 3, offset);
     ref = luv_check_continuation(L, 4);
   }
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   size_t count;
   uv_buf_t* bufs = luv_check_bufs(L, 2, &count, (luv_req_t*)req->data);
@@ -596,7 +672,7 @@ static int luv_fs_mkdir(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   int mode = luaL_checkinteger(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_mkdir, req, path, mode);
 }
@@ -605,7 +681,7 @@ static int luv_fs_mkdtemp(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* tpl = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_mkdtemp, req, tpl);
 }
@@ -615,7 +691,7 @@ static int luv_fs_mkstemp(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* tpl = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_mkstemp, req, tpl);
 }
@@ -625,7 +701,7 @@ static int luv_fs_rmdir(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_rmdir, req, path);
 }
@@ -635,7 +711,7 @@ static int luv_fs_scandir(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   int flags = 0; // TODO: find out what these flags are.
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   int sync = ref == LUA_NOREF;
 
@@ -659,7 +735,7 @@ static int luv_fs_scandir(lua_State* L) {
   // before the callback is called.
   if (!sync) {
     lua_pushvalue(L, scandir_req_index);
-    ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    luv_req_set_data(L, (luv_req_t*)req->data);
   }
 
   lua_pushvalue(L, scandir_req_index);
@@ -675,30 +751,54 @@ static int luv_fs_scandir_next(lua_State* L) {
   return luv_push_dirent(L, &ent, 0);
 }
 
+// The fields to return can be selected by a list before the callback.  Returns
+// their mask, or -1 for the full table.  Leaves the callback, if any, on top.
+static int luv_fs_check_stat_args(lua_State* L, int index) {
+  int mask = -1;
+  if (lua_type(L, index) == LUA_TTABLE && !luv_is_callable(L, index)) {
+    mask = luv_check_stat_fields(L, index);
+    index++;
+  }
+  lua_settop(L, index);
+  return mask;
+}
+
+static void luv_fs_pin_stat_fields(lua_State* L, luv_req_t* data, int mask) {
+  if (mask < 0) return;
+  lua_pushinteger(L, mask);
+  luv_req_set_data(L, data);
+}
+
 static int luv_fs_stat(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
-  int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  int mask = luv_fs_check_stat_args(L, 2);
+  int ref = luv_check_continuation(L, lua_gettop(L));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
+  luv_fs_pin_stat_fields(L, (luv_req_t*)req->data, mask);
   FS_CALL(uv_fs_stat, req, path);
 }
 
 static int luv_fs_fstat(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   uv_file file = luaL_checkinteger(L, 1);
-  int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  int mask = luv_fs_check_stat_args(L, 2);
+  int ref = luv_check_continuation(L, lua_gettop(L));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
+  luv_fs_pin_stat_fields(L, (luv_req_t*)req->data, mask);
   FS_CALL(uv_fs_fstat, req, file);
 }
 
 static int luv_fs_lstat(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
-  int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  int mask = luv_fs_check_stat_args(L, 2);
+  int ref = luv_check_continuation(L, lua_gettop(L));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
+  luv_fs_pin_stat_fields(L, (luv_req_t*)req->data, mask);
   FS_CALL(uv_fs_lstat, req, path);
 }
 
@@ -707,11 +807,11 @@ static int luv_fs_rename(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   const char* new_path = luaL_checkstring(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   // ref the dest path so that we can print it in the error message
   lua_pushvalue(L, 2);
-  ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  luv_req_set_data(L, (luv_req_t*)req->data);
   FS_CALL(uv_fs_rename, req, path, new_path);
 }
 
@@ -719,7 +819,7 @@ static int luv_fs_fsync(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   uv_file file = luaL_checkinteger(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_fsync, req, file);
 }
@@ -728,7 +828,7 @@ static int luv_fs_fdatasync(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   uv_file file = luaL_checkinteger(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_fdatasync, req, file);
 }
@@ -738,7 +838,7 @@ static int luv_fs_ftruncate(lua_State* L) {
   uv_file file = luaL_checkinteger(L, 1);
   int64_t offset = luaL_checkinteger(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_ftruncate, req, file, offset);
 }
@@ -750,7 +850,7 @@ static int luv_fs_sendfile(lua_State* L) {
   int64_t in_offset = luaL_checkinteger(L, 3);
   size_t length = luaL_checkinteger(L, 4);
   int ref = luv_check_continuation(L, 5);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_sendfile, req, out_fd, in_fd, in_offset, length);
 }
@@ -760,7 +860,7 @@ static int luv_fs_access(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   int amode = luv_check_amode(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_access, req, path, amode);
 }
@@ -770,7 +870,7 @@ static int luv_fs_chmod(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   int mode = luaL_checkinteger(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_chmod, req, path, mode);
 }
@@ -780,7 +880,7 @@ static int luv_fs_fchmod(lua_State* L) {
   uv_file file = luaL_checkinteger(L, 1);
   int mode = luaL_checkinteger(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_fchmod, req, file, mode);
 }
@@ -805,7 +905,7 @@ static int luv_fs_utime(lua_State* L) {
   double atime = luv_fs_check_modification_time(L, 2);
   double mtime = luv_fs_check_modification_time(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_utime, req, path, atime, mtime);
 }
@@ -816,7 +916,7 @@ static int luv_fs_futime(lua_State* L) {
   double atime = luv_fs_check_modification_time(L, 2);
   double mtime = luv_fs_check_modification_time(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_futime, req, file, atime, mtime);
 }
@@ -828,7 +928,7 @@ static int luv_fs_lutime(lua_State* L) {
   double atime = luv_fs_check_modification_time(L, 2);
   double mtime = luv_fs_check_modification_time(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_lutime, req, path, atime, mtime);
 }
@@ -839,11 +939,11 @@ static int luv_fs_link(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   const char* new_path = luaL_checkstring(L, 2);
   int ref = luv_check_continuation(L, 3);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   // ref the dest path so that we can print it in the error message
   lua_pushvalue(L, 2);
-  ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  luv_req_set_data(L, (luv_req_t*)req->data);
   FS_CALL(uv_fs_link, req, path, new_path);
 }
 
@@ -854,7 +954,7 @@ static int luv_fs_symlink(lua_State* L) {
   int flags = 0, ref;
   uv_fs_t* req;
   // callback can be the 3rd parameter
-  if (luv_is_callable(L, 3) && lua_isnone(L, 4)) {
+  if (luv_is_continuation(L, 3) && lua_isnone(L, 4)) {
     ref = luv_check_continuation(L, 3);
   } else {
     if (lua_type(L, 3) == LUA_TTABLE) {
@@ -873,11 +973,11 @@ static int luv_fs_symlink(lua_State* L) {
     }
     ref = luv_check_continuation(L, 4);
   }
-  req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   // ref the dest path so that we can print it in the error message
   lua_pushvalue(L, 2);
-  ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  luv_req_set_data(L, (luv_req_t*)req->data);
   FS_CALL(uv_fs_symlink, req, path, new_path, flags);
 }
 
@@ -885,7 +985,7 @@ static int luv_fs_readlink(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_readlink, req, path);
 }
@@ -895,7 +995,7 @@ static int luv_fs_realpath(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_realpath, req, path);
 }
@@ -907,7 +1007,7 @@ static int luv_fs_chown(lua_State* L) {
   uv_uid_t uid = luaL_checkinteger(L, 2);
   uv_uid_t gid = luaL_checkinteger(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_chown, req, path, uid, gid);
 }
@@ -918,7 +1018,7 @@ static int luv_fs_fchown(lua_State* L) {
   uv_uid_t uid = luaL_checkinteger(L, 2);
   uv_uid_t gid = luaL_checkinteger(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_fchown, req, file, uid, gid);
 }
@@ -930,7 +1030,7 @@ static int luv_fs_lchown(lua_State* L) {
   uv_uid_t uid = luaL_checkinteger(L, 2);
   uv_uid_t gid = luaL_checkinteger(L, 3);
   int ref = luv_check_continuation(L, 4);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_lchown, req, path, uid, gid);
 }
@@ -944,7 +1044,7 @@ static int luv_fs_copyfile(lua_State*L) {
   int flags = 0, ref;
   uv_fs_t* req;
   // callback can be the 3rd parameter
-  if (luv_is_callable(L, 3) && lua_isnone(L, 4)) {
+  if (luv_is_continuation(L, 3) && lua_isnone(L, 4)) {
     ref = luv_check_continuation(L, 3);
   } else {
     if (lua_type(L, 3) == LUA_TTABLE) {
@@ -968,11 +1068,11 @@ static int luv_fs_copyfile(lua_State*L) {
     }
     ref = luv_check_continuation(L, 4);
   }
-  req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   // ref the dest path so that we can print it in the error message
   lua_pushvalue(L, 2);
-  ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  luv_req_set_data(L, (luv_req_t*)req->data);
   FS_CALL(uv_fs_copyfile, req, path, new_path, flags);
 }
 #endif
@@ -988,12 +1088,12 @@ static int luv_fs_opendir(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
   size_t nentries = luaL_optinteger(L, 3, 1);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
 
-  //make data_ref to nentries
+  //pin nentries to the request
   lua_pushinteger(L, nentries);
-  ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  luv_req_set_data(L, (luv_req_t*)req->data);
 
   FS_CALL(uv_fs_opendir, req, path);
 }
@@ -1004,12 +1104,12 @@ static int luv_fs_readdir(lua_State* L) {
   luv_dir_t* dir = luv_check_dir(L, 1);
   int ref = luv_check_continuation(L, 2);
 
-  req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
 
   // ref the luv_dir_t so it doesn't get garbage collected before the readdir cb
   lua_pushvalue(L, 1);
-  ((luv_req_t*)req->data)->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  luv_req_set_data(L, (luv_req_t*)req->data);
 
   FS_CALL(uv_fs_readdir, req, dir->handle);
 }
@@ -1022,7 +1122,7 @@ static int luv_fs_closedir(lua_State* L) {
   luaL_unref(L, LUA_REGISTRYINDEX, dir->dirents_ref);
   dir->dirents_ref = LUA_NOREF;
 
-  uv_fs_t *req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t *req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_closedir, req, dir->handle);
 }
@@ -1056,9 +1156,315 @@ static int luv_fs_statfs(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   const char* path = luaL_checkstring(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_fs_t* req = (uv_fs_t*)lua_newuserdata(L, uv_req_size(UV_FS));
+  uv_fs_t* req = (uv_fs_t*)luv_newreq(L, UV_FS);
   req->data = luv_setup_req(L, ctx, ref);
   FS_CALL(uv_fs_statfs, req, path);
 }
 #endif
 
+
+// fs_readfile and fs_writefile run their open, read or write and close in one
+// threadpool task, queued as a uv_work_t that can be cancelled like any other.
+// The file operations are the synchronous libuv ones, so the errors are the
+// same as those of the single calls.
+typedef struct {
+  int write;
+  int atomic;
+  int flags;
+  int mode;
+  int result;        /* 0 or the libuv error that stopped it */
+  const char* data;  /* what fs_writefile writes, pinned to the request */
+  size_t len;        /* of data, or of what fs_readfile read into buf */
+  char* buf;
+  char path[1];
+} luv_fs_file_t;
+
+// Chunks stay below what a uv_buf_t can describe on every platform
+#define LUV_FS_FILE_CHUNK (1 << 30)
+
+static luv_fs_file_t* luv_fs_file_new(lua_State* L, const char* path, size_t len) {
+  luv_fs_file_t* file = (luv_fs_file_t*)malloc(sizeof(*file) + len);
+  if (!file) luaL_error(L, "Failure to allocate file request");
+  memset(file, 0, sizeof(*file));
+  memcpy(file->path, path, len + 1);
+  return file;
+}
+
+static int luv_fs_file_read(uv_loop_t* loop, luv_fs_file_t* file) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  size_t cap, chunk;
+  int fd, ret;
+  fd = uv_fs_open(loop, &req, file->path, O_RDONLY, 0, NULL);
+  uv_fs_req_cleanup(&req);
+  if (fd < 0) return fd;
+  // One byte more than the size, so the read that sees the end doesn't need
+  // a bigger buffer.  Files like those in /proc report 0 and grow it as read.
+  ret = uv_fs_fstat(loop, &req, fd, NULL);
+  cap = ret < 0 || !req.statbuf.st_size ? 4096 : (size_t)req.statbuf.st_size + 1;
+  uv_fs_req_cleanup(&req);
+  file->buf = (char*)malloc(cap);
+  ret = file->buf ? 0 : UV_ENOMEM;
+  while (!ret) {
+    if (file->len == cap) {
+      char* grown = (char*)realloc(file->buf, cap * 2);
+      if (!grown) {
+        ret = UV_ENOMEM;
+        break;
+      }
+      file->buf = grown;
+      cap *= 2;
+    }
+    chunk = cap - file->len;
+    if (chunk > LUV_FS_FILE_CHUNK) chunk = LUV_FS_FILE_CHUNK;
+    buf = uv_buf_init(file->buf + file->len, (unsigned int)chunk);
+    ret = uv_fs_read(loop, &req, fd, &buf, 1, -1, NULL);
+    uv_fs_req_cleanup(&req);
+    if (ret <= 0) break;
+    file->len += ret;
+    ret = 0;
+  }
+  uv_fs_close(loop, &req, fd, NULL);
+  uv_fs_req_cleanup(&req);
+  return ret < 0 ? ret : 0;
+}
+
+static int luv_fs_file_write_all(uv_loop_t* loop, uv_file fd, const char* data, size_t len) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  size_t chunk;
+  int ret;
+  while (len) {
+    chunk = len > LUV_FS_FILE_CHUNK ? LUV_FS_FILE_CHUNK : len;
+    buf = uv_buf_init((char*)data, (unsigned int)chunk);
+    ret = uv_fs_write(loop, &req, fd, &buf, 1, -1, NULL);
+    uv_fs_req_cleanup(&req);
+    if (ret < 0) return ret;
+    data += ret;
+    len -= ret;
+  }
+  return 0;
+}
+
+static int luv_fs_file_close(uv_loop_t* loop, uv_file fd, int ret) {
+  uv_fs_t req;
+  int err = uv_fs_close(loop, &req, fd, NULL);
+  uv_fs_req_cleanup(&req);
+  return ret < 0 ? ret : err;
+}
+
+#if LUV_UV_VERSION_GEQ(1, 34, 0)
+// Creates the temporary file of an atomic write with open's O_EXCL rather
+// than mkstemp, so that mode gets the umask applied like a plain write.
+// tmp ends with six X that are replaced until a name is free.
+static int luv_fs_file_create_tmp(uv_loop_t* loop, char* tmp, int mode) {
+  static const char chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+  char* x = tmp + strlen(tmp) - 6;
+  unsigned char bytes[6];
+  uv_fs_t req;
+  int i, j, fd = UV_EEXIST;
+  for (i = 0; i < 100 && fd == UV_EEXIST; i++) {
+    fd = uv_random(NULL, NULL, bytes, sizeof(bytes), 0, NULL);
+    if (fd < 0) break;
+    for (j = 0; j < 6; j++)
+      x[j] = chars[bytes[j] % (sizeof(chars) - 1)];
+    fd = uv_fs_open(loop, &req, tmp, O_CREAT | O_EXCL | O_WRONLY, mode, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+  return fd;
+}
+#endif
+
+// An atomic write goes to a temporary file next to the target, which is
+// flushed to disk and renamed over the target, so readers see either the
+// old content or the new one.  An existing target keeps its mode and, when
+// the process may set it, its owner.
+static int luv_fs_file_write(uv_loop_t* loop, luv_fs_file_t* file) {
+  uv_fs_t req;
+  int fd, ret;
+  if (!file->atomic) {
+    fd = uv_fs_open(loop, &req, file->path, file->flags, file->mode, NULL);
+    uv_fs_req_cleanup(&req);
+    if (fd < 0) return fd;
+    ret = luv_fs_file_write_all(loop, fd, file->data, file->len);
+    return luv_fs_file_close(loop, fd, ret);
+  }
+#if LUV_UV_VERSION_GEQ(1, 34, 0)
+  {
+    size_t len = strlen(file->path);
+    int existing;
+    uv_stat_t st;
+    char* tmp = (char*)malloc(len + sizeof(".XXXXXX"));
+    if (!tmp) return UV_ENOMEM;
+    memcpy(tmp, file->path, len);
+    memcpy(tmp + len, ".XXXXXX", sizeof(".XXXXXX"));
+    existing = uv_fs_stat(loop, &req, file->path, NULL) == 0;
+    if (existing) st = req.statbuf;
+    uv_fs_req_cleanup(&req);
+    fd = luv_fs_file_create_tmp(loop, tmp, file->mode);
+    if (fd < 0) {
+      free(tmp);
+      return fd;
+    }
+    ret = 0;
+    if (existing) {
+      // Changing the owner is up to privileges, failing that is no error
+      uv_fs_fchown(loop, &req, fd, (uv_uid_t)st.st_uid, (uv_gid_t)st.st_gid, NULL);
+      uv_fs_req_cleanup(&req);
+      ret = uv_fs_fchmod(loop, &req, fd, (int)(st.st_mode & 07777), NULL);
+      uv_fs_req_cleanup(&req);
+    }
+    if (!ret) ret = luv_fs_file_write_all(loop, fd, file->data, file->len);
+    if (!ret) {
+      ret = uv_fs_fsync(loop, &req, fd, NULL);
+      uv_fs_req_cleanup(&req);
+    }
+    ret = luv_fs_file_close(loop, fd, ret);
+    if (!ret) {
+      ret = uv_fs_rename(loop, &req, tmp, file->path, NULL);
+      uv_fs_req_cleanup(&req);
+    }
+    if (ret < 0) {
+      uv_fs_unlink(loop, &req, tmp, NULL);
+      uv_fs_req_cleanup(&req);
+    }
+    free(tmp);
+    return ret;
+  }
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+// Pushes the result the way push_fs_result does, nil and the error message
+// when it failed.  Releases what was read.
+static int luv_fs_file_push(lua_State* L, luv_fs_file_t* file) {
+  int nargs = 1;
+  if (file->result < 0) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "%s: %s: %s", uv_err_name(file->result), uv_strerror(file->result), file->path);
+    nargs = 2;
+  }
+  else if (file->write) {
+    lua_pushinteger(L, file->len);
+  }
+  else {
+    lua_pushlstring(L, file->buf, file->len);
+  }
+  free(file->buf);
+  file->buf = NULL;
+  return nargs;
+}
+
+static void luv_fs_file_work_cb(uv_work_t* req) {
+  luv_fs_file_t* file = (luv_fs_file_t*)((luv_req_t*)req->data)->data;
+  if (file->write)
+    file->result = luv_fs_file_write(req->loop, file);
+  else
+    file->result = luv_fs_file_read(req->loop, file);
+}
+
+static void luv_fs_file_after_work_cb(uv_work_t* req, int status) {
+  luv_req_t* data = (luv_req_t*)req->data;
+  lua_State* L = data->ctx->L;
+  luv_fs_file_t* file = (luv_fs_file_t*)data->data;
+  int nargs;
+  if (status < 0) file->result = status;
+  nargs = luv_fs_file_push(L, file);
+  // Convert to (err, value) format like luv_fs_cb
+  if (nargs == 2) {
+    lua_remove(L, -2);
+    nargs = 1;
+  }
+  else {
+    lua_pushnil(L);
+    lua_insert(L, -2);
+    nargs = 2;
+  }
+  req->data = NULL;
+  luv_fulfill_req(L, data, nargs);
+  luv_cleanup_req(L, data);
+}
+
+// Runs the file operation right away without a continuation, otherwise
+// queues it and returns the request.  The value at pin stays alive with it.
+static int luv_fs_file_start(lua_State* L, luv_ctx_t* ctx, int ref, luv_fs_file_t* file, int pin) {
+  uv_work_t* req;
+  luv_req_t* data;
+  int ret;
+  if (ref == LUA_NOREF) {
+    int nargs;
+    if (file->write)
+      file->result = luv_fs_file_write(ctx->loop, file);
+    else
+      file->result = luv_fs_file_read(ctx->loop, file);
+    nargs = luv_fs_file_push(L, file);
+    if (nargs == 2) {
+      lua_pushstring(L, uv_err_name(file->result));
+      nargs = 3;
+    }
+    free(file);
+    return nargs;
+  }
+  req = (uv_work_t*)luv_newreq(L, UV_WORK);
+  data = luv_setup_req(L, ctx, ref);
+  data->data = file;
+  req->data = data;
+  if (pin) {
+    lua_pushvalue(L, pin);
+    luv_req_set_data(L, data);
+  }
+  ret = uv_queue_work(ctx->loop, req, luv_fs_file_work_cb, luv_fs_file_after_work_cb);
+  if (ret < 0) {
+    req->data = NULL;
+    luv_cleanup_req(L, data);
+    return luv_error(L, ret);
+  }
+  return 1;
+}
+
+static int luv_fs_readfile(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  size_t len;
+  const char* path = luaL_checklstring(L, 1, &len);
+  int ref = luv_check_continuation(L, 2);
+  luv_fs_file_t* file = luv_fs_file_new(L, path, len);
+  return luv_fs_file_start(L, ctx, ref, file, 0);
+}
+
+static int luv_fs_writefile(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  size_t len;
+  const char* path = luaL_checklstring(L, 1, &len);
+  int flags = O_TRUNC | O_CREAT | O_WRONLY, mode = 0644, atomic = 0, ref;
+  luv_fs_file_t* file;
+  luaL_checktype(L, 2, LUA_TSTRING);
+  // callback can be the 3rd parameter
+  if (luv_is_continuation(L, 3) && lua_isnone(L, 4)) {
+    ref = luv_check_continuation(L, 3);
+  } else {
+    if (lua_type(L, 3) == LUA_TTABLE) {
+      lua_getfield(L, 3, "flags");
+      if (!lua_isnil(L, -1)) flags = luv_check_flags(L, lua_gettop(L));
+      lua_pop(L, 1);
+      lua_getfield(L, 3, "mode");
+      if (!lua_isnil(L, -1)) mode = luaL_checkinteger(L, -1);
+      lua_pop(L, 1);
+      lua_getfield(L, 3, "atomic");
+      atomic = lua_toboolean(L, -1);
+      lua_pop(L, 1);
+    }
+    else if (!lua_isnoneornil(L, 3)) {
+      flags = luv_check_flags(L, 3);
+    }
+    ref = luv_check_continuation(L, 4);
+  }
+  file = luv_fs_file_new(L, path, len);
+  file->write = 1;
+  file->atomic = atomic;
+  file->flags = flags;
+  file->mode = mode;
+  file->data = lua_tolstring(L, 2, &file->len);
+  return luv_fs_file_start(L, ctx, ref, file, 2);
+}
@@ -25,7 +25,7 @@ static uv_fs_poll_t* luv_check_fs_poll(lua_State* L, int index) {
 
 static int luv_new_fs_poll(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
-  uv_fs_poll_t* handle = (uv_fs_poll_t*)luv_newuserdata(L, uv_handle_size(UV_FS_POLL));
+  uv_fs_poll_t* handle = (uv_fs_poll_t*)luv_newhandle(L, UV_FS_POLL);
   int ret = uv_fs_poll_init(ctx->loop, handle);
   if (ret < 0) {
     lua_pop(L, 1);
@@ -35,16 +35,33 @@ static int luv_new_fs_poll(lua_State* L) {
   return 1;
 }
 
+// The stat fields start was given are kept in luv_handle_t.extra, events
+// carry the full tables when there is none.
+static void luv_fs_poll_set_fields(lua_State* L, luv_handle_t* data, int mask) {
+  if (mask < 0) {
+    free(data->extra);
+    data->extra = NULL;
+    return;
+  }
+  if (!data->extra) {
+    data->extra = malloc(sizeof(int));
+    if (!data->extra) luaL_error(L, "out of memory");
+    data->extra_gc = free;
+  }
+  *(int*)data->extra = mask;
+}
+
 static void luv_fs_poll_cb(uv_fs_poll_t* handle, int status, const uv_stat_t* prev, const uv_stat_t* curr) {
   luv_handle_t* data = (luv_handle_t*)handle->data;
   lua_State* L = data->ctx->L;
+  int mask = data->extra ? *(int*)data->extra : LUV_STAT_ALL;
 
   // err
   luv_status(L, status);
 
   // prev
   if (prev) {
-    luv_push_stats_table(L, prev);
+    luv_push_stats_fields(L, prev, mask);
   }
   else {
     lua_pushnil(L);
@@ -52,7 +69,7 @@ static void luv_fs_poll_cb(uv_fs_poll_t* handle, int status, const uv_stat_t* pr
 
   // curr
   if (curr) {
-    luv_push_stats_table(L, curr);
+    luv_push_stats_fields(L, curr, mask);
   }
   else {
     lua_pushnil(L);
@@ -65,8 +82,10 @@ static int luv_fs_poll_start(lua_State* L) {
   uv_fs_poll_t* handle = luv_check_fs_poll(L, 1);
   const char* path = luaL_checkstring(L, 2);
   unsigned int interval = luaL_checkinteger(L, 3);
+  int mask = luv_fs_check_stat_args(L, 4);
   int ret;
-  luv_check_callback(L, (luv_handle_t*)handle->data, LUV_FS_POLL, 4);
+  luv_check_callback(L, (luv_handle_t*)handle->data, LUV_FS_POLL, lua_gettop(L));
+  luv_fs_poll_set_fields(L, (luv_handle_t*)handle->data, mask);
   ret = uv_fs_poll_start(handle, luv_fs_poll_cb, path, interval);
   return luv_result(L, ret);
 }
@@ -0,0 +1,498 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+// fs_walk reads directories in threadpool tasks, each of which keeps going
+// depth first through the directories it finds until it has a batch of
+// entries.  Back on the loop the batch goes to Lua in one call and what the
+// task has not read yet is queued for the next tasks, up to `parallel` of
+// them at a time.  The synchronous libuv calls are used within a task.
+
+// A directory still to be read
+typedef struct luv_walk_dir_s {
+  struct luv_walk_dir_s* next;
+  int depth;       /* of its entries, 1 for those of the root */
+  int nids;        /* device and inode pairs in ids */
+  uint64_t* ids;   /* of it and the directories above, when following links */
+  char* rel;       /* path relative to the root, "" for the root */
+} luv_walk_dir_t;
+
+typedef struct {
+  char* base;
+  size_t len;
+  size_t cap;
+} luv_walk_buf_t;
+
+typedef struct {
+  luv_ctx_t* ctx;
+  int cb_ref;
+  int max_depth;   /* 0 for no limit */
+  int follow;
+  int batch;
+  int parallel;
+  int running;     /* tasks queued */
+  luv_walk_dir_t* pending;
+  char* root;
+  char* prefix;    /* NULL for no filter */
+  char* glob;
+} luv_walker_t;
+
+typedef struct luv_walk_error_s {
+  struct luv_walk_error_s* next;
+  int code;
+  char path[1];
+} luv_walk_error_t;
+
+typedef struct {
+  uv_work_t req;   /* must be first */
+  luv_walker_t* walker;
+  luv_walk_dir_t* dirs;    /* stack of directories to read */
+  luv_walk_buf_t path;     /* scratch for full paths */
+  luv_walk_buf_t names;    /* NUL terminated paths of the batch */
+  const char** types;
+  int count;
+  int cap;
+  luv_walk_error_t* errors;
+  int failed;              /* ran out of memory */
+} luv_walk_task_t;
+
+static int luv_walk_buf_put(luv_walk_buf_t* buf, const char* s, size_t len) {
+  if (buf->len + len + 1 > buf->cap) {
+    size_t cap = buf->cap ? buf->cap * 2 : 256;
+    char* base;
+    while (cap < buf->len + len + 1) cap *= 2;
+    base = (char*)realloc(buf->base, cap);
+    if (!base) return UV_ENOMEM;
+    buf->base = base;
+    buf->cap = cap;
+  }
+  memcpy(buf->base + buf->len, s, len);
+  buf->len += len;
+  buf->base[buf->len] = '\0';
+  return 0;
+}
+
+static luv_walk_dir_t* luv_walk_dir_new(const char* rel, size_t len, int depth, int nids) {
+  luv_walk_dir_t* dir = (luv_walk_dir_t*)malloc(sizeof(*dir) + nids * 2 * sizeof(uint64_t) + len + 1);
+  if (!dir) return NULL;
+  dir->next = NULL;
+  dir->depth = depth;
+  dir->nids = 0;
+  dir->ids = (uint64_t*)(dir + 1);
+  dir->rel = (char*)(dir->ids + nids * 2);
+  memcpy(dir->rel, rel, len);
+  dir->rel[len] = '\0';
+  return dir;
+}
+
+static void luv_walk_dirs_free(luv_walk_dir_t* dir) {
+  while (dir) {
+    luv_walk_dir_t* next = dir->next;
+    free(dir);
+    dir = next;
+  }
+}
+
+// * matches any run of characters and ? any one character
+static int luv_walk_glob(const char* pattern, const char* name) {
+  for (; *pattern; pattern++, name++) {
+    if (*pattern == '*') {
+      while (pattern[1] == '*') pattern++;
+      if (!pattern[1]) return 1;
+      for (; *name; name++)
+        if (luv_walk_glob(pattern + 1, name)) return 1;
+      return 0;
+    }
+    if (!*name || (*pattern != '?' && *pattern != *name)) return 0;
+  }
+  return !*name;
+}
+
+static const char* luv_walk_dirent_type(uv_dirent_type_t type) {
+  switch (type) {
+    case UV_DIRENT_FILE:   return "file";
+    case UV_DIRENT_DIR:    return "directory";
+    case UV_DIRENT_LINK:   return "link";
+    case UV_DIRENT_FIFO:   return "fifo";
+    case UV_DIRENT_SOCKET: return "socket";
+    case UV_DIRENT_CHAR:   return "char";
+    case UV_DIRENT_BLOCK:  return "block";
+    default:               return "unknown";
+  }
+}
+
+static void luv_walk_error(luv_walk_task_t* task, int code, const char* path) {
+  size_t len = strlen(path);
+  luv_walk_error_t* error = (luv_walk_error_t*)malloc(sizeof(*error) + len);
+  if (!error) {
+    task->failed = 1;
+    return;
+  }
+  error->code = code;
+  memcpy(error->path, path, len + 1);
+  error->next = task->errors;
+  task->errors = error;
+}
+
+static void luv_walk_add(luv_walk_task_t* task, const char* rel, size_t len, const char* type) {
+  if (task->count == task->cap) {
+    int cap = task->cap ? task->cap * 2 : 64;
+    const char** types = (const char**)realloc((void*)task->types, cap * sizeof(*types));
+    if (!types) {
+      task->failed = 1;
+      return;
+    }
+    task->types = types;
+    task->cap = cap;
+  }
+  if (luv_walk_buf_put(&task->names, rel, len + 1) < 0) {
+    task->failed = 1;
+    return;
+  }
+  task->types[task->count++] = type;
+}
+
+// Whether rel lies under the prefix, or is a directory on the way to it
+static int luv_walk_prefix(const luv_walker_t* w, const char* rel, size_t len, int* under) {
+  size_t plen;
+  if (!w->prefix) {
+    *under = 1;
+    return 1;
+  }
+  plen = strlen(w->prefix);
+  *under = strncmp(rel, w->prefix, plen) == 0;
+  return *under || (len < plen && strncmp(w->prefix, rel, len) == 0 && w->prefix[len] == '/');
+}
+
+static void luv_walk_read_dir(luv_walk_task_t* task, luv_walk_dir_t* dir) {
+  luv_walker_t* w = task->walker;
+  uv_loop_t* loop = w->ctx->loop;
+  uv_fs_t req, sreq;
+  uv_dirent_t ent;
+  size_t base;
+  int ret;
+
+  task->path.len = 0;
+  if (luv_walk_buf_put(&task->path, w->root, strlen(w->root)) < 0 ||
+      (*dir->rel && (luv_walk_buf_put(&task->path, "/", 1) < 0 ||
+                     luv_walk_buf_put(&task->path, dir->rel, strlen(dir->rel)) < 0))) {
+    task->failed = 1;
+    return;
+  }
+  // The root has room for its own id, the others got theirs from the parent
+  if (w->follow && dir->depth == 1) {
+    if (uv_fs_stat(loop, &sreq, task->path.base, NULL) == 0) {
+      dir->ids[0] = sreq.statbuf.st_dev;
+      dir->ids[1] = sreq.statbuf.st_ino;
+      dir->nids = 1;
+    }
+    uv_fs_req_cleanup(&sreq);
+  }
+  ret = uv_fs_scandir(loop, &req, task->path.base, 0, NULL);
+  if (ret < 0) {
+    luv_walk_error(task, ret, task->path.base);
+    uv_fs_req_cleanup(&req);
+    return;
+  }
+  if (luv_walk_buf_put(&task->path, "/", 1) < 0) {
+    task->failed = 1;
+    uv_fs_req_cleanup(&req);
+    return;
+  }
+  base = task->path.len;
+
+  while (!task->failed && uv_fs_scandir_next(&req, &ent) != UV_EOF) {
+    const char* type = luv_walk_dirent_type(ent.type);
+    const char* rel;
+    size_t len;
+    int under, descend, have_stat = 0;
+
+    task->path.len = base;
+    if (luv_walk_buf_put(&task->path, ent.name, strlen(ent.name)) < 0) {
+      task->failed = 1;
+      break;
+    }
+    rel = task->path.base + strlen(w->root) + 1;
+    len = task->path.base + task->path.len - rel;
+
+    if (ent.type == UV_DIRENT_UNKNOWN || (ent.type == UV_DIRENT_LINK && w->follow)) {
+      if (w->follow)
+        ret = uv_fs_stat(loop, &sreq, task->path.base, NULL);
+      else
+        ret = uv_fs_lstat(loop, &sreq, task->path.base, NULL);
+      // A dangling link stays a link
+      if (ret == 0) {
+        const char* stat_type = luv_stat_type(&sreq.statbuf);
+        if (stat_type) type = stat_type;
+        have_stat = 1;
+      }
+      else {
+        uv_fs_req_cleanup(&sreq);
+      }
+    }
+
+    descend = luv_walk_prefix(w, rel, len, &under) && strcmp(type, "directory") == 0 &&
+              (!w->max_depth || dir->depth < w->max_depth);
+    if (descend && w->follow && !have_stat) {
+      have_stat = uv_fs_stat(loop, &sreq, task->path.base, NULL) == 0;
+      if (!have_stat) {
+        uv_fs_req_cleanup(&sreq);
+        descend = 0;
+      }
+    }
+    if (descend && w->follow) {
+      // A link back to a directory above would never end
+      int i;
+      for (i = 0; i < dir->nids; i++) {
+        if (dir->ids[i * 2] == sreq.statbuf.st_dev && dir->ids[i * 2 + 1] == sreq.statbuf.st_ino)
+          descend = 0;
+      }
+    }
+    if (descend) {
+      luv_walk_dir_t* sub = luv_walk_dir_new(rel, len, dir->depth + 1, w->follow ? dir->nids + 1 : 0);
+      if (!sub) {
+        task->failed = 1;
+      }
+      else {
+        if (w->follow) {
+          memcpy(sub->ids, dir->ids, dir->nids * 2 * sizeof(uint64_t));
+          sub->ids[dir->nids * 2] = sreq.statbuf.st_dev;
+          sub->ids[dir->nids * 2 + 1] = sreq.statbuf.st_ino;
+          sub->nids = dir->nids + 1;
+        }
+        sub->next = task->dirs;
+        task->dirs = sub;
+      }
+    }
+    if (have_stat) uv_fs_req_cleanup(&sreq);
+    if (under && (!w->glob || luv_walk_glob(w->glob, ent.name)))
+      luv_walk_add(task, rel, len, type);
+  }
+  uv_fs_req_cleanup(&req);
+}
+
+static void luv_walk_work_cb(uv_work_t* req) {
+  luv_walk_task_t* task = (luv_walk_task_t*)req;
+  // Stops at the end of the directory that fills the batch
+  while (task->dirs && task->count < task->walker->batch && !task->failed) {
+    luv_walk_dir_t* dir = task->dirs;
+    task->dirs = dir->next;
+    luv_walk_read_dir(task, dir);
+    free(dir);
+  }
+}
+
+static void luv_walk_after_work_cb(uv_work_t* req, int status);
+
+// Queues tasks for the pending directories, all of them for a single task,
+// otherwise one each so the subtrees are spread over the tasks
+static int luv_walk_schedule(luv_walker_t* w) {
+  while (w->pending && w->running < w->parallel) {
+    luv_walk_task_t* task = (luv_walk_task_t*)malloc(sizeof(*task));
+    int ret;
+    if (!task) return UV_ENOMEM;
+    memset(task, 0, sizeof(*task));
+    task->walker = w;
+    task->dirs = w->pending;
+    if (w->parallel > 1) {
+      w->pending = w->pending->next;
+      task->dirs->next = NULL;
+    }
+    else {
+      w->pending = NULL;
+    }
+    ret = uv_queue_work(w->ctx->loop, &task->req, luv_walk_work_cb, luv_walk_after_work_cb);
+    if (ret < 0) {
+      luv_walk_dirs_free(task->dirs);
+      free(task);
+      return ret;
+    }
+    w->running++;
+  }
+  return 0;
+}
+
+static void luv_walk_free(lua_State* L, luv_walker_t* w) {
+  luaL_unref(L, LUA_REGISTRYINDEX, w->cb_ref);
+  luv_walk_dirs_free(w->pending);
+  free(w->root);
+  free(w->prefix);
+  free(w->glob);
+  free(w);
+}
+
+static void luv_walk_push_error(lua_State* L, int code, const char* path) {
+  lua_pushfstring(L, "%s: %s: %s", uv_err_name(code), uv_strerror(code), path);
+}
+
+static void luv_walk_after_work_cb(uv_work_t* req, int status) {
+  luv_walk_task_t* task = (luv_walk_task_t*)req;
+  luv_walker_t* w = task->walker;
+  luv_ctx_t* ctx = w->ctx;
+  lua_State* L = ctx->L;
+  luv_walk_error_t* error;
+  luv_walk_dir_t* last;
+  int i, ret;
+
+  w->running--;
+  if (task->count) {
+    const char* name = task->names.base;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, w->cb_ref);
+    lua_pushnil(L);
+    lua_createtable(L, task->count, 0);
+    lua_createtable(L, task->count, 0);
+    for (i = 0; i < task->count; i++) {
+      size_t len = strlen(name);
+      lua_pushlstring(L, name, len);
+      lua_rawseti(L, -3, i + 1);
+      lua_pushstring(L, task->types[i]);
+      lua_rawseti(L, -2, i + 1);
+      name += len + 1;
+    }
+    ctx->cb_pcall(L, 3, 0, 0);
+  }
+  for (error = task->errors; error; error = task->errors) {
+    task->errors = error->next;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, w->cb_ref);
+    luv_walk_push_error(L, error->code, error->path);
+    ctx->cb_pcall(L, 1, 0, 0);
+    free(error);
+  }
+  if (status < 0 || task->failed) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, w->cb_ref);
+    luv_walk_push_error(L, status < 0 ? status : UV_ENOMEM, w->root);
+    ctx->cb_pcall(L, 1, 0, 0);
+    luv_walk_dirs_free(task->dirs);
+    task->dirs = NULL;
+  }
+
+  // What is left goes first, so the walk stays depth first
+  if (task->dirs) {
+    for (last = task->dirs; last->next; last = last->next);
+    last->next = w->pending;
+    w->pending = task->dirs;
+  }
+  free(task->path.base);
+  free(task->names.base);
+  free((void*)task->types);
+  free(task);
+
+  ret = luv_walk_schedule(w);
+  if (ret < 0) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, w->cb_ref);
+    luv_walk_push_error(L, ret, w->root);
+    ctx->cb_pcall(L, 1, 0, 0);
+    luv_walk_dirs_free(w->pending);
+    w->pending = NULL;
+  }
+  if (!w->running) {
+    // The end of the walk
+    lua_rawgeti(L, LUA_REGISTRYINDEX, w->cb_ref);
+    lua_pushnil(L);
+    lua_pushnil(L);
+    ctx->cb_pcall(L, 2, 0, 0);
+    luv_walk_free(L, w);
+  }
+}
+
+// The string stays alive in the options table for the call
+static const char* luv_walk_opt_string(lua_State* L, int index, const char* name) {
+  const char* s = NULL;
+  lua_getfield(L, index, name);
+  if (!lua_isnil(L, -1)) {
+    luaL_argcheck(L, lua_type(L, -1) == LUA_TSTRING, index, lua_pushfstring(L, "%s option must be a string", name));
+    s = lua_tostring(L, -1);
+  }
+  lua_pop(L, 1);
+  return s;
+}
+
+static char* luv_walk_strdup(const char* s) {
+  size_t len;
+  char* copy;
+  if (!s) return NULL;
+  len = strlen(s);
+  copy = (char*)malloc(len + 1);
+  if (copy) memcpy(copy, s, len + 1);
+  return copy;
+}
+
+static int luv_walk_opt_int(lua_State* L, int index, const char* name, int def, int min) {
+  lua_Integer value;
+  lua_getfield(L, index, name);
+  value = luaL_optinteger(L, -1, def);
+  luaL_argcheck(L, value >= min && value <= INT_MAX, index, lua_pushfstring(L, "%s option out of range", name));
+  lua_pop(L, 1);
+  return (int)value;
+}
+
+static int luv_fs_walk(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  size_t len;
+  const char* root = luaL_checklstring(L, 1, &len);
+  const char* prefix = NULL;
+  const char* glob = NULL;
+  luv_walker_t* w;
+  int max_depth = 0, follow = 0, batch = 1024, parallel = 1, ret;
+  int cb = 3;
+  // opts can be omitted
+  if (luv_is_callable(L, 2) && lua_isnone(L, 3)) {
+    cb = 2;
+  }
+  else if (!lua_isnoneornil(L, 2)) {
+    luaL_checktype(L, 2, LUA_TTABLE);
+    max_depth = luv_walk_opt_int(L, 2, "max_depth", 0, 0);
+    batch = luv_walk_opt_int(L, 2, "batch", batch, 1);
+    parallel = luv_walk_opt_int(L, 2, "parallel", parallel, 1);
+    lua_getfield(L, 2, "follow_symlinks");
+    follow = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    prefix = luv_walk_opt_string(L, 2, "prefix");
+    glob = luv_walk_opt_string(L, 2, "glob");
+  }
+  luv_check_callable(L, cb);
+
+  w = (luv_walker_t*)malloc(sizeof(*w));
+  if (!w) return luaL_error(L, "Failed to allocate walker");
+  memset(w, 0, sizeof(*w));
+  w->ctx = ctx;
+  w->max_depth = max_depth;
+  w->follow = follow;
+  w->batch = batch;
+  w->parallel = parallel;
+  w->root = luv_walk_strdup(root);
+  w->prefix = luv_walk_strdup(prefix);
+  w->glob = luv_walk_strdup(glob);
+  w->pending = luv_walk_dir_new("", 0, 1, 1);
+  w->cb_ref = LUA_NOREF;
+  if (!w->root || !w->pending || (prefix && !w->prefix) || (glob && !w->glob)) {
+    luv_walk_free(L, w);
+    return luaL_error(L, "Failed to allocate walker");
+  }
+  // Trailing separators would double up in the joined paths
+  while (len > 1 && (w->root[len - 1] == '/' || w->root[len - 1] == '\\'))
+    w->root[--len] = '\0';
+  lua_pushvalue(L, cb);
+  w->cb_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+  ret = luv_walk_schedule(w);
+  if (ret < 0) {
+    luv_walk_free(L, w);
+    return luv_error(L, ret);
+  }
+  return luv_result(L, 0);
+}
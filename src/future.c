@@ -0,0 +1,379 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+// A future is resolved once with the arguments a callback would get, in
+// particular when it is passed to a request in place of its callback.  The
+// futures made by the combinators are resolved in C by the futures they
+// combine, so Lua only hears about the combined result.
+//
+// Its userdata keeps the values in user value slot LUV_FUTURE_VALUES, as a
+// table with a field n, and what waits for it in slot LUV_FUTURE_WAITERS as
+// pairs of the waiter and an integer: the position of the future in the
+// waiter's list when the waiter is a future, 0 for a function or coroutine.
+#define LUV_FUTURE_VALUES 1
+#define LUV_FUTURE_WAITERS 2
+
+#define LUV_FUTURE_PLAIN 0
+#define LUV_FUTURE_ALL 1
+#define LUV_FUTURE_ANY 2
+#define LUV_FUTURE_RACE 3
+#define LUV_FUTURE_TIMEOUT 4
+
+struct luv_future_s;
+
+typedef struct {
+  uv_timer_t handle; /* must be first */
+  int ref;           /* the future, until it is resolved */
+  luv_ctx_t* ctx;
+  struct luv_future_s* future;
+  luv_internal_t internal;
+} luv_future_timer_t;
+
+typedef struct luv_future_s {
+  luv_ctx_t* ctx;
+  int kind;
+  int resolved;
+  lua_Integer pending;       /* futures all and any still wait for */
+  luv_future_timer_t* timer; /* running timer of a timeout */
+} luv_future_t;
+
+static int luv_is_future(lua_State* L, int index) {
+  return luaL_testudata(L, index, "uv_future") != NULL;
+}
+
+static luv_future_t* luv_check_future(lua_State* L, int index) {
+  return (luv_future_t*)luaL_checkudata(L, index, "uv_future");
+}
+
+static luv_future_t* luv_push_future(lua_State* L, luv_ctx_t* ctx, int kind) {
+  luv_future_t* f = (luv_future_t*)luv_newuserdata_slots(L, sizeof(*f));
+  memset(f, 0, sizeof(*f));
+  f->ctx = ctx;
+  f->kind = kind;
+  luaL_getmetatable(L, "uv_future");
+  lua_setmetatable(L, -2);
+  lua_pushnil(L);
+  luv_setslot(L, -2, LUV_FUTURE_VALUES, 1);
+  return f;
+}
+
+// Pushes the values of a resolved future and returns their number
+static int luv_future_push_values(lua_State* L, int index) {
+  int i, n;
+  luv_getslot(L, index, LUV_FUTURE_VALUES);
+  lua_getfield(L, -1, "n");
+  n = (int)lua_tointeger(L, -1);
+  lua_pop(L, 1);
+  luaL_checkstack(L, n, NULL);
+  for (i = 1; i <= n; i++)
+    lua_rawgeti(L, -i, i);
+  lua_remove(L, -1 - n);
+  return n;
+}
+
+static void luv_future_add_waiter(lua_State* L, int index, int waiter, lua_Integer pos) {
+  int n;
+  waiter = lua_absindex(L, waiter);
+  luv_getslot(L, index, LUV_FUTURE_WAITERS);
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    lua_createtable(L, 2, 0);
+    lua_pushvalue(L, -1);
+    luv_setslot(L, index, LUV_FUTURE_WAITERS, 0);
+  }
+  n = (int)lua_rawlen(L, -1);
+  lua_pushvalue(L, waiter);
+  lua_rawseti(L, -2, n + 1);
+  lua_pushinteger(L, pos);
+  lua_rawseti(L, -2, n + 2);
+  lua_pop(L, 1);
+}
+
+static void luv_future_timer_close_cb(uv_handle_t* handle) {
+  free(handle);
+}
+
+static void luv_future_timer_stop(lua_State* L, luv_future_t* f) {
+  luv_future_timer_t* timer = f->timer;
+  f->timer = NULL;
+  luaL_unref(L, LUA_REGISTRYINDEX, timer->ref);
+  luv_internal_remove(timer->ctx, &timer->internal);
+  uv_close((uv_handle_t*)&timer->handle, luv_future_timer_close_cb);
+}
+
+// The loop is torn down with the timeout still running, the future is left
+// unresolved
+static void luv_future_timer_teardown(uv_handle_t* handle) {
+  luv_future_timer_t* timer = (luv_future_timer_t*)handle;
+  luv_future_timer_stop(timer->ctx->L, timer->future);
+}
+
+static void luv_future_settle(lua_State* L, int index, int child, lua_Integer pos);
+
+// Resolves the future at index with the nargs values on top of the stack and
+// pops them.  Returns 0 if it was resolved already.
+static int luv_future_resolve(lua_State* L, int index, int nargs) {
+  luv_future_t* f;
+  int i, n, waiters;
+  index = lua_absindex(L, index);
+  f = (luv_future_t*)lua_touserdata(L, index);
+  if (f->resolved) {
+    lua_pop(L, nargs);
+    return 0;
+  }
+  f->resolved = 1;
+  if (f->timer) luv_future_timer_stop(L, f);
+
+  lua_createtable(L, nargs, 1);
+  lua_insert(L, -1 - nargs);
+  for (i = nargs; i > 0; i--)
+    lua_rawseti(L, -1 - i, i);
+  lua_pushinteger(L, nargs);
+  lua_setfield(L, -2, "n");
+  luv_setslot(L, index, LUV_FUTURE_VALUES, 0);
+
+  luv_getslot(L, index, LUV_FUTURE_WAITERS);
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    return 1;
+  }
+  lua_pushnil(L);
+  luv_setslot(L, index, LUV_FUTURE_WAITERS, 0);
+  waiters = lua_gettop(L);
+  n = (int)lua_rawlen(L, waiters);
+  for (i = 1; i < n; i += 2) {
+    lua_rawgeti(L, waiters, i);
+    if (luv_is_future(L, -1)) {
+      lua_rawgeti(L, waiters, i + 1);
+      luv_future_settle(L, -2, index, lua_tointeger(L, -1));
+      lua_pop(L, 2);
+    }
+    else {
+      luv_call_continuation(L, f->ctx, luv_future_push_values(L, index));
+    }
+  }
+  lua_pop(L, 1);
+  return 1;
+}
+
+// Called when the future at child, in position pos of the combined future
+// at index, is resolved.  Values whose first one is not nil count as failure
+// like the error argument of a callback.
+static void luv_future_settle(lua_State* L, int index, int child, lua_Integer pos) {
+  luv_future_t* f;
+  int failed;
+  index = lua_absindex(L, index);
+  child = lua_absindex(L, child);
+  f = (luv_future_t*)lua_touserdata(L, index);
+  if (f->resolved) return;
+  luv_getslot(L, child, LUV_FUTURE_VALUES);
+  lua_rawgeti(L, -1, 1);
+  failed = !lua_isnil(L, -1);
+  lua_pop(L, 2);
+
+  // A future waiting on its own just takes the values
+  switch (pos ? f->kind : LUV_FUTURE_PLAIN) {
+    case LUV_FUTURE_ALL:
+      if (!failed) {
+        luv_getslot(L, index, LUV_FUTURE_VALUES);
+        luv_getslot(L, child, LUV_FUTURE_VALUES);
+        lua_rawgeti(L, -1, 2);
+        lua_rawseti(L, -3, pos);
+        lua_pop(L, 1);
+        if (--f->pending) {
+          lua_pop(L, 1);
+          return;
+        }
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        luv_future_resolve(L, index, 2);
+        return;
+      }
+      break;
+    case LUV_FUTURE_ANY:
+      // The last failure stands for all of them
+      if (failed && --f->pending) return;
+      break;
+  }
+  luv_future_resolve(L, index, luv_future_push_values(L, child));
+}
+
+static void luv_future_timer_cb(uv_timer_t* handle) {
+  luv_future_timer_t* timer = (luv_future_timer_t*)handle;
+  lua_State* L = timer->ctx->L;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, timer->ref);
+  luv_status(L, UV_ETIMEDOUT);
+  luv_future_resolve(L, -2, 1);
+  lua_pop(L, 1);
+}
+
+static int luv_new_future(lua_State* L) {
+  luv_push_future(L, luv_context(L), LUV_FUTURE_PLAIN);
+  return 1;
+}
+
+static int luv_future_resolve_values(lua_State* L) {
+  int nargs = lua_gettop(L) - 1;
+  luv_check_future(L, 1);
+  lua_pushboolean(L, luv_future_resolve(L, 1, nargs));
+  return 1;
+}
+
+// A continuation waiting for a future that is resolved already is called
+// the way uv.defer calls its function, so the caller can yield first.
+static int luv_future_wait(lua_State* L) {
+  luv_future_t* f = luv_check_future(L, 1);
+  lua_settop(L, 2);
+  luaL_argcheck(L, luv_is_continuation(L, 2), 2, "expected a function, coroutine or future");
+  if (!f->resolved) {
+    luv_future_add_waiter(L, 1, 2, 0);
+  }
+  else if (luv_is_future(L, 2)) {
+    luv_future_settle(L, 2, 1, 0);
+  }
+  else {
+    int ret;
+    if (lua_type(L, 2) == LUA_TTHREAD) {
+      lua_pushcfunction(L, luv_resume_continuation);
+      lua_insert(L, 2);
+    }
+    luv_future_push_values(L, 1);
+    ret = luv_dispatch_push(L, f->ctx, lua_gettop(L) - 2);
+    if (ret < 0) return luv_error(L, ret);
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int luv_future_get(lua_State* L) {
+  luv_future_t* f = luv_check_future(L, 1);
+  lua_pushboolean(L, f->resolved);
+  if (!f->resolved) return 1;
+  return 1 + luv_future_push_values(L, 1);
+}
+
+static int luv_future_combine(lua_State* L, int kind) {
+  luv_future_t* f;
+  int i, n, index;
+  luaL_checktype(L, 1, LUA_TTABLE);
+  n = (int)lua_rawlen(L, 1);
+  for (i = 1; i <= n; i++) {
+    lua_rawgeti(L, 1, i);
+    luaL_argcheck(L, luv_is_future(L, -1), 1, "expected a list of futures");
+    lua_pop(L, 1);
+  }
+  luaL_argcheck(L, n > 0 || kind == LUV_FUTURE_ALL, 1, "expected at least one future");
+  f = luv_push_future(L, luv_context(L), kind);
+  index = lua_gettop(L);
+  f->pending = n;
+  if (kind == LUV_FUTURE_ALL) {
+    lua_createtable(L, n, 1);
+    lua_pushinteger(L, n);
+    lua_setfield(L, -2, "n");
+    if (!n) {
+      lua_pushnil(L);
+      lua_insert(L, -2);
+      luv_future_resolve(L, index, 2);
+      return 1;
+    }
+    luv_setslot(L, index, LUV_FUTURE_VALUES, 0);
+  }
+  for (i = 1; i <= n && !f->resolved; i++) {
+    lua_rawgeti(L, 1, i);
+    if (((luv_future_t*)lua_touserdata(L, -1))->resolved)
+      luv_future_settle(L, index, -1, i);
+    else
+      luv_future_add_waiter(L, -1, index, i);
+    lua_pop(L, 1);
+  }
+  return 1;
+}
+
+static int luv_future_all(lua_State* L) {
+  return luv_future_combine(L, LUV_FUTURE_ALL);
+}
+
+static int luv_future_any(lua_State* L) {
+  return luv_future_combine(L, LUV_FUTURE_ANY);
+}
+
+static int luv_future_race(lua_State* L) {
+  return luv_future_combine(L, LUV_FUTURE_RACE);
+}
+
+static int luv_future_timeout(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  luv_future_t* child = luv_check_future(L, 1);
+  lua_Integer timeout = luaL_checkinteger(L, 2);
+  luv_future_timer_t* timer;
+  luv_future_t* f;
+  int ret;
+  luaL_argcheck(L, timeout >= 0, 2, "timeout must be non-negative");
+  f = luv_push_future(L, ctx, LUV_FUTURE_TIMEOUT);
+  if (child->resolved) {
+    luv_future_settle(L, -1, 1, 1);
+    return 1;
+  }
+  timer = (luv_future_timer_t*)malloc(sizeof(*timer));
+  if (!timer) return luaL_error(L, "Failed to allocate future timer");
+  ret = uv_timer_init(ctx->loop, &timer->handle);
+  if (ret < 0) {
+    free(timer);
+    return luv_error(L, ret);
+  }
+  // Like the loop's internal handles, invisible to uv.walk, and closed by
+  // luv_tick_close if the loop goes away first
+  timer->handle.data = NULL;
+  timer->ctx = ctx;
+  ret = uv_timer_start(&timer->handle, luv_future_timer_cb, (uint64_t)timeout, 0);
+  if (ret < 0) {
+    uv_close((uv_handle_t*)&timer->handle, luv_future_timer_close_cb);
+    return luv_error(L, ret);
+  }
+  lua_pushvalue(L, -1);
+  timer->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  timer->future = f;
+  luv_internal_add(ctx, &timer->internal, (uv_handle_t*)&timer->handle, luv_future_timer_teardown);
+  f->timer = timer;
+  luv_future_add_waiter(L, 1, -1, 1);
+  return 1;
+}
+
+static int luv_future_tostring(lua_State* L) {
+  luv_future_t* f = luv_check_future(L, 1);
+  lua_pushfstring(L, "uv_future_t: %p", f);
+  return 1;
+}
+
+static const luaL_Reg luv_future_methods[] = {
+  {"resolve", luv_future_resolve_values},
+  {"wait", luv_future_wait},
+  {"get", luv_future_get},
+  {"timeout", luv_future_timeout},
+  {NULL, NULL}
+};
+
+static void luv_future_init(lua_State* L) {
+  luaL_newmetatable(L, "uv_future");
+  lua_pushcfunction(L, luv_future_tostring);
+  lua_setfield(L, -2, "__tostring");
+  lua_newtable(L);
+  luaL_setfuncs(L, luv_future_methods, 0);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+}
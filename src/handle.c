@@ -23,37 +23,48 @@ static void* luv_newuserdata(lua_State* L, size_t sz) {
     return NULL; // unreachable
   }
 
-  *(void**)lua_newuserdata(L, sizeof(void*)) = handle;
+  *(void**)luv_newuserdata_slots(L, sizeof(void*)) = handle;
   return handle;
 }
 
+// Allocates a handle of the given type with room for its luv_handle_t and
+// pushes a userdata pointing at it.  The handle can't live in the userdata
+// itself: libuv keeps using a handle until its close callback runs, one
+// iteration after uv_close, but Lua frees the userdata as soon as it is
+// collected.  luv_handle_gc closes a handle it collects, and lua_close
+// collects open handles whose close callback then runs from loop_gc or,
+// with luv_set_loop, from the embedder's loop after the state is gone.
+// Pinning the userdata until the close callback can't cover lua_close,
+// which frees every object regardless of refs.
+static void* luv_newhandle(lua_State* L, uv_handle_type type) {
+  size_t size = LUV_HANDLE_DATA_OFFSET(uv_handle_size(type)) + sizeof(luv_handle_t);
+  return luv_newuserdata(L, size);
+}
+
 static void* luv_checkudata(lua_State* L, int ud, const char* tname) {
   return *(void**) luaL_checkudata(L, ud, tname);
 }
 
+// The handle metatables are recorded by luv_handle_init, a userdata is a
+// handle if its metatable is one of them.  Their contents are no proof since
+// Lua code can read and change them.
+static int luv_is_handle_mt(const luv_ctx_private_t* priv, const void* mt) {
+  int i;
+  for (i = 0; i < UV_HANDLE_TYPE_MAX; i++)
+    if (priv->handle_mts[i] == mt) return 1;
+  return 0;
+}
+
 static uv_handle_t* luv_check_handle(lua_State* L, int index) {
-  int isHandle;
   uv_handle_t* handle;
   void *udata;
+  const void* mt;
   // check if input is a userdata
   udata = lua_touserdata(L, index);
-  if (!udata) goto fail;
-  // "uv_handle" in the registry is a table structured like so:
-  // {
-  //   [<uv_aync metatable>] = true,
-  //   [<uv_check metatable>] = true,
-  //   ...
-  // }
-  // so to check that the value at the index is a "uv_handle",
-  // we get its metatable and check that we get `true` back
-  // when looking the metatable up in the "uv_handle" table.
-  lua_getfield(L, LUA_REGISTRYINDEX, "uv_handle");
-  isHandle = lua_getmetatable(L, index < 0 ? index - 1 : index);
-  if (!isHandle) goto fail;
-  lua_rawget(L, -2);
-  isHandle = lua_toboolean(L, -1);
-  lua_pop(L, 2);
-  if (!isHandle) goto fail;
+  if (!udata || !lua_getmetatable(L, index)) goto fail;
+  mt = lua_topointer(L, -1);
+  lua_pop(L, 1);
+  if (!mt || !luv_is_handle_mt(luv_ctx_private(luv_context(L)), mt)) goto fail;
   // cast the userdata to uv_handle_t
   handle = *(uv_handle_t**)udata;
   if (!handle->data) goto fail;
@@ -114,6 +125,9 @@ static int luv_close(lua_State* L) {
   if (!lua_isnoneornil(L, 2)) {
     luv_check_callback(L, (luv_handle_t*)handle->data, LUV_CLOSED, 2);
   }
+  // Corked writes are issued so that libuv cancels them like any other
+  // pending write, relays through the stream are cancelled
+  luv_stream_closing(handle);
   uv_close(handle, luv_close_cb);
   return 0;
 }
@@ -131,8 +145,8 @@ static void luv_handle_free(uv_handle_t* handle) {
 
     if (data->extra_gc)
       data->extra_gc(data->extra);
-    free(data);
   }
+  // data shares the handle's allocation
   free(handle);
 }
 
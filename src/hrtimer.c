@@ -0,0 +1,299 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+#ifdef __linux__
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+// A high resolution timer takes its deadlines in nanoseconds on the clock of
+// uv_hrtime().  On Linux it is a timerfd armed with absolute deadlines and
+// polled by an internal uv_poll_t, elsewhere a uv_timer_t that is armed again
+// until the deadline has passed.  Repeating timers keep their deadlines on
+// the grid set by the first one, so late callbacks don't add up to drift.
+typedef struct luv_hrtimer_s {
+  union {
+    uv_handle_t handle;
+#ifdef __linux__
+    uv_poll_t poll;
+#else
+    uv_timer_t timer;
+#endif
+  } u;               /* must be first */
+  luv_ctx_t* ctx;
+  struct luv_hrtimer_s** udata; /* cleared when the timer is closed */
+  luv_internal_t internal;
+  uint64_t due;      /* uv_hrtime() of the next expiration, 0 when stopped */
+  uint64_t repeat;
+  int ref;           /* keeps the userdata alive while started */
+#ifdef __linux__
+  int fd;
+#endif
+} luv_hrtimer_t;
+
+static luv_hrtimer_t* luv_check_hrtimer(lua_State* L, int index) {
+  luv_hrtimer_t* timer = *(luv_hrtimer_t**)luaL_checkudata(L, index, "uv_hrtimer");
+  luaL_argcheck(L, timer != NULL, index, "hrtimer is closed");
+  return timer;
+}
+
+static void luv_hrtimer_expire(luv_hrtimer_t* timer, uint64_t count);
+
+#ifdef __linux__
+static void luv_hrtimer_poll_cb(uv_poll_t* handle, int status, int events) {
+  luv_hrtimer_t* timer = (luv_hrtimer_t*)handle;
+  uint64_t count;
+  (void)status;
+  (void)events;
+  // Nothing to read when the timer was armed again since the wakeup
+  if (read(timer->fd, &count, sizeof(count)) != sizeof(count)) return;
+  if (!timer->due) return;
+  timer->due += count * timer->repeat;
+  luv_hrtimer_expire(timer, count);
+}
+
+static int luv_hrtimer_arm(luv_hrtimer_t* timer) {
+  struct itimerspec its;
+  its.it_value.tv_sec = (time_t)(timer->due / 1000000000);
+  its.it_value.tv_nsec = (long)(timer->due % 1000000000);
+  its.it_interval.tv_sec = (time_t)(timer->repeat / 1000000000);
+  its.it_interval.tv_nsec = (long)(timer->repeat % 1000000000);
+  // The kernel keeps a repeating timer on its grid by itself
+  if (timerfd_settime(timer->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+    return uv_translate_sys_error(errno);
+  return uv_poll_start(&timer->u.poll, UV_READABLE, luv_hrtimer_poll_cb);
+}
+
+static void luv_hrtimer_disarm(luv_hrtimer_t* timer) {
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  timerfd_settime(timer->fd, 0, &its, NULL);
+  uv_poll_stop(&timer->u.poll);
+}
+#else
+static int luv_hrtimer_arm(luv_hrtimer_t* timer);
+
+static void luv_hrtimer_timer_cb(uv_timer_t* handle) {
+  luv_hrtimer_t* timer = (luv_hrtimer_t*)handle;
+  uint64_t now = uv_hrtime();
+  uint64_t count = 1;
+  // The loop time the timer counts from can lag behind the clock
+  if (now < timer->due) {
+    luv_hrtimer_arm(timer);
+    return;
+  }
+  if (timer->repeat) {
+    count += (now - timer->due) / timer->repeat;
+    timer->due += count * timer->repeat;
+    luv_hrtimer_arm(timer);
+  }
+  luv_hrtimer_expire(timer, count);
+}
+
+// Rounded up to whole milliseconds, the callback checks the clock again
+static int luv_hrtimer_arm(luv_hrtimer_t* timer) {
+  uint64_t now = uv_hrtime();
+  uint64_t timeout = 0;
+  if (timer->due > now) timeout = (timer->due - now + 999999) / 1000000;
+  return uv_timer_start(&timer->u.timer, luv_hrtimer_timer_cb, timeout, 0);
+}
+
+static void luv_hrtimer_disarm(luv_hrtimer_t* timer) {
+  uv_timer_stop(&timer->u.timer);
+}
+#endif
+
+static void luv_hrtimer_unanchor(lua_State* L, luv_hrtimer_t* timer) {
+  luaL_unref(L, LUA_REGISTRYINDEX, timer->ref);
+  timer->ref = LUA_NOREF;
+}
+
+// Called with the number of expirations since the last callback, more than
+// one when the loop was too busy to run the callback in time.  A repeating
+// timer has already moved on to its next deadline.
+static void luv_hrtimer_expire(luv_hrtimer_t* timer, uint64_t count) {
+  lua_State* L = timer->ctx->L;
+  luv_ctx_t* ctx = timer->ctx;
+  int top = lua_gettop(L);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, timer->ref);
+  luv_getslot(L, top + 1, 1);
+  if (!timer->repeat) {
+    timer->due = 0;
+    luv_hrtimer_disarm(timer);
+    luv_hrtimer_unanchor(L, timer);
+  }
+  lua_pushinteger(L, (lua_Integer)count);
+  // The callback may stop, start or close the timer
+  ctx->cb_pcall(L, 1, 0, 0);
+  lua_settop(L, top);
+}
+
+static void luv_hrtimer_teardown(uv_handle_t* handle);
+
+static int luv_new_hrtimer(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  luv_hrtimer_t** udata;
+  luv_hrtimer_t* timer;
+  int ret;
+
+  udata = (luv_hrtimer_t**)luv_newuserdata_slots(L, sizeof(*udata));
+  *udata = NULL;
+  luaL_getmetatable(L, "uv_hrtimer");
+  lua_setmetatable(L, -2);
+
+  timer = (luv_hrtimer_t*)malloc(sizeof(*timer));
+  if (!timer) return luaL_error(L, "Failed to allocate hrtimer");
+#ifdef __linux__
+  timer->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer->fd < 0) {
+    ret = uv_translate_sys_error(errno);
+    free(timer);
+    return luv_error(L, ret);
+  }
+  ret = uv_poll_init(ctx->loop, &timer->u.poll, timer->fd);
+  if (ret < 0) close(timer->fd);
+#else
+  ret = uv_timer_init(ctx->loop, &timer->u.timer);
+#endif
+  if (ret < 0) {
+    free(timer);
+    return luv_error(L, ret);
+  }
+  // Like the loop's internal handles, invisible to uv.walk, and closed by
+  // luv_tick_close if the loop goes away first
+  timer->u.handle.data = NULL;
+  timer->ctx = ctx;
+  timer->udata = udata;
+  luv_internal_add(ctx, &timer->internal, &timer->u.handle, luv_hrtimer_teardown);
+  timer->due = 0;
+  timer->repeat = 0;
+  timer->ref = LUA_NOREF;
+  *udata = timer;
+  return 1;
+}
+
+static int luv_hrtimer_start(lua_State* L) {
+  luv_hrtimer_t* timer = luv_check_hrtimer(L, 1);
+  lua_Integer timeout = luaL_checkinteger(L, 2);
+  lua_Integer repeat = luaL_checkinteger(L, 3);
+  int ret;
+  luaL_argcheck(L, timeout >= 0, 2, "timeout must be non-negative");
+  luaL_argcheck(L, repeat >= 0, 3, "repeat must be non-negative");
+  luv_check_callable(L, 4);
+
+  lua_pushvalue(L, 4);
+  luv_setslot(L, 1, 1, 1);
+  timer->due = uv_hrtime() + (uint64_t)timeout;
+  timer->repeat = (uint64_t)repeat;
+  ret = luv_hrtimer_arm(timer);
+  if (ret < 0) {
+    timer->due = 0;
+    luv_hrtimer_disarm(timer);
+    luv_hrtimer_unanchor(L, timer);
+    return luv_error(L, ret);
+  }
+  if (timer->ref == LUA_NOREF) {
+    lua_pushvalue(L, 1);
+    timer->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  return luv_result(L, 0);
+}
+
+static int luv_hrtimer_stop(lua_State* L) {
+  luv_hrtimer_t* timer = luv_check_hrtimer(L, 1);
+  if (timer->due) {
+    timer->due = 0;
+    luv_hrtimer_disarm(timer);
+    luv_hrtimer_unanchor(L, timer);
+  }
+  return luv_result(L, 0);
+}
+
+static int luv_hrtimer_get_due_in(lua_State* L) {
+  luv_hrtimer_t* timer = luv_check_hrtimer(L, 1);
+  uint64_t now = uv_hrtime();
+  lua_pushinteger(L, timer->due > now ? (lua_Integer)(timer->due - now) : 0);
+  return 1;
+}
+
+static void luv_hrtimer_close_cb(uv_handle_t* handle) {
+#ifdef __linux__
+  close(((luv_hrtimer_t*)handle)->fd);
+#endif
+  free(handle);
+}
+
+static void luv_hrtimer_release(luv_hrtimer_t** udata) {
+  luv_hrtimer_t* timer = *udata;
+  *udata = NULL;
+  luv_internal_remove(timer->ctx, &timer->internal);
+  if (!uv_is_closing(&timer->u.handle))
+    uv_close(&timer->u.handle, luv_hrtimer_close_cb);
+}
+
+// The loop is torn down with the timer still open, maybe started
+static void luv_hrtimer_teardown(uv_handle_t* handle) {
+  luv_hrtimer_t* timer = (luv_hrtimer_t*)handle;
+  if (timer->ref != LUA_NOREF)
+    luv_hrtimer_unanchor(timer->ctx->L, timer);
+  luv_hrtimer_release(timer->udata);
+}
+
+static int luv_hrtimer_close(lua_State* L) {
+  luv_hrtimer_t* timer = luv_check_hrtimer(L, 1);
+  if (timer->due) {
+    timer->due = 0;
+    luv_hrtimer_disarm(timer);
+  }
+  luv_hrtimer_unanchor(L, timer);
+  luv_hrtimer_release((luv_hrtimer_t**)lua_touserdata(L, 1));
+  return 0;
+}
+
+// Only collected while stopped, or when the state is closed
+static int luv_hrtimer_gc(lua_State* L) {
+  luv_hrtimer_t** udata = (luv_hrtimer_t**)lua_touserdata(L, 1);
+  if (*udata) luv_hrtimer_release(udata);
+  return 0;
+}
+
+static int luv_hrtimer_tostring(lua_State* L) {
+  luv_hrtimer_t** udata = (luv_hrtimer_t**)luaL_checkudata(L, 1, "uv_hrtimer");
+  lua_pushfstring(L, "uv_hrtimer: %p", *udata);
+  return 1;
+}
+
+static const luaL_Reg luv_hrtimer_methods[] = {
+  {"start", luv_hrtimer_start},
+  {"stop", luv_hrtimer_stop},
+  {"get_due_in", luv_hrtimer_get_due_in},
+  {"close", luv_hrtimer_close},
+  {NULL, NULL}
+};
+
+static void luv_hrtimer_init(lua_State* L) {
+  luaL_newmetatable(L, "uv_hrtimer");
+  lua_pushcfunction(L, luv_hrtimer_tostring);
+  lua_setfield(L, -2, "__tostring");
+  lua_pushcfunction(L, luv_hrtimer_gc);
+  lua_setfield(L, -2, "__gc");
+  lua_newtable(L);
+  luaL_setfuncs(L, luv_hrtimer_methods, 0);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+}
@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef LUV_LCTX_H
+#define LUV_LCTX_H
+
+#include "luv.h"
+#include "lpool.h"
+#include "lreq.h"
+
+/* An internal handle other than the loop's tick, dispatch and sweep
+   handles, e.g. the timer of a future timeout.  Such handles are listed in
+   the loop's state while open so that luv_tick_close can close them when
+   the loop is torn down.  close closes the handle and detaches it from
+   what owns it.
+*/
+typedef struct luv_internal_s {
+  struct luv_internal_s* prev;
+  struct luv_internal_s* next;
+  uv_handle_t* handle;
+  void (*close)(uv_handle_t* handle);
+} luv_internal_t;
+
+/* Per-loop state that is private to luv.  luv_context allocates this struct
+   and hands out a pointer to its first member, so any luv_ctx_t* obtained
+   from luv can be converted back with luv_ctx_private.
+*/
+typedef struct {
+  luv_ctx_t ctx;              /* public part, must be first */
+  luv_buf_pool_t read_pool;   /* buffers for stream reads */
+  luv_buf_pool_t req_pool;    /* luv_req_t for every request type, the
+                                 uv_req_t userdata is not pooled */
+  uv_check_t* tick;           /* end of iteration hook, see ltick.c */
+  struct luv_stream_s* tick_streams; /* streams with reads or writes to flush */
+  struct luv_stream_s* timeout_streams; /* streams with deadlines, see stream.c */
+  uv_timer_t* sweep;          /* checks the deadlines of timeout_streams */
+  luv_internal_t* internals;  /* other open internal handles */
+  uint64_t sweep_due;         /* loop time the sweep is started for */
+  uv_idle_t* dispatch;        /* drains queued events, see ltick.c */
+  int dispatch_batch;         /* queue handle callbacks instead of calling */
+  int dispatch_ref;           /* table holding the ring of queued events */
+  int req_anchors;            /* table anchoring requests in flight */
+  lua_Integer dispatch_cap;   /* slots in the ring */
+  lua_Integer dispatch_head;  /* slot of the next event to run */
+  lua_Integer dispatch_count; /* slots in use */
+  lua_Integer dispatch_left;  /* slots the current drain still runs */
+  const void* handle_mts[UV_HANDLE_TYPE_MAX]; /* see luv_check_handle */
+} luv_ctx_private_t;
+
+#define luv_ctx_private(ctx) ((luv_ctx_private_t*)(ctx))
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+static const char *const luv_frame_lengths[] = {
+  "u16be", "u16le", "u32be", "u32le", NULL
+};
+
+// Parses a framing spec such as {delimiter = "\n"}, {length = "u32be"} or
+// {size = 512}, each with an optional max payload size.
+static void luv_check_frame(lua_State* L, int index, int arg, luv_frame_t* frame) {
+  const char* delimiter;
+  const char* length;
+  size_t delimiter_len;
+  lua_Integer size, max;
+  int kinds = 0;
+
+  index = lua_absindex(L, index);
+  memset(frame, 0, sizeof(*frame));
+  if (!lua_istable(L, index)) {
+    luaL_argerror(L, arg, "frame option must be a table");
+  }
+
+  lua_getfield(L, index, "max");
+  max = luaL_optinteger(L, -1, LUV_FRAME_MAX_SIZE);
+  luaL_argcheck(L, max > 0, arg, "frame max must be > 0");
+  frame->max = (size_t)max;
+  lua_pop(L, 1);
+
+  lua_getfield(L, index, "delimiter");
+  delimiter = lua_tolstring(L, -1, &delimiter_len);
+  if (delimiter) {
+    luaL_argcheck(L, delimiter_len > 0 && delimiter_len <= LUV_FRAME_DELIMITER_MAX, arg,
+      "frame delimiter must be 1 to 16 bytes long");
+    frame->type = LUV_FRAME_DELIMITER;
+    memcpy(frame->delimiter, delimiter, delimiter_len);
+    frame->delimiter_len = delimiter_len;
+    kinds++;
+  }
+  lua_pop(L, 1);
+
+  lua_getfield(L, index, "length");
+  length = lua_tostring(L, -1);
+  if (length) {
+    int i;
+    for (i = 0; luv_frame_lengths[i]; i++) {
+      if (strcmp(length, luv_frame_lengths[i]) == 0) break;
+    }
+    luaL_argcheck(L, luv_frame_lengths[i], arg,
+      "frame length must be one of u16be, u16le, u32be or u32le");
+    frame->type = LUV_FRAME_LENGTH;
+    frame->prefix_len = i < 2 ? 2 : 4;
+    frame->big_endian = i % 2 == 0;
+    kinds++;
+  }
+  lua_pop(L, 1);
+
+  lua_getfield(L, index, "size");
+  if (!lua_isnil(L, -1)) {
+    size = luaL_checkinteger(L, -1);
+    luaL_argcheck(L, size > 0 && (size_t)size <= frame->max, arg, "frame size out of range");
+    frame->type = LUV_FRAME_FIXED;
+    frame->size = (size_t)size;
+    kinds++;
+  }
+  lua_pop(L, 1);
+
+  luaL_argcheck(L, kinds == 1, arg, "frame needs exactly one of delimiter, length or size");
+}
+
+// Looks for the first whole frame in base.  On success returns 1 and sets
+// the header length, payload length and trailer length of the frame.
+// Returns 0 when more data is needed and UV_EMSGSIZE when the frame would
+// exceed the max size.  For delimiter framing the first `scanned` bytes are
+// known not to start a delimiter and are skipped.
+static int luv_frame_next(const luv_frame_t* frame, const char* base, size_t len, size_t scanned,
+                          size_t* head, size_t* size, size_t* tail) {
+  const unsigned char* p = (const unsigned char*)base;
+  size_t n;
+
+  switch (frame->type) {
+  case LUV_FRAME_DELIMITER: {
+    size_t dlen = frame->delimiter_len;
+    size_t i = scanned;
+    while (i + dlen <= len) {
+      const char* hit = (const char*)memchr(base + i, frame->delimiter[0], len - dlen + 1 - i);
+      if (!hit) break;
+      i = hit - base;
+      if (memcmp(hit, frame->delimiter, dlen) == 0) {
+        if (i > frame->max) return UV_EMSGSIZE;
+        *head = 0;
+        *size = i;
+        *tail = dlen;
+        return 1;
+      }
+      i++;
+    }
+    if (len >= frame->max + dlen) return UV_EMSGSIZE;
+    return 0;
+  }
+  case LUV_FRAME_LENGTH:
+    if (len < (size_t)frame->prefix_len) return 0;
+    if (frame->prefix_len == 2) {
+      n = frame->big_endian ? (size_t)p[0] << 8 | p[1] : (size_t)p[1] << 8 | p[0];
+    }
+    else if (frame->big_endian) {
+      n = (size_t)p[0] << 24 | (size_t)p[1] << 16 | (size_t)p[2] << 8 | p[3];
+    }
+    else {
+      n = (size_t)p[3] << 24 | (size_t)p[2] << 16 | (size_t)p[1] << 8 | p[0];
+    }
+    if (n > frame->max) return UV_EMSGSIZE;
+    if (len - frame->prefix_len < n) return 0;
+    *head = frame->prefix_len;
+    *size = n;
+    *tail = 0;
+    return 1;
+  case LUV_FRAME_FIXED:
+    if (len < frame->size) return 0;
+    *head = 0;
+    *size = frame->size;
+    *tail = 0;
+    return 1;
+  }
+  return 0;
+}
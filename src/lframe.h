@@ -0,0 +1,47 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef LUV_LFRAME_H
+#define LUV_LFRAME_H
+
+#include "luv.h"
+
+/* Kinds of framing read_start can apply to a stream */
+#define LUV_FRAME_NONE 0
+#define LUV_FRAME_DELIMITER 1
+#define LUV_FRAME_LENGTH 2
+#define LUV_FRAME_FIXED 3
+
+/* Longest delimiter accepted for delimiter framing */
+#define LUV_FRAME_DELIMITER_MAX 16
+
+/* Default upper bound on the payload size of a single frame */
+#define LUV_FRAME_MAX_SIZE (1024 * 1024)
+
+/* Describes how a byte stream is cut into frames.  Delimiters and length
+   prefixes are not part of the delivered frame.
+*/
+typedef struct {
+  int type;
+  char delimiter[LUV_FRAME_DELIMITER_MAX];
+  size_t delimiter_len;
+  int prefix_len;     /* 2 or 4 bytes for length framing */
+  int big_endian;     /* byte order of the length prefix */
+  size_t size;        /* record size for fixed framing */
+  size_t max;         /* largest accepted payload */
+} luv_frame_t;
+
+#endif
@@ -28,8 +28,8 @@ static luv_handle_t* luv_setup_handle(lua_State* L, luv_ctx_t* ctx) {
   handle = *(uv_handle_t**)udata;
   luaL_checktype(L, -1, LUA_TUSERDATA);
 
-  data = (luv_handle_t*)malloc(sizeof(*data));
-  if (!data) luaL_error(L, "Can't allocate luv handle");
+  // allocated along with the handle by luv_newhandle
+  data = (luv_handle_t*)((char*)handle + LUV_HANDLE_DATA_OFFSET(uv_handle_size(handle->type)));
 
   #define XX(uc, lc) case UV_##uc: \
     luaL_getmetatable(L, "uv_"#lc); \
@@ -37,7 +37,6 @@ static luv_handle_t* luv_setup_handle(lua_State* L, luv_ctx_t* ctx) {
   switch (handle->type) {
     UV_HANDLE_TYPE_MAP(XX)
     default:
-      free(data);
       luaL_error(L, "Unknown handle type");
       return NULL;
   }
@@ -48,8 +47,9 @@ static luv_handle_t* luv_setup_handle(lua_State* L, luv_ctx_t* ctx) {
   lua_pushvalue(L, -1);
 
   data->ref = luaL_ref(L, LUA_REGISTRYINDEX);
-  data->callbacks[0] = LUA_NOREF;
-  data->callbacks[1] = LUA_NOREF;
+  data->callbacks[0] = 0;
+  data->callbacks[1] = 0;
+  data->reading = 0;
   data->ctx = ctx;
   data->extra = NULL;
   data->extra_gc = NULL;
@@ -65,9 +65,22 @@ static luv_handle_t* luv_setup_handle(lua_State* L, luv_ctx_t* ctx) {
 
 static void luv_check_callback(lua_State* L, luv_handle_t* data, luv_callback_id id, int index) {
   luv_check_callable(L, index);
-  luaL_unref(L, LUA_REGISTRYINDEX, data->callbacks[id]);
-  lua_pushvalue(L, index);
-  data->callbacks[id] = luaL_ref(L, LUA_REGISTRYINDEX);
+  index = lua_absindex(L, index);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, data->ref);
+  // Nothing to keep once the handle is closed
+  if (lua_isuserdata(L, -1)) {
+    lua_pushvalue(L, index);
+    luv_setslot(L, -2, id + 1, !data->callbacks[0] && !data->callbacks[1]);
+    data->callbacks[id] = 1;
+  }
+  lua_pop(L, 1);
+}
+
+// Pushes the callback in slot id, the handle must have one
+static void luv_push_callback(lua_State* L, luv_handle_t* data, luv_callback_id id) {
+  lua_rawgeti(L, LUA_REGISTRYINDEX, data->ref);
+  luv_getslot(L, -1, id + 1);
+  lua_remove(L, -2);
 }
 
 static int luv_traceback (lua_State *L) {
@@ -91,15 +104,16 @@ static int luv_traceback (lua_State *L) {
   return 1;
 }
 
-static void luv_call_callback(lua_State* L, luv_handle_t* data, luv_callback_id id, int nargs) {
+// Calls the callback right away, even when the loop batches callbacks.
+// Used for arguments that are only valid during the call.
+static void luv_call_callback_now(lua_State* L, luv_handle_t* data, luv_callback_id id, int nargs) {
   luv_ctx_t* ctx = data->ctx;
-  int ref = data->callbacks[id];
-  if (ref == LUA_NOREF) {
+  if (!data->callbacks[id]) {
     lua_pop(L, nargs);
   }
   else {
     // Get the callback
-    lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+    luv_push_callback(L, data, id);
     // And insert it before the args if there are any.
     if (nargs) {
       lua_insert(L, -1 - nargs);
@@ -109,11 +123,39 @@ static void luv_call_callback(lua_State* L, luv_handle_t* data, luv_callback_id
   }
 }
 
+static void luv_call_callback(lua_State* L, luv_handle_t* data, luv_callback_id id, int nargs) {
+  luv_ctx_t* ctx = data->ctx;
+  if (!data->callbacks[id] || !luv_ctx_private(ctx)->dispatch_batch) {
+    luv_call_callback_now(L, data, id, nargs);
+  }
+  else {
+    // The function is queued by value, so releasing the handle's callbacks
+    // before the queue is drained is fine.
+    luv_push_callback(L, data, id);
+    if (nargs) {
+      lua_insert(L, -1 - nargs);
+    }
+    // Called right away if it can't be queued
+    if (luv_dispatch_push(L, ctx, nargs) < 0)
+      ctx->cb_pcall(L, nargs, 0, 0);
+  }
+}
+
 static void luv_unref_handle(lua_State* L, luv_handle_t* data) {
+  luv_callback_id id;
+  // Release the callbacks even if Lua still holds on to the handle
+  if (data->callbacks[0] || data->callbacks[1]) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, data->ref);
+    for (id = 0; id < 2; id++) {
+      if (!data->callbacks[id]) continue;
+      lua_pushnil(L);
+      luv_setslot(L, -2, id + 1, 0);
+      data->callbacks[id] = 0;
+    }
+    lua_pop(L, 1);
+  }
   luaL_unref(L, LUA_REGISTRYINDEX, data->ref);
   data->ref = LUA_NOREF;
-  luaL_unref(L, LUA_REGISTRYINDEX, data->callbacks[0]);
-  luaL_unref(L, LUA_REGISTRYINDEX, data->callbacks[1]);
 }
 
 static void luv_find_handle(lua_State* L, luv_handle_t* data) {
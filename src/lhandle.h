@@ -41,15 +41,24 @@
 
 typedef void (*luv_handle_extra_gc) (void* ptr);
 
-/* Ref for userdata and event callbacks */
+/* Ref for userdata and event callbacks.  The callbacks are kept in the
+   userdata's user value slots 1 and 2, callbacks[id] tells if one is set.
+*/
 typedef struct {
   int ref;
   int callbacks[2];
+  int reading;  /* streams: read_start succeeded and reading hasn't stopped */
   luv_ctx_t* ctx;
   void* extra;
   luv_handle_extra_gc extra_gc;
 } luv_handle_t;
 
+/* A handle and its luv_handle_t share one allocation, the luv_handle_t is
+   placed right after the libuv handle at this offset.
+*/
+#define LUV_HANDLE_DATA_OFFSET(size) \
+  (((size) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
 static void luv_handle_free(uv_handle_t* handle);
 
 static const char* luv_handle_key = "LUV_HANDLES";
@@ -16,8 +16,38 @@
  */
 #include "private.h"
 
+static void luv_loop_close_walk_cb(uv_handle_t* handle, void* arg) {
+  if (handle->data) *(int*)arg = 1;
+}
+
+// Whether one of the listed internal handles still has work to do, like
+// the running timer of a future timeout
+static int luv_internals_active(luv_ctx_private_t* priv) {
+  luv_internal_t* internal;
+  for (internal = priv->internals; internal; internal = internal->next)
+    if (uv_is_active(internal->handle)) return 1;
+  return 0;
+}
+
 static int luv_loop_close(lua_State* L) {
-  int ret = uv_loop_close(luv_loop(L));
+  luv_ctx_t* ctx = luv_context(L);
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  int ret, open = 0;
+  // Queued callbacks, reads and writes, streams with deadlines and running
+  // internal handles keep the loop busy like active handles do, and so do
+  // the caller's handles until they are closed.  Nothing is torn down
+  // while the loop can't be closed anyway.
+  if (priv->dispatch_count || priv->tick_streams || priv->timeout_streams)
+    return luv_error(L, UV_EBUSY);
+  uv_walk(ctx->loop, luv_loop_close_walk_cb, &open);
+  if (open || luv_internals_active(priv))
+    return luv_error(L, UV_EBUSY);
+  // The loop's internal handles close themselves once idle, so after a run
+  // there are none left.  Any still open, e.g. when the loop never ran, are
+  // closed like the caller's would be and a run has to finish closing them.
+  if (ctx->mode == -1)
+    luv_tick_close(ctx);
+  ret = uv_loop_close(ctx->loop);
   if (ret < 0) return luv_error(L, ret);
   luv_set_loop(L, NULL);
   lua_pushinteger(L, ret);
@@ -39,12 +69,32 @@ static int luv_run(lua_State* L) {
   }
   ctx->mode = mode;
   int ret = uv_run(ctx->loop, (uv_run_mode)mode);
+  // "once" and "nowait" may return with batched callbacks still queued
+  luv_dispatch_drain(ctx);
   ctx->mode = -1;
   if (ret < 0) return luv_error(L, ret);
   lua_pushboolean(L, ret);
   return 1;
 }
 
+static int luv_batch_callbacks(lua_State* L) {
+  luv_ctx_private_t* priv = luv_ctx_private(luv_context(L));
+  int enable;
+  luaL_checktype(L, 1, LUA_TBOOLEAN);
+  enable = lua_toboolean(L, 1);
+  lua_pushboolean(L, priv->dispatch_batch);
+  priv->dispatch_batch = enable;
+  return 1;
+}
+
+static int luv_defer(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  int ret;
+  luv_check_callable(L, 1);
+  ret = luv_dispatch_push(L, ctx, lua_gettop(L) - 1);
+  return luv_result(L, ret);
+}
+
 static int luv_loop_mode(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   if (ctx->mode == -1) {
@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+static void luv_buf_pool_init(luv_buf_pool_t* pool, size_t size, unsigned int max) {
+  pool->head = NULL;
+  pool->size = size;
+  pool->max = max;
+  pool->count = 0;
+  pool->hits = 0;
+  pool->misses = 0;
+}
+
+// Returns a buffer of pool->size bytes, or NULL when out of memory
+static char* luv_buf_pool_get(luv_buf_pool_t* pool) {
+  void* buf = pool->head;
+  if (buf) {
+    pool->head = *(void**)buf;
+    pool->count--;
+    pool->hits++;
+    return (char*)buf;
+  }
+  pool->misses++;
+  return (char*)malloc(pool->size);
+}
+
+// Gives a buffer back to the pool.  Buffers that don't match the current
+// size class (the pool was reconfigured while they were in use) or that
+// would exceed the cap are freed instead.
+static void luv_buf_pool_put(luv_buf_pool_t* pool, char* base, size_t len) {
+  if (!base) return;
+  if (len != pool->size || pool->count >= pool->max) {
+    free(base);
+    return;
+  }
+  *(void**)base = pool->head;
+  pool->head = base;
+  pool->count++;
+}
+
+// Frees every cached buffer, leaving the counters untouched
+static void luv_buf_pool_drain(luv_buf_pool_t* pool) {
+  while (pool->head) {
+    void* next = *(void**)pool->head;
+    free(pool->head);
+    pool->head = next;
+  }
+  pool->count = 0;
+}
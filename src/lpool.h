@@ -0,0 +1,47 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef LUV_LPOOL_H
+#define LUV_LPOOL_H
+
+#include "luv.h"
+
+/* Default size of a pooled read buffer, matches what libuv suggests for
+   stream reads. */
+#define LUV_BUF_POOL_SIZE (64 * 1024)
+
+/* Smallest size accepted by uv.buffer_pool_configure */
+#define LUV_BUF_POOL_MIN_SIZE 64
+
+/* Default number of free buffers a pool keeps around */
+#define LUV_BUF_POOL_MAX 16
+
+/* Default number of free luv_req_t a loop keeps around */
+#define LUV_REQ_POOL_MAX 256
+
+/* Freelist of equally sized heap buffers.  Free buffers are chained through
+   their first bytes, so caching a buffer never allocates.
+*/
+typedef struct {
+  void* head;         /* first cached free buffer */
+  size_t size;        /* size of every buffer handed out by the pool */
+  unsigned int max;   /* maximum number of cached free buffers */
+  unsigned int count; /* number of cached free buffers */
+  uint64_t hits;      /* allocations served from the cache */
+  uint64_t misses;    /* allocations that had to call malloc */
+} luv_buf_pool_t;
+
+#endif
@@ -17,11 +17,35 @@
 #include "private.h"
 
 
+// A continuation is a callback, a coroutine that is resumed with the
+// callback's arguments instead, or a future they resolve
+static int luv_is_continuation(lua_State* L, int index) {
+  return lua_type(L, index) == LUA_TTHREAD || luv_is_callable(L, index) ||
+         luaL_testudata(L, index, "uv_future") != NULL;
+}
+
 static int luv_check_continuation(lua_State* L, int index) {
   if (lua_isnoneornil(L, index)) return LUA_NOREF;
-  luv_check_callable(L, index);
-  lua_pushvalue(L, index);
-  return luaL_ref(L, LUA_REGISTRYINDEX);
+  if (lua_type(L, index) != LUA_TTHREAD && !luaL_testudata(L, index, "uv_future"))
+    luv_check_callable(L, index);
+  return lua_absindex(L, index);
+}
+
+// Pushes a userdata for a request of the given type with the slots
+// luv_setup_req keeps its callback and data in.  Unlike the luv_req_t this
+// is not taken from a pool: it is the request object handed to Lua, which
+// may hold on to it past completion, so every request allocates its own.
+static void* luv_newreq(lua_State* L, uv_req_type type) {
+  return luv_newuserdata_slots(L, uv_req_size(type));
+}
+
+// Pushes the userdata of a request in flight.  Requests are anchored in a
+// table of their own rather than in the registry, so issuing and finishing
+// them does not grow and shrink the registry every time.
+static void luv_req_push(lua_State* L, luv_req_t* data) {
+  lua_rawgeti(L, LUA_REGISTRYINDEX, luv_ctx_private(data->ctx)->req_anchors);
+  lua_rawgeti(L, -1, data->req_ref);
+  lua_remove(L, -2);
 }
 
 // Store a lua callback in a luv_req for the continuation.
@@ -31,18 +55,24 @@ static luv_req_t* luv_setup_req_with_mt(lua_State* L, luv_ctx_t* ctx, int cb_ref
 
   luaL_checktype(L, -1, LUA_TUSERDATA);
 
-  data = (luv_req_t*)malloc(sizeof(*data));
+  data = (luv_req_t*)luv_buf_pool_get(&luv_ctx_private(ctx)->req_pool);
   if (!data) luaL_error(L, "Problem allocating luv request");
 
   luaL_getmetatable(L, mt_name);
   lua_setmetatable(L, -2);
 
-  lua_pushvalue(L, -1);
-  data->req_ref = luaL_ref(L, LUA_REGISTRYINDEX);
-  data->callback_ref = cb_ref;
-  data->data_ref = LUA_NOREF;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, luv_ctx_private(ctx)->req_anchors);
+  lua_pushvalue(L, -2);
+  data->req_ref = luaL_ref(L, -2);
+  lua_pop(L, 1);
+  data->has_callback = cb_ref != LUA_NOREF;
+  data->has_data = 0;
   data->ctx = ctx;
   data->data = NULL;
+  if (data->has_callback) {
+    lua_pushvalue(L, cb_ref);
+    luv_setslot(L, -2, LUV_REQ_CALLBACK, 1);
+  }
 
   return data;
 }
@@ -52,32 +82,98 @@ static luv_req_t* luv_setup_req(lua_State* L, luv_ctx_t* ctx, int cb_ref) {
 }
 
 
+// Pins the value on top of the stack to the request, popping it.  Pinning
+// nil releases what was pinned before.
+static void luv_req_set_data(lua_State* L, luv_req_t* data) {
+  int fresh = !data->has_callback && !data->has_data;
+  data->has_data = !lua_isnil(L, -1);
+  luv_req_push(L, data);
+  lua_insert(L, -2);
+  luv_setslot(L, -2, LUV_REQ_DATA, fresh);
+  lua_pop(L, 1);
+}
+
+// Pushes what is pinned to the request, or nil
+static void luv_req_push_data(lua_State* L, luv_req_t* data) {
+  if (!data->has_data) {
+    lua_pushnil(L);
+    return;
+  }
+  luv_req_push(L, data);
+  luv_getslot(L, -1, LUV_REQ_DATA);
+  lua_remove(L, -2);
+}
+
+// Resumes the coroutine passed as first argument with the others.  What it
+// yields or returns is dropped, an error it raises is raised again here with
+// the coroutine's traceback.
+static int luv_resume_continuation(lua_State* L) {
+  lua_State* co = lua_tothread(L, 1);
+  int nargs = lua_gettop(L) - 1;
+  int ret;
+  if (lua_status(co) == LUA_OK && lua_gettop(co) == 0)
+    return luaL_error(L, "cannot resume dead coroutine");
+  lua_xmove(L, co, nargs);
+#if LUA_VERSION_NUM >= 504
+  {
+    int nres;
+    ret = lua_resume(co, L, nargs, &nres);
+  }
+#elif LUA_VERSION_NUM >= 502
+  ret = lua_resume(co, L, nargs);
+#else
+  ret = lua_resume(co, nargs);
+#endif
+  if (ret == LUA_OK || ret == LUA_YIELD) {
+    lua_settop(co, 0);
+    return 0;
+  }
+  lua_xmove(co, L, 1);
+  if (lua_type(L, -1) == LUA_TSTRING)
+    luaL_traceback(L, co, lua_tostring(L, -1), 0);
+  return lua_error(L);
+}
+
+// Calls the function or coroutine below the nargs values on top of the
+// stack with them, popping all.  A coroutine is resumed through a protected
+// call as well, so its errors are reported like those of a callback.
+static void luv_call_continuation(lua_State* L, luv_ctx_t* ctx, int nargs) {
+  if (lua_type(L, -1 - nargs) == LUA_TTHREAD) {
+    lua_pushcfunction(L, luv_resume_continuation);
+    lua_insert(L, -2 - nargs);
+    nargs++;
+  }
+  ctx->cb_pcall(L, nargs, 0, 0);
+}
+
 static void luv_fulfill_req(lua_State* L, luv_req_t* data, int nargs) {
-  if (data->callback_ref == LUA_NOREF) {
+  if (!data->has_callback) {
     lua_pop(L, nargs);
   }
   else {
     // Get the callback
-    lua_rawgeti(L, LUA_REGISTRYINDEX, data->callback_ref);
+    luv_req_push(L, data);
+    luv_getslot(L, -1, LUV_REQ_CALLBACK);
+    lua_remove(L, -2);
     // And insert it before the args if there are any.
     if (nargs) {
       lua_insert(L, -1 - nargs);
     }
-    data->ctx->cb_pcall(L, nargs, 0, 0);
+    if (luaL_testudata(L, -1 - nargs, "uv_future")) {
+      luv_future_resolve(L, -1 - nargs, nargs);
+      lua_pop(L, 1);
+    }
+    else {
+      luv_call_continuation(L, data->ctx, nargs);
+    }
   }
 }
 
+// The callback and pinned data go away with the userdata
 static void luv_cleanup_req(lua_State* L, luv_req_t* data) {
-  int i;
-  luaL_unref(L, LUA_REGISTRYINDEX, data->req_ref);
-  luaL_unref(L, LUA_REGISTRYINDEX, data->callback_ref);
-  if (data->data_ref == LUV_REQ_MULTIREF) {
-    for (i = 0; ((int*)(data->data))[i] != LUA_NOREF; i++) {
-      luaL_unref(L, LUA_REGISTRYINDEX, ((int*)(data->data))[i]);
-    }
-  }
-  else
-    luaL_unref(L, LUA_REGISTRYINDEX, data->data_ref);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, luv_ctx_private(data->ctx)->req_anchors);
+  luaL_unref(L, -1, data->req_ref);
+  lua_pop(L, 1);
   free(data->data);
-  free(data);
+  luv_buf_pool_put(&luv_ctx_private(data->ctx)->req_pool, (char*)data, sizeof(*data));
 }
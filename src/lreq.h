@@ -19,15 +19,18 @@
 
 #include "luv.h"
 
+/* The callback and the data a request pins, e.g. the strings being
+   written, are kept in user value slots of the request's userdata.
+*/
+#define LUV_REQ_CALLBACK 1
+#define LUV_REQ_DATA 2
+
 typedef struct {
-  int req_ref; /* ref for uv_req_t's userdata */
-  int callback_ref; /* ref for callback */
-  int data_ref; /* ref for write data */
+  int req_ref; /* ref for uv_req_t's userdata, see luv_req_push */
+  int has_callback; /* LUV_REQ_CALLBACK slot is set */
+  int has_data; /* LUV_REQ_DATA slot is set */
   luv_ctx_t* ctx; /* context for callback */
   void* data; /* extra data */
 } luv_req_t;
 
-// This is an arbitrary value that we can assume will never be returned by luaL_ref
-#define LUV_REQ_MULTIREF (-0x1234)
-
 #endif
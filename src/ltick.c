@@ -0,0 +1,279 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+// Every loop owns one internal check handle that runs work deferred to the
+// end of the current iteration, e.g. batched stream reads and corked writes.  It is
+// only open while there is something to flush, so an idle loop is not
+// kept alive by it and can be closed once its run returns.  Its data
+// pointer is NULL like any handle that has no luv_handle_t, so uv.walk and
+// luv_close_cb leave it alone.
+typedef struct {
+  uv_check_t handle; /* must be first */
+  luv_ctx_private_t* priv;
+} luv_tick_t;
+
+static void luv_tick_close_cb(uv_handle_t* handle) {
+  free(handle);
+}
+
+// Closes the tick and dispatch handles once there is nothing left for them
+static void luv_tick_idle(luv_ctx_private_t* priv) {
+  if (priv->tick_streams || priv->dispatch_count) return;
+  if (priv->tick) {
+    uv_close((uv_handle_t*)priv->tick, luv_tick_close_cb);
+    priv->tick = NULL;
+  }
+  if (priv->dispatch) {
+    uv_close((uv_handle_t*)priv->dispatch, luv_tick_close_cb);
+    priv->dispatch = NULL;
+  }
+}
+
+static void luv_tick_cb(uv_check_t* handle) {
+  luv_ctx_private_t* priv = ((luv_tick_t*)handle)->priv;
+  // Queued callbacks first so batched reads keep their place behind them
+  luv_dispatch_drain(&priv->ctx);
+  luv_stream_flush_tick(&priv->ctx);
+  luv_dispatch_drain(&priv->ctx);
+  if (priv->tick_streams) return;
+  if (priv->dispatch_count)
+    uv_check_stop(handle);
+  else
+    luv_tick_idle(priv);
+}
+
+// Makes sure the tick handle runs at the end of this loop iteration
+static int luv_tick_schedule(luv_ctx_t* ctx) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  if (!priv->tick) {
+    int ret;
+    luv_tick_t* tick = (luv_tick_t*)malloc(sizeof(*tick));
+    if (!tick) return UV_ENOMEM;
+    ret = uv_check_init(ctx->loop, &tick->handle);
+    if (ret < 0) {
+      free(tick);
+      return ret;
+    }
+    tick->handle.data = NULL;
+    tick->priv = priv;
+    priv->tick = &tick->handle;
+  }
+  return uv_check_start(priv->tick, luv_tick_cb);
+}
+
+// Calls deferred with uv.defer, and handle callbacks while uv.batch_callbacks
+// is enabled, are queued as events: the function, the argument count and the
+// arguments in consecutive slots of a ring kept in one table.  The ring is
+// drained by a single protected call of luv_dispatch_run, from the tick
+// handle for events of the poll phase and from an idle handle for the others.
+// While events are waiting the idle handle also keeps the loop from blocking.
+typedef struct {
+  uv_idle_t handle; /* must be first */
+  luv_ctx_private_t* priv;
+} luv_dispatch_t;
+
+#define LUV_DISPATCH_MIN 64
+
+static void luv_dispatch_cb(uv_idle_t* handle) {
+  luv_ctx_private_t* priv = ((luv_dispatch_t*)handle)->priv;
+  luv_dispatch_drain(&priv->ctx);
+  luv_tick_idle(priv);
+}
+
+static int luv_dispatch_start(luv_ctx_t* ctx) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  int ret;
+  if (!priv->dispatch) {
+    luv_dispatch_t* dispatch = (luv_dispatch_t*)malloc(sizeof(*dispatch));
+    if (!dispatch) return UV_ENOMEM;
+    ret = uv_idle_init(ctx->loop, &dispatch->handle);
+    if (ret < 0) {
+      free(dispatch);
+      return ret;
+    }
+    dispatch->handle.data = NULL;
+    dispatch->priv = priv;
+    priv->dispatch = &dispatch->handle;
+  }
+  ret = uv_idle_start(priv->dispatch, luv_dispatch_cb);
+  if (ret < 0) return ret;
+  return luv_tick_schedule(ctx);
+}
+
+// Moves the ring into a new table of at least size slots, starting at
+// slot 1.  The table is left on top of the stack.
+static void luv_dispatch_grow(lua_State* L, luv_ctx_private_t* priv, lua_Integer size) {
+  lua_Integer cap = priv->dispatch_cap ? priv->dispatch_cap : LUV_DISPATCH_MIN;
+  lua_Integer i;
+  while (cap < size) cap *= 2;
+  lua_createtable(L, (int)cap, 0);
+  if (priv->dispatch_ref != LUA_NOREF) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, priv->dispatch_ref);
+    for (i = 0; i < priv->dispatch_count; i++) {
+      lua_rawgeti(L, -1, (priv->dispatch_head + i) % priv->dispatch_cap + 1);
+      lua_rawseti(L, -3, i + 1);
+    }
+    lua_pop(L, 1);
+    luaL_unref(L, LUA_REGISTRYINDEX, priv->dispatch_ref);
+  }
+  lua_pushvalue(L, -1);
+  priv->dispatch_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  priv->dispatch_cap = cap;
+  priv->dispatch_head = 0;
+}
+
+// Queues the function below the top nargs values with those values, and
+// pops all of them.  L may be a coroutine of the loop's state.  On failure
+// the values are left on the stack.
+static int luv_dispatch_push(lua_State* L, luv_ctx_t* ctx, int nargs) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  lua_Integer need = priv->dispatch_count + 2 + nargs;
+  lua_Integer tail;
+  int i, queue;
+  if (!priv->dispatch_count) {
+    int ret = luv_dispatch_start(ctx);
+    if (ret < 0) return ret;
+  }
+  if (need > priv->dispatch_cap)
+    luv_dispatch_grow(L, priv, need);
+  else
+    lua_rawgeti(L, LUA_REGISTRYINDEX, priv->dispatch_ref);
+  lua_insert(L, -2 - nargs);
+  queue = lua_absindex(L, -2 - nargs);
+  tail = priv->dispatch_head + priv->dispatch_count;
+  for (i = nargs; i > 0; i--)
+    lua_rawseti(L, queue, (tail + 1 + i) % priv->dispatch_cap + 1);
+  lua_rawseti(L, queue, tail % priv->dispatch_cap + 1);
+  lua_pushinteger(L, nargs);
+  lua_rawseti(L, queue, (tail + 1) % priv->dispatch_cap + 1);
+  lua_pop(L, 1);
+  priv->dispatch_count = need;
+  return 0;
+}
+
+// Runs the events of the current drain.  The head moves past an event
+// before it is called, so when one raises, the rest is left for the next
+// run.  Slots are cleared as they are read so the ring holds no stale values.
+static int luv_dispatch_run(lua_State* L) {
+  luv_ctx_private_t* priv = (luv_ctx_private_t*)lua_touserdata(L, 1);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, priv->dispatch_ref);
+  while (priv->dispatch_left > 0) {
+    lua_Integer cap = priv->dispatch_cap;
+    lua_Integer head = priv->dispatch_head;
+    int i, nargs;
+    lua_rawgeti(L, 2, (head + 1) % cap + 1);
+    nargs = (int)lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    luaL_checkstack(L, nargs + 1, NULL);
+    for (i = 0; i < 2 + nargs; i++) {
+      lua_Integer slot = (head + i) % cap + 1;
+      if (i != 1) lua_rawgeti(L, 2, slot);
+      lua_pushnil(L);
+      lua_rawseti(L, 2, slot);
+    }
+    priv->dispatch_head = (head + 2 + nargs) % cap;
+    priv->dispatch_count -= 2 + nargs;
+    priv->dispatch_left -= 2 + nargs;
+    lua_call(L, nargs, 0);
+    // The ring may have been moved to a larger table by the call
+    if (priv->dispatch_cap != cap) {
+      lua_pop(L, 1);
+      lua_rawgeti(L, LUA_REGISTRYINDEX, priv->dispatch_ref);
+    }
+  }
+  return 0;
+}
+
+// Runs the events queued so far, one protected call per run of events.
+// Events queued meanwhile wait for the next drain, so code that keeps
+// deferring itself doesn't starve I/O.  An error is reported by cb_pcall
+// exactly as for a callback called directly, and the events after the
+// failing one still run.
+static void luv_dispatch_drain(luv_ctx_t* ctx) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  lua_State* L = ctx->L;
+  // A drain started by a callback of this one just finishes it
+  if (priv->dispatch_left > 0) return;
+  priv->dispatch_left = priv->dispatch_count;
+  while (priv->dispatch_left > 0) {
+    lua_pushcfunction(L, luv_dispatch_run);
+    lua_pushlightuserdata(L, priv);
+    ctx->cb_pcall(L, 1, 0, 0);
+  }
+  if (!priv->dispatch_count && priv->dispatch)
+    uv_idle_stop(priv->dispatch);
+}
+
+// Lists an open internal handle, see luv_internal_t
+static void luv_internal_add(luv_ctx_t* ctx, luv_internal_t* internal, uv_handle_t* handle, void (*close)(uv_handle_t*)) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  internal->handle = handle;
+  internal->close = close;
+  internal->prev = NULL;
+  internal->next = priv->internals;
+  if (internal->next) internal->next->prev = internal;
+  priv->internals = internal;
+}
+
+// Called by the owner when it closes the handle
+static void luv_internal_remove(luv_ctx_t* ctx, luv_internal_t* internal) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  if (internal->prev)
+    internal->prev->next = internal->next;
+  else
+    priv->internals = internal->next;
+  if (internal->next)
+    internal->next->prev = internal->prev;
+  internal->prev = NULL;
+  internal->next = NULL;
+}
+
+// Closes the internal handles of the loop, including the listed ones of
+// futures and transfers, returns 1 if there was one to close.  Those have
+// a NULL data pointer, so luv_close_cb wouldn't free them when uv.walk
+// closes everything.  Anything still waiting to be flushed is dropped, and callbacks are
+// no longer batched so the ones run while the loop is torn down aren't lost
+// either.
+static int luv_tick_close(luv_ctx_t* ctx) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  uv_check_t* handle = priv->tick;
+  uv_idle_t* dispatch = priv->dispatch;
+  uv_timer_t* sweep = priv->sweep;
+  priv->dispatch_batch = 0;
+  priv->dispatch_count = 0;
+  priv->dispatch_left = 0;
+  if (priv->dispatch_ref != LUA_NOREF) {
+    luaL_unref(ctx->L, LUA_REGISTRYINDEX, priv->dispatch_ref);
+    priv->dispatch_ref = LUA_NOREF;
+    priv->dispatch_cap = 0;
+    priv->dispatch_head = 0;
+  }
+  if (!handle && !dispatch && !sweep && !priv->internals) return 0;
+  while (priv->internals)
+    priv->internals->close(priv->internals->handle);
+  priv->tick = NULL;
+  priv->dispatch = NULL;
+  priv->sweep = NULL;
+  if (handle)
+    uv_close((uv_handle_t*)handle, luv_tick_close_cb);
+  if (dispatch)
+    uv_close((uv_handle_t*)dispatch, luv_tick_close_cb);
+  if (sweep)
+    uv_close((uv_handle_t*)sweep, luv_tick_close_cb);
+  return 1;
+}
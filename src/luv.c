@@ -22,17 +22,23 @@
 #include "luv.h"
 
 #include "async.c"
+#include "buffer.c"
 #include "check.c"
 #include "constants.c"
 #include "dns.c"
 #include "fs.c"
 #include "fs_event.c"
 #include "fs_poll.c"
+#include "fs_walk.c"
+#include "future.c"
 #include "handle.c"
 #include "idle.c"
+#include "lframe.c"
 #include "lhandle.c"
 #include "loop.c"
+#include "lpool.c"
 #include "lreq.c"
+#include "ltick.c"
 #include "metrics.c"
 #include "misc.c"
 #include "pipe.c"
@@ -46,6 +52,8 @@
 #include "synch.c"
 #include "thread.c"
 #include "timer.c"
+#include "timer_wheel.c"
+#include "hrtimer.c"
 #include "tty.c"
 #include "udp.c"
 #include "util.c"
@@ -56,6 +64,8 @@ static const luaL_Reg luv_functions[] = {
   {"loop_close", luv_loop_close},
   {"run", luv_run},
   {"loop_mode", luv_loop_mode},
+  {"batch_callbacks", luv_batch_callbacks},
+  {"defer", luv_defer},
   {"loop_alive", luv_loop_alive},
   {"stop", luv_stop},
   {"backend_fd", luv_backend_fd},
@@ -72,6 +82,19 @@ static const luaL_Reg luv_functions[] = {
 #if LUV_UV_VERSION_GEQ(1, 19, 0)
   {"req_get_type", luv_req_get_type},
 #endif
+  {"req_pool_configure", luv_req_pool_configure},
+  {"req_pool_stats", luv_req_pool_stats},
+  {"await", luv_await},
+
+  // future.c
+  {"new_future", luv_new_future},
+  {"future_resolve", luv_future_resolve_values},
+  {"future_wait", luv_future_wait},
+  {"future_get", luv_future_get},
+  {"future_all", luv_future_all},
+  {"future_any", luv_future_any},
+  {"future_race", luv_future_race},
+  {"future_timeout", luv_future_timeout},
 
   // handle.c
   {"is_active", luv_is_active},
@@ -98,6 +121,21 @@ static const luaL_Reg luv_functions[] = {
   {"timer_get_due_in", luv_timer_get_due_in},
 #endif
 
+  // timer_wheel.c
+  {"new_timer_wheel", luv_new_timer_wheel},
+  {"timer_wheel_start", luv_timer_wheel_start},
+  {"timer_wheel_restart", luv_timer_wheel_restart},
+  {"timer_wheel_stop", luv_timer_wheel_stop},
+  {"timer_wheel_count", luv_timer_wheel_count},
+  {"timer_wheel_close", luv_timer_wheel_close},
+
+  // hrtimer.c
+  {"new_hrtimer", luv_new_hrtimer},
+  {"hrtimer_start", luv_hrtimer_start},
+  {"hrtimer_stop", luv_hrtimer_stop},
+  {"hrtimer_get_due_in", luv_hrtimer_get_due_in},
+  {"hrtimer_close", luv_hrtimer_close},
+
   // prepare.c
   {"new_prepare", luv_new_prepare},
   {"prepare_start", luv_prepare_start},
@@ -158,6 +196,14 @@ static const luaL_Reg luv_functions[] = {
 #if LUV_UV_VERSION_GEQ(1, 19, 0)
   {"stream_get_write_queue_size", luv_stream_get_write_queue_size},
 #endif
+  {"stream_cork", luv_stream_cork},
+  {"stream_uncork", luv_stream_uncork},
+  {"stream_set_watermarks", luv_stream_set_watermarks},
+  {"stream_set_timeouts", luv_stream_set_timeouts},
+  {"pipe_streams", luv_pipe_streams},
+  {"stream_send_file", luv_stream_send_file},
+  {"buffer_pool_configure", luv_buffer_pool_configure},
+  {"buffer_pool_stats", luv_buffer_pool_stats},
 
   // tcp.c
   {"new_tcp", luv_new_tcp},
@@ -250,10 +296,14 @@ static const luaL_Reg luv_functions[] = {
   {"fs_poll_stop", luv_fs_poll_stop},
   {"fs_poll_getpath", luv_fs_poll_getpath},
 
+  // fs_walk.c
+  {"fs_walk", luv_fs_walk},
+
   // fs.c
   {"fs_close", luv_fs_close},
   {"fs_open", luv_fs_open},
   {"fs_read", luv_fs_read},
+  {"fs_read_into", luv_fs_read_into},
   {"fs_unlink", luv_fs_unlink},
   {"fs_write", luv_fs_write},
   {"fs_mkdir", luv_fs_mkdir},
@@ -302,6 +352,8 @@ static const luaL_Reg luv_functions[] = {
 #if LUV_UV_VERSION_GEQ(1, 31, 0)
   {"fs_statfs", luv_fs_statfs},
 #endif
+  {"fs_readfile", luv_fs_readfile},
+  {"fs_writefile", luv_fs_writefile},
 
   // dns.c
   {"getaddrinfo", luv_getaddrinfo},
@@ -426,6 +478,12 @@ static const luaL_Reg luv_functions[] = {
   {"new_work", luv_new_work},
   {"queue_work", luv_queue_work},
 
+  // buffer.c
+  {"new_buffer", luv_new_buffer},
+  {"buffer_size", luv_buffer_size},
+  {"buffer_get_string", luv_buffer_get_string},
+  {"buffer_set_string", luv_buffer_set_string},
+
   // util.c
 #if LUV_UV_VERSION_GEQ(1, 10, 0)
   {"translate_sys_error", luv_translate_sys_error},
@@ -508,6 +566,11 @@ static const luaL_Reg luv_stream_methods[] = {
 #if LUV_UV_VERSION_GEQ(1, 19, 0)
   {"get_write_queue_size", luv_stream_get_write_queue_size},
 #endif
+  {"cork", luv_stream_cork},
+  {"uncork", luv_stream_uncork},
+  {"set_watermarks", luv_stream_set_watermarks},
+  {"set_timeouts", luv_stream_set_timeouts},
+  {"send_file", luv_stream_send_file},
   {NULL, NULL}
 };
 
@@ -641,18 +704,20 @@ static void luv_dir_init(lua_State* L) {
 #endif
 
 static void luv_handle_init(lua_State* L) {
+  luv_ctx_private_t* priv = luv_ctx_private(luv_context(L));
 
   lua_newtable(L);
-#define XX(uc, lc)                             \
-    luaL_newmetatable (L, "uv_"#lc);           \
-    lua_pushcfunction(L, luv_handle_tostring); \
-    lua_setfield(L, -2, "__tostring");         \
-    lua_pushcfunction(L, luv_handle_gc);       \
-    lua_setfield(L, -2, "__gc");               \
-    luaL_newlib(L, luv_##lc##_methods);        \
-    luaL_setfuncs(L, luv_handle_methods, 0);   \
-    lua_setfield(L, -2, "__index");            \
-    lua_pushboolean(L, 1);                     \
+#define XX(uc, lc)                                          \
+    luaL_newmetatable (L, "uv_"#lc);                        \
+    priv->handle_mts[UV_##uc] = lua_topointer(L, -1);       \
+    lua_pushcfunction(L, luv_handle_tostring);              \
+    lua_setfield(L, -2, "__tostring");                      \
+    lua_pushcfunction(L, luv_handle_gc);                    \
+    lua_setfield(L, -2, "__gc");                            \
+    luaL_newlib(L, luv_##lc##_methods);                     \
+    luaL_setfuncs(L, luv_handle_methods, 0);                \
+    lua_setfield(L, -2, "__index");                         \
+    lua_pushboolean(L, 1);                                  \
     lua_rawset(L, -3);
 
   UV_HANDLE_TYPE_MAP(XX)
@@ -781,23 +846,49 @@ LUALIB_API int luv_cfcpcall(lua_State* L, lua_CFunction func, void * ud, int fla
   return ret;
 }
 
-// TODO: see if we can avoid using a string key for this to increase performance
-static const char* luv_ctx_key = "luv_context";
+// The context lives in the registry under the address of this variable.  A
+// light userdata key saves interning a string on every luv_context call,
+// which almost every binding makes.
+static const char luv_ctx_key = 0;
+
+// Release the luv private per-loop state when the lua_State is closed
+static int luv_context_gc(lua_State* L) {
+  luv_ctx_private_t* priv = (luv_ctx_private_t*)lua_touserdata(L, 1);
+  if (priv->ctx.loop)
+    luv_tick_close(&priv->ctx);
+  // Requests and reads finishing while the loop is torn down free directly
+  luv_buf_pool_drain(&priv->read_pool);
+  priv->read_pool.max = 0;
+  luv_buf_pool_drain(&priv->req_pool);
+  priv->req_pool.max = 0;
+  return 0;
+}
 
 // Please look at luv_ctx_t in luv.h
 LUALIB_API luv_ctx_t* luv_context(lua_State* L) {
   luv_ctx_t* ctx;
-  lua_pushstring(L, luv_ctx_key);
-  lua_rawget(L, LUA_REGISTRYINDEX);
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &luv_ctx_key);
   if (lua_isnil(L, -1)) {
+    luv_ctx_private_t* priv;
     // create it if not exist in registry
-    lua_pushstring(L, luv_ctx_key);
-    ctx = (luv_ctx_t*)lua_newuserdata(L, sizeof(*ctx));
-    memset(ctx, 0, sizeof(*ctx));
-    lua_rawset(L, LUA_REGISTRYINDEX);
+    priv = (luv_ctx_private_t*)lua_newuserdata(L, sizeof(*priv));
+    memset(priv, 0, sizeof(*priv));
+    priv->dispatch_ref = LUA_NOREF;
+    luv_buf_pool_init(&priv->read_pool, LUV_BUF_POOL_SIZE, LUV_BUF_POOL_MAX);
+    luv_buf_pool_init(&priv->req_pool, sizeof(luv_req_t), LUV_REQ_POOL_MAX);
+    // setup the userdata's metatable for __gc
+    lua_createtable(L, 0, 1);
+    lua_pushcfunction(L, luv_context_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_setmetatable(L, -2);
+    ctx = &priv->ctx;
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &luv_ctx_key);
     // create table to contain internal handle
     lua_newtable(L);
     lua_setfield(L, LUA_REGISTRYINDEX, luv_handle_key);
+    // and one to keep requests alive while libuv uses them
+    lua_newtable(L);
+    priv->req_anchors = luaL_ref(L, LUA_REGISTRYINDEX);
   } else {
     ctx = (luv_ctx_t*)lua_touserdata(L, -1);
   }
@@ -853,6 +944,8 @@ static int loop_gc(lua_State *L) {
   uv_loop_t* loop = ctx->loop;
   if (loop==NULL)
     return 0;
+  // Internal handles are closed first, walk_cb only knows luv handles
+  luv_tick_close(ctx);
   // Call uv_close on every active handle
   uv_walk(loop, walk_cb, NULL);
   // Run the event loop until all handles are successfully closed
@@ -922,10 +1015,14 @@ LUALIB_API int luaopen_luv (lua_State* L) {
   }
 
   luv_req_init(L);
+  luv_future_init(L);
   luv_handle_init(L);
 #if LUV_UV_VERSION_GEQ(1, 28, 0)
   luv_dir_init(L);
 #endif
+  luv_buffer_init(L);
+  luv_timer_wheel_init(L);
+  luv_hrtimer_init(L);
   luv_thread_init(L);
   luv_synch_init(L);
   luv_work_init(L);
@@ -51,14 +51,15 @@ static void luv_prep_buf(lua_State *L, int idx, uv_buf_t *pbuf) {
 }
 
 // - number of buffers is stored in *count
-// - if refs is non-NULL, then *refs is set to a heap-allocated, LUA_NOREF-terminated array
-//   of ref integers (refs are to each string in the bufs)
+// - if pin is set, a table holding the strings of the bufs is left on top
+//   of the stack so the caller can keep them alive
 // returns: heap-allocated array of uv_buf_t
-static uv_buf_t* luv_prep_bufs(lua_State* L, int index, size_t *count, int **refs) {
+static uv_buf_t* luv_prep_bufs(lua_State* L, int index, size_t *count, int pin) {
   uv_buf_t *bufs;
   size_t i;
   size_t cnt;
   cnt = lua_rawlen(L, index);
+  index = lua_absindex(L, index);
   if (cnt == 0) {
     luaL_argerror(L, index, "expected non-empty table of strings");
     return NULL;
@@ -66,55 +67,33 @@ static uv_buf_t* luv_prep_bufs(lua_State* L, int index, size_t *count, int **ref
   *count = cnt;
   bufs = (uv_buf_t*)malloc(sizeof(uv_buf_t) * *count);
   if (!bufs) luaL_error(L, "Failed to allocate buffer array");
-  int *refs_array = NULL;
-  if (refs) {
-    refs_array = (int*)malloc(sizeof(int) * (*count + 1));
-    if (!refs_array) {
-      free(bufs);
-      luaL_error(L, "Failed to allocate refs array");
-    }
-  }
+  if (pin) lua_createtable(L, (int)cnt, 0);
   for (i = 0; i < *count; ++i) {
     lua_rawgeti(L, index, i + 1);
     if (!lua_isstring(L, -1)) {
-      /* free already-accumulated refs and heap allocations before throwing */
-      if (refs_array) {
-        size_t j;
-        for (j = 0; j < i; ++j)
-          luaL_unref(L, LUA_REGISTRYINDEX, refs_array[j]);
-        free(refs_array);
-      }
+      /* free heap allocations before throwing */
       free(bufs);
       luaL_argerror(L, index, lua_pushfstring(L, "expected table of strings, found %s in the table", luaL_typename(L, -1)));
       return NULL;
     }
     luv_prep_buf(L, -1, &bufs[i]);
-    if (refs) {
-      // push the string again to ref it, will be popped by luaL_ref
-      lua_pushvalue(L, -1);
-      refs_array[i] = luaL_ref(L, LUA_REGISTRYINDEX);
-    }
-    lua_pop(L, 1);
-  }
-  if (refs) {
-    // refs array is LUA_NOREF-terminated
-    refs_array[*count] = LUA_NOREF;
-    *refs = refs_array;
+    if (pin)
+      lua_rawseti(L, -2, i + 1);
+    else
+      lua_pop(L, 1);
   }
   return bufs;
 }
 
 // Sets up a uv_bufs_t array to pass to write/send libuv functions that take a uv_buf_t*
 // - count: set to length of the returned uv_buf_t array
-// - req_data: refs to the strings used are stored in req_data->data/req_data->data_ref
+// - req_data: the strings used are pinned to the request
 // returns: heap-allocated array of uv_buf_t
 static uv_buf_t* luv_check_bufs(lua_State* L, int index, size_t* count, luv_req_t* req_data) {
   uv_buf_t* bufs = NULL;
   if (lua_istable(L, index)) {
-    int* refs = NULL;
-    bufs = luv_prep_bufs(L, index, count, &refs);
-    req_data->data = refs;
-    req_data->data_ref = LUV_REQ_MULTIREF;
+    bufs = luv_prep_bufs(L, index, count, 1);
+    luv_req_set_data(L, req_data);
   }
   else if (lua_isstring(L, index)) {
     *count = 1;
@@ -122,7 +101,7 @@ static uv_buf_t* luv_check_bufs(lua_State* L, int index, size_t* count, luv_req_
     if (!bufs) luaL_error(L, "Failed to allocate buffer");
     luv_prep_buf(L, index, bufs);
     lua_pushvalue(L, index);
-    req_data->data_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    luv_req_set_data(L, req_data);
   }
   else {
     luaL_argerror(L, index, lua_pushfstring(L, "data must be string or table of strings, got %s", luaL_typename(L, index)));
@@ -130,12 +109,12 @@ static uv_buf_t* luv_check_bufs(lua_State* L, int index, size_t* count, luv_req_
   return bufs;
 }
 
-// Like luv_check_bufs but does not ref the buf strings.
+// Like luv_check_bufs but does not pin the buf strings.
 // Only meant to be used for functions like luv_udp_try_send.
 static uv_buf_t* luv_check_bufs_noref(lua_State* L, int index, size_t* count) {
   uv_buf_t* bufs = NULL;
   if (lua_istable(L, index)) {
-    bufs = luv_prep_bufs(L, index, count, NULL);
+    bufs = luv_prep_bufs(L, index, count, 0);
   }
   else if (lua_isstring(L, index)) {
     *count = 1;
@@ -780,12 +759,11 @@ static int luv_random(lua_State* L) {
     return 1;
   }
   else {
-    // ref buffer
-    int buf_ref = luaL_ref(L, LUA_REGISTRYINDEX);
-
-    uv_random_t* req = (uv_random_t*)lua_newuserdata(L, uv_req_size(UV_RANDOM));
+    uv_random_t* req = (uv_random_t*)luv_newreq(L, UV_RANDOM);
     req->data = luv_setup_req(L, ctx, cb_ref);
-    ((luv_req_t*)req->data)->req_ref = buf_ref;
+    // pin buffer
+    lua_pushvalue(L, -2);
+    luv_req_set_data(L, (luv_req_t*)req->data);
 
     int ret = uv_random(ctx->loop, req, buf, buflen, flags, luv_random_cb);
     if (ret < 0) {
@@ -25,7 +25,7 @@ static uv_poll_t* luv_check_poll(lua_State* L, int index) {
 static int luv_new_poll(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   int fd = luaL_checkinteger(L, 1);
-  uv_poll_t* handle = (uv_poll_t*)luv_newuserdata(L, uv_handle_size(UV_POLL));
+  uv_poll_t* handle = (uv_poll_t*)luv_newhandle(L, UV_POLL);
   int ret = uv_poll_init(ctx->loop, handle, fd);
   if (ret < 0) {
     lua_pop(L, 1);
@@ -38,7 +38,7 @@ static int luv_new_poll(lua_State* L) {
 static int luv_new_socket_poll(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   int fd = luaL_checkinteger(L, 1);
-  uv_poll_t* handle = (uv_poll_t*)luv_newuserdata(L, uv_handle_size(UV_POLL));
+  uv_poll_t* handle = (uv_poll_t*)luv_newhandle(L, UV_POLL);
   int ret = uv_poll_init_socket(ctx->loop, handle, fd);
   if (ret < 0) {
     lua_pop(L, 1);
@@ -22,7 +22,10 @@
 #include "compat-5.3.h"
 #endif
 
+#include "lctx.h"
+#include "lframe.h"
 #include "lhandle.h"
+#include "lpool.h"
 #include "lreq.h"
 #include "lthreadpool.h"
 #include "luv.h"
@@ -36,6 +39,9 @@
 /* From stream.c */
 static uv_stream_t* luv_check_stream(lua_State* L, int index);
 static void luv_alloc_cb(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
+static void luv_stream_flush_tick(luv_ctx_t* ctx);
+static int luv_stream_flush_corked(uv_handle_t* handle);
+static void luv_stream_closing(uv_handle_t* handle);
 
 /* From lhandle.c */
 /* Traceback for lua_pcall */
@@ -54,34 +60,74 @@ static void luv_check_callback(lua_State* L, luv_handle_t* data, luv_callback_id
 */
 static void luv_call_callback(lua_State* L, luv_handle_t* data, luv_callback_id id, int nargs);
 
+/* Same as luv_call_callback but never queued when callbacks are batched */
+static void luv_call_callback_now(lua_State* L, luv_handle_t* data, luv_callback_id id, int nargs);
+
 /* Push a userdata on the stack from a handle */
 static void luv_find_handle(lua_State* L, luv_handle_t* data);
 
 /* Unref the handle from the lua world, allowing it to GC */
 static void luv_unref_handle(lua_State* L, luv_handle_t* data);
 
+/* From lpool.c */
+static void luv_buf_pool_init(luv_buf_pool_t* pool, size_t size, unsigned int max);
+static char* luv_buf_pool_get(luv_buf_pool_t* pool);
+static void luv_buf_pool_put(luv_buf_pool_t* pool, char* base, size_t len);
+static void luv_buf_pool_drain(luv_buf_pool_t* pool);
+
+/* From lframe.c */
+static void luv_check_frame(lua_State* L, int index, int arg, luv_frame_t* frame);
+static int luv_frame_next(const luv_frame_t* frame, const char* base, size_t len, size_t scanned,
+                          size_t* head, size_t* size, size_t* tail);
+
+/* From ltick.c */
+static int luv_tick_schedule(luv_ctx_t* ctx);
+static int luv_tick_close(luv_ctx_t* ctx);
+static void luv_internal_add(luv_ctx_t* ctx, luv_internal_t* internal, uv_handle_t* handle, void (*close)(uv_handle_t*));
+static void luv_internal_remove(luv_ctx_t* ctx, luv_internal_t* internal);
+static int luv_dispatch_push(lua_State* L, luv_ctx_t* ctx, int nargs);
+static void luv_dispatch_drain(luv_ctx_t* ctx);
+
+/* From future.c */
+static int luv_future_resolve(lua_State* L, int index, int nargs);
+
 /* From lreq.c */
-/* Used in the top of a setup function to check the arg
-   and ref the callback to an integer.
+/* True if the value can be passed where a request takes its callback, a
+   callable, a coroutine to resume or a future to resolve.
+*/
+static int luv_is_continuation(lua_State* L, int index);
+
+/* Used in the top of a setup function to check the arg.  Returns the
+   absolute index of the callback for luv_setup_req, or LUA_NOREF.
 */
 static int luv_check_continuation(lua_State* L, int index);
 
+static int luv_resume_continuation(lua_State* L);
+static void luv_call_continuation(lua_State* L, luv_ctx_t* ctx, int nargs);
+
+/* push a userdata for a request of the given type */
+static void* luv_newreq(lua_State* L, uv_req_type type);
+
 /* setup a luv_req_t.  The userdata is assumed to be at the
    top of the stack.
 */
 static luv_req_t* luv_setup_req(lua_State* L, luv_ctx_t* ctx, int ref);
 static luv_req_t* luv_setup_req_with_mt(lua_State* L, luv_ctx_t* ctx, int ref, const char* mt_name);
+static void luv_req_push(lua_State* L, luv_req_t* data);
+static void luv_req_set_data(lua_State* L, luv_req_t* data);
+static void luv_req_push_data(lua_State* L, luv_req_t* data);
 static void luv_fulfill_req(lua_State* L, luv_req_t* data, int nargs);
 static void luv_cleanup_req(lua_State* L, luv_req_t* data);
 
 /* From handle.c */
 static void* luv_checkudata(lua_State* L, int ud, const char* tname);
 static void* luv_newuserdata(lua_State* L, size_t sz);
+static void* luv_newhandle(lua_State* L, uv_handle_type type);
 
 
 /* From misc.c */
 static void luv_prep_buf(lua_State *L, int idx, uv_buf_t *pbuf);
-static uv_buf_t* luv_prep_bufs(lua_State* L, int index, size_t *count, int **refs);
+static uv_buf_t* luv_prep_bufs(lua_State* L, int index, size_t *count, int pin);
 static uv_buf_t* luv_check_bufs(lua_State* L, int index, size_t *count, luv_req_t* req_data);
 static uv_buf_t* luv_check_bufs_noref(lua_State* L, int index, size_t *count);
 
@@ -126,6 +172,16 @@ static int luv_arg_type_error(lua_State* L, int index, const char* fmt);
 
 static int luv_optboolean(lua_State*L, int idx, int defaultval);
 
+// Push a userdata that has LUV_USERDATA_SLOTS user value slots
+static void* luv_newuserdata_slots(lua_State* L, size_t sz);
+
+// Pop the value on top of the stack into slot n of the userdata at index.
+// fresh tells that none of its slots has been set yet.
+static void luv_setslot(lua_State* L, int index, int n, int fresh);
+
+// Push slot n of the userdata at index
+static void luv_getslot(lua_State* L, int index, int n);
+
 /* From thread.c */
 static lua_State* luv_thread_acquire_vm(void);
 
@@ -45,6 +45,57 @@ static int luv_cancel(lua_State* L) {
   return luv_result(L, ret);
 }
 
+// Calls a request function from a coroutine with the coroutine appended as
+// its continuation, then yields until the request completes.  When the call
+// fails right away, e.g. on bad arguments, its results are returned as is.
+static int luv_await(lua_State* L) {
+  int nargs = lua_gettop(L) - 1;
+  luv_check_callable(L, 1);
+  if (lua_pushthread(L)) {
+    return luaL_error(L, "uv.await must be called from a coroutine");
+  }
+  lua_call(L, nargs + 1, LUA_MULTRET);
+  if (lua_gettop(L) == 0 || lua_isnil(L, 1)) {
+    return lua_gettop(L);
+  }
+  lua_settop(L, 0);
+  // The callback's arguments become the results
+  return lua_yield(L, 0);
+}
+
+// luv_req_t are taken from a per-loop freelist shared by every request type,
+// the uv_req_t itself lives in the userdata handed to Lua.
+static int luv_req_pool_configure(lua_State* L) {
+  luv_buf_pool_t* pool = &luv_ctx_private(luv_context(L))->req_pool;
+  lua_Integer max = luaL_checkinteger(L, 1);
+  luaL_argcheck(L, max >= 0 && max <= UINT_MAX, 1, "cap must be a non-negative integer");
+  pool->max = (unsigned int)max;
+  // Drop what no longer fits under the new cap
+  if (pool->count > pool->max)
+    luv_buf_pool_drain(pool);
+  return luv_result(L, 0);
+}
+
+static int luv_req_pool_stats(lua_State* L) {
+  luv_buf_pool_t* pool = &luv_ctx_private(luv_context(L))->req_pool;
+
+  lua_createtable(L, 0, 4);
+
+  lua_pushinteger(L, pool->max);
+  lua_setfield(L, -2, "max");
+
+  lua_pushinteger(L, pool->count);
+  lua_setfield(L, -2, "cached");
+
+  lua_pushinteger(L, pool->hits);
+  lua_setfield(L, -2, "hits");
+
+  lua_pushinteger(L, pool->misses);
+  lua_setfield(L, -2, "misses");
+
+  return 1;
+}
+
 #if LUV_UV_VERSION_GEQ(1, 19, 0)
 static int luv_req_get_type(lua_State* L) {
   uv_req_t* req = luv_check_req(L, 1);
@@ -15,30 +15,367 @@
  *
  */
 #include "private.h"
+#ifdef __linux__
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+// How reads are handed to Lua when batching is enabled
+#define LUV_BATCH_NONE 0
+#define LUV_BATCH_STRING 1
+#define LUV_BATCH_ARRAY 2
+
+// Stream specific state, kept in luv_handle_t.extra and only allocated once
+// a stream uses a feature that needs it.
+typedef struct luv_stream_s {
+  luv_ctx_t* ctx;
+  uv_stream_t* handle;
+  int tick_queued;        /* linked in the loop's tick_streams list */
+  struct luv_stream_s* tick_next;
+  int read_buf_ref;       /* ref to the uv_buffer reads land in */
+  luv_buffer_t* read_buf; /* NULL when reads are copied into strings */
+  size_t read_offset;     /* where in read_buf reads land */
+
+  // Reads collected during the current loop iteration.  The chunks are
+  // stored back to back in batch_base, batch_lens records their sizes.
+  int batch_mode;
+  char* batch_base;
+  size_t batch_len;
+  size_t batch_cap;
+  size_t* batch_lens;
+  size_t batch_count;
+  size_t batch_lens_cap;
+
+  // Framing applied to reads.  Data that does not make up a whole frame yet
+  // waits in frame_base, the first frame_scanned bytes of it are known not
+  // to contain the start of a delimiter.
+  luv_frame_t frame;
+  char* frame_base;
+  size_t frame_len;
+  size_t frame_cap;
+  size_t frame_scanned;
+
+  // Writes held back while the stream is corked, issued as one uv_write
+  // with all their buffers on uncork or at the end of the loop iteration.
+  int cork_mode;
+  uv_write_t** cork_reqs;
+  size_t cork_count;
+  size_t cork_reqs_cap;
+  uv_buf_t* cork_bufs;
+  size_t cork_nbufs;
+  size_t cork_bufs_cap;
+  size_t cork_bytes;
+  struct luv_cork_write_s* cork_failed; /* refused by libuv, see below */
+
+  // Write backpressure.  Once the bytes waiting to be written exceed
+  // write_high, write_full is set until they fall to write_low again, at
+  // which point the drain callback runs.
+  size_t write_high;      /* 0 when no watermarks are set */
+  size_t write_low;
+  int write_full;
+  int drain_ref;
+
+  // Deadlines checked by the loop's sweep timer, in loop time.  The stream
+  // is linked in the loop's timeout_streams list while any is set.
+  uint64_t read_idle;     /* 0 when not enforced */
+  uint64_t write_stall;   /* 0 when not enforced */
+  uint64_t last_read;     /* reading started or data arrived */
+  uint64_t last_write;    /* the write queue last made progress */
+  size_t last_queue;      /* write queue size at last_write */
+  int timeout_ref;        /* LUA_NOREF closes the stream on expiry */
+  int timeout_linked;
+  int timeout_fired;      /* LUV_STREAM_* bits waiting to be reported */
+  struct luv_stream_s* timeout_prev;
+  struct luv_stream_s* timeout_next;
+  struct luv_stream_s* timeout_fired_next;
+
+  struct luv_splice_s* splice;    /* splice reading from this stream */
+  struct luv_splice_s* splice_in; /* splice writing into this stream */
+  struct luv_sendfile_s* sendfile;
+
+  // Connections accepted in C on a listening stream, delivered as an array
+  // once accept_batch of them are ready or at the end of the iteration.
+  size_t accept_batch;    /* 0 when connections are accepted from Lua */
+  int accept_read_ref;    /* read callback started on every connection */
+  int accept_list_ref;
+  size_t accept_count;
+} luv_stream_t;
+
+// Deadlines of uv.stream_set_timeouts
+#define LUV_STREAM_READ_IDLE 1
+#define LUV_STREAM_WRITE_STALL 2
+
+// The loop's timer that checks the deadlines of all streams at once
+typedef struct {
+  uv_timer_t handle; /* must be first */
+  luv_ctx_private_t* priv;
+} luv_stream_sweep_t;
+
+// How writes are held while a stream is corked
+#define LUV_CORK_NONE 0
+#define LUV_CORK_MANUAL 1
+#define LUV_CORK_AUTO 2
+
+// One vectored write standing in for the corked writes it carries.  When
+// libuv refuses it right away the writes are completed with the error from
+// the tick hook, so their callbacks never run from within uncork, write or
+// close.  Meanwhile it waits in the stream's cork_failed list.
+typedef struct luv_cork_write_s {
+  uv_write_t req; /* must be first */
+  uv_stream_t* handle;
+  int status;
+  struct luv_cork_write_s* next;
+  size_t count;
+  uv_write_t* reqs[1];
+} luv_cork_write_t;
+
+// A uv.pipe_streams relay.  Chunks read from src are written to dst in the
+// very buffer they were read into, and reading pauses while more than high
+// bytes are queued on dst.  Owned by the luv_stream_t of src; it outlives it
+// while writes or the shutdown of dst are still in flight.
+typedef struct luv_splice_s {
+  luv_ctx_t* ctx;
+  uv_stream_t* src;  /* NULL once src is gone */
+  uv_stream_t* dst;  /* NULL once dst is gone */
+  int src_ref;
+  int dst_ref;
+  int cb_ref;
+  size_t high;
+  size_t low;
+  int shutdown;      /* shut dst down once src reaches EOF */
+  int paused;        /* reading stopped because dst is full */
+  int eof;
+  int status;        /* first error, ends the relay */
+  size_t pending;    /* writes in flight */
+  int shutting;      /* shutdown_req in flight */
+  uint64_t bytes;    /* bytes written to dst */
+  uv_shutdown_t shutdown_req;
+} luv_splice_t;
+
+typedef struct {
+  uv_write_t req; /* must be first */
+  luv_splice_t* splice;
+  char* base;     /* pooled read buffer */
+  size_t size;
+  size_t len;
+} luv_splice_write_t;
+
+// Default high watermark of uv.pipe_streams, the low one defaults to half
+// of the high one
+#define LUV_SPLICE_HIGH (4 * LUV_BUF_POOL_SIZE)
+
+// A stream:send_file() in progress.  On Linux the file is handed to
+// sendfile(2) each time the stream polls writable.  Elsewhere, or when the
+// kernel can't sendfile from this fd, chunks are read into pooled buffers
+// and written one at a time.  Writes made meanwhile are held like corked
+// ones and go out after the file.
+typedef struct luv_sendfile_s {
+  luv_ctx_t* ctx;
+  uv_stream_t* handle; /* NULL once the stream is gone */
+  int cb_ref;
+  uv_file fd;
+  int64_t offset;
+  uint64_t remaining;
+  uint64_t sent;
+  int status;          /* first error, ends the transfer */
+  int busy;            /* fs_req or write_req in flight */
+  char* base;          /* pooled buffer of the chunk in flight */
+  size_t size;
+  size_t len;
+  uv_fs_t fs_req;
+  uv_write_t write_req;
+  struct luv_sendfile_poll_s* poll; /* NULL when using buffers */
+} luv_sendfile_t;
+
+#ifdef __linux__
+// Polls a dup of the stream's fd, libuv doesn't allow a second handle on
+// the fd it owns.  Its data is NULL like every internal handle.
+typedef struct luv_sendfile_poll_s {
+  uv_poll_t handle; /* must be first */
+  luv_sendfile_t* sf;
+  int fd;
+  luv_internal_t internal;
+} luv_sendfile_poll_t;
+
+// Most sendfile(2) will transfer in one call
+#define LUV_SENDFILE_MAX 0x7ffff000
+#endif
+
+// Batch memory above this size is released after each flush instead of
+// being kept for the next iteration.
+#define LUV_BATCH_KEEP_SIZE (4 * LUV_BUF_POOL_SIZE)
+
+#ifdef __linux__
+static void luv_sendfile_poll_close_cb(uv_handle_t* handle) {
+  close(((luv_sendfile_poll_t*)handle)->fd);
+  free(handle);
+}
+#endif
+
+static void luv_sendfile_poll_close(luv_sendfile_t* sf) {
+#ifdef __linux__
+  if (!sf->poll) return;
+  luv_internal_remove(sf->ctx, &sf->poll->internal);
+  uv_close((uv_handle_t*)&sf->poll->handle, luv_sendfile_poll_close_cb);
+  sf->poll = NULL;
+#else
+  (void)sf;
+#endif
+}
+
+#ifdef __linux__
+// The loop is torn down during the transfer, which is then finished by the
+// stream closing
+static void luv_sendfile_poll_teardown(uv_handle_t* handle) {
+  luv_sendfile_poll_close(((luv_sendfile_poll_t*)handle)->sf);
+}
+
+static void luv_sendfile_poll_cb(uv_poll_t* handle, int status, int events);
+#endif
+
+static int luv_stream_queue_tick(luv_stream_t* s);
+
+// Restarts the poll once the writes libuv had queued for the stream are
+// done, luv_sendfile_poll_cb stops it meanwhile since the fd keeps polling
+// writable.  A failure ends the transfer from the tick hook.
+static void luv_sendfile_poll_resume(luv_stream_t* s) {
+#ifdef __linux__
+  luv_sendfile_t* sf = s->sendfile;
+  int ret;
+  if (!sf->poll || sf->status || sf->handle->write_queue_size) return;
+  if (uv_is_active((uv_handle_t*)&sf->poll->handle)) return;
+  ret = uv_poll_start(&sf->poll->handle, UV_WRITABLE, luv_sendfile_poll_cb);
+  if (ret < 0) {
+    sf->status = ret;
+    luv_sendfile_poll_close(sf);
+    if (!sf->busy) luv_stream_queue_tick(s);
+  }
+#else
+  (void)s;
+#endif
+}
+
+// Called when the stream goes away with the transfer still running, it is
+// freed once its last request completes.
+static void luv_sendfile_detach(luv_sendfile_t* sf) {
+  luv_sendfile_poll_close(sf);
+  sf->handle = NULL;
+  if (sf->busy) return;
+  luaL_unref(sf->ctx->L, LUA_REGISTRYINDEX, sf->cb_ref);
+  free(sf);
+}
+
+// Frees a splice whose source went away once nothing refers to it anymore
+static void luv_splice_release(luv_splice_t* sp) {
+  lua_State* L = sp->ctx->L;
+  if (sp->src || sp->pending || sp->shutting) return;
+  luaL_unref(L, LUA_REGISTRYINDEX, sp->src_ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, sp->dst_ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, sp->cb_ref);
+  free(sp);
+}
+
+static void luv_stream_timeout_unlink(luv_stream_t* s) {
+  luv_ctx_private_t* priv = luv_ctx_private(s->ctx);
+  if (!s->timeout_linked) return;
+  if (s->timeout_prev)
+    s->timeout_prev->timeout_next = s->timeout_next;
+  else
+    priv->timeout_streams = s->timeout_next;
+  if (s->timeout_next)
+    s->timeout_next->timeout_prev = s->timeout_prev;
+  s->timeout_prev = NULL;
+  s->timeout_next = NULL;
+  s->timeout_linked = 0;
+  // May still be queued by a running sweep, which then skips it
+  s->timeout_fired = 0;
+  // The sweep timer goes with the last stream that has deadlines
+  if (!priv->timeout_streams && priv->sweep) {
+    uv_close((uv_handle_t*)priv->sweep, luv_tick_close_cb);
+    priv->sweep = NULL;
+  }
+}
+
+static void luv_write_done(uv_write_t* req, int status);
+static void luv_cork_write_done(luv_cork_write_t* cw, int status);
+
+static void luv_stream_free(void* ptr) {
+  luv_stream_t* s = (luv_stream_t*)ptr;
+  luv_cork_write_t* cw;
+  size_t i;
+  if (s->splice_in) s->splice_in->dst = NULL;
+  if (s->sendfile) luv_sendfile_detach(s->sendfile);
+  if (s->splice) {
+    luv_splice_t* sp = s->splice;
+    if (sp->dst) ((luv_stream_t*)((luv_handle_t*)sp->dst->data)->extra)->splice_in = NULL;
+    sp->src = NULL;
+    sp->dst = NULL;
+    luv_splice_release(sp);
+  }
+  luv_stream_timeout_unlink(s);
+  if (s->tick_queued) {
+    luv_stream_t** link = &luv_ctx_private(s->ctx)->tick_streams;
+    while (*link != s) link = &(*link)->tick_next;
+    *link = s->tick_next;
+  }
+  // Writes refused by libuv that the tick hook did not get to, and writes
+  // still held when the loop is torn down
+  while ((cw = s->cork_failed)) {
+    s->cork_failed = cw->next;
+    luv_cork_write_done(cw, cw->status);
+  }
+  for (i = 0; i < s->cork_count; i++) {
+    luv_write_done(s->cork_reqs[i], UV_ECANCELED);
+  }
+  s->cork_count = 0;
+  luaL_unref(s->ctx->L, LUA_REGISTRYINDEX, s->read_buf_ref);
+  luaL_unref(s->ctx->L, LUA_REGISTRYINDEX, s->drain_ref);
+  luaL_unref(s->ctx->L, LUA_REGISTRYINDEX, s->timeout_ref);
+  luaL_unref(s->ctx->L, LUA_REGISTRYINDEX, s->accept_read_ref);
+  luaL_unref(s->ctx->L, LUA_REGISTRYINDEX, s->accept_list_ref);
+  free(s->cork_reqs);
+  free(s->cork_bufs);
+  free(s->batch_base);
+  free(s->batch_lens);
+  free(s->frame_base);
+  free(s);
+}
+
+static luv_stream_t* luv_stream_data(lua_State* L, uv_stream_t* handle) {
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_stream_t* s = (luv_stream_t*)data->extra;
+  if (s) return s;
+  s = (luv_stream_t*)malloc(sizeof(*s));
+  if (!s) luaL_error(L, "Can't allocate luv stream data");
+  memset(s, 0, sizeof(*s));
+  s->ctx = data->ctx;
+  s->handle = handle;
+  s->read_buf_ref = LUA_NOREF;
+  s->drain_ref = LUA_NOREF;
+  s->timeout_ref = LUA_NOREF;
+  s->accept_read_ref = LUA_NOREF;
+  s->accept_list_ref = LUA_NOREF;
+  data->extra = s;
+  data->extra_gc = luv_stream_free;
+  return s;
+}
 
 static uv_stream_t* luv_check_stream(lua_State* L, int index) {
-  int isStream;
   void *udata;
   uv_stream_t* handle;
+  const void* mt;
+  const luv_ctx_private_t* priv;
   // check if the input is a userdata
   udata = lua_touserdata(L, index);
-  if (!udata) goto fail;
-  // "uv_stream" in the registry is a table structured like so:
-  // {
-  //   [<uv_pipe metatable>] = true,
-  //   [<uv_tcp metatable>] = true,
-  //   [<uv_tty metatable>] = true,
-  // }
-  // so to check that the value at the index is a "uv_stream",
-  // we get its metatable and check that we get `true` back
-  // when looking the metatable up in the "uv_stream" table.
-  lua_getfield(L, LUA_REGISTRYINDEX, "uv_stream");
-  isStream = lua_getmetatable(L, index < 0 ? index - 1 : index);
-  if (!isStream) goto fail;
-  lua_rawget(L, -2);
-  isStream = lua_toboolean(L, -1);
-  lua_pop(L, 2);
-  if (!isStream) goto fail;
+  if (!udata || !lua_getmetatable(L, index)) goto fail;
+  // Only the uv_pipe, uv_tcp and uv_tty metatables, see luv_check_handle
+  mt = lua_topointer(L, -1);
+  lua_pop(L, 1);
+  priv = luv_ctx_private(luv_context(L));
+  if (!mt || (mt != priv->handle_mts[UV_NAMED_PIPE] &&
+              mt != priv->handle_mts[UV_TCP] &&
+              mt != priv->handle_mts[UV_TTY])) goto fail;
   // cast the userdata to uv_stream_t
   handle = *(uv_stream_t**)udata;
   if (!handle->data) goto fail;
@@ -61,9 +398,10 @@ static int luv_shutdown(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   uv_stream_t* handle = luv_check_stream(L, 1);
   int ref = luv_check_continuation(L, 2);
-  uv_shutdown_t* req = (uv_shutdown_t*)lua_newuserdata(L, uv_req_size(UV_SHUTDOWN));
+  uv_shutdown_t* req = (uv_shutdown_t*)luv_newreq(L, UV_SHUTDOWN);
   int ret;
   req->data = luv_setup_req(L, ctx, ref);
+  luv_stream_flush_corked((uv_handle_t*)handle);
   ret = uv_shutdown(req, handle, luv_shutdown_cb);
   if (ret < 0) {
     luv_cleanup_req(L, (luv_req_t*)req->data);
@@ -80,12 +418,42 @@ static void luv_connection_cb(uv_stream_t* handle, int status) {
   luv_call_callback(L, (luv_handle_t*)handle->data, LUV_CONNECTION, 1);
 }
 
+static void luv_connection_batch_cb(uv_stream_t* handle, int status);
+
 static int luv_listen(lua_State* L) {
   uv_stream_t* handle = luv_check_stream(L, 1);
   int backlog = luaL_checkinteger(L, 2);
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  uv_connection_cb cb = luv_connection_cb;
+  lua_Integer batch = 0;
+  luv_stream_t* s;
+  int cb_index = 3;
   int ret;
-  luv_check_callback(L, (luv_handle_t*)handle->data, LUV_CONNECTION, 3);
-  ret = uv_listen(handle, backlog, luv_connection_cb);
+  if (lua_type(L, 3) == LUA_TTABLE) {
+    cb_index = 4;
+    luv_check_callable(L, cb_index);
+    lua_getfield(L, 3, "batch");
+    batch = luaL_optinteger(L, -1, 0);
+    luaL_argcheck(L, batch >= 0 && batch <= INT_MAX, 3, "batch option must be a non-negative integer");
+    lua_getfield(L, 3, "read");
+    if (!lua_isnil(L, -1)) {
+      luaL_argcheck(L, batch > 0, 3, "read option requires the batch option");
+      luaL_argcheck(L, luv_is_callable(L, -1), 3, "read option must be callable");
+    }
+  }
+  luv_check_callback(L, data, LUV_CONNECTION, cb_index);
+  if (batch || data->extra) {
+    s = luv_stream_data(L, handle);
+    s->accept_batch = (size_t)batch;
+    luaL_unref(L, LUA_REGISTRYINDEX, s->accept_read_ref);
+    s->accept_read_ref = LUA_NOREF;
+    if (batch && !lua_isnil(L, -1)) {
+      lua_pushvalue(L, -1);
+      s->accept_read_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    if (batch) cb = luv_connection_batch_cb;
+  }
+  ret = uv_listen(handle, backlog, cb);
   return luv_result(L, ret);
 }
 
@@ -96,30 +464,946 @@ static int luv_accept(lua_State* L) {
   return luv_result(L, ret);
 }
 
+// Read buffers come from the loop's read pool and go back to it in
+// luv_read_cb once their contents have been handed to Lua.
 static void luv_alloc_cb(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
-  (void)handle;
-  buf->base = (char*)malloc(suggested_size);
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_buf_pool_t* pool = &luv_ctx_private(data->ctx)->read_pool;
+  (void)suggested_size;
+  buf->base = luv_buf_pool_get(pool);
   if (!buf->base) {
     buf->len = 0;
     return;
   }
-  buf->len = suggested_size;
+  buf->len = pool->size;
+}
+
+// Streams reading into a uv_buffer get the free space of that buffer instead
+// of a pooled one.
+static void luv_stream_alloc_cb(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  luv_stream_t* s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  if (s && s->read_buf) {
+    buf->base = s->read_buf->base + s->read_offset;
+    buf->len = s->read_buf->size - s->read_offset;
+    return;
+  }
+  luv_alloc_cb(handle, suggested_size, buf);
+}
+
+// Links the stream into the loop's list of streams with batched reads or
+// buffered frames, which the tick hook flushes
+static int luv_stream_queue_tick(luv_stream_t* s) {
+  luv_ctx_private_t* priv = luv_ctx_private(s->ctx);
+  int ret;
+  if (s->tick_queued) return 0;
+  ret = luv_tick_schedule(s->ctx);
+  if (ret < 0) return ret;
+  s->tick_next = priv->tick_streams;
+  priv->tick_streams = s;
+  s->tick_queued = 1;
+  return 0;
+}
+
+static int luv_stream_batch_append(luv_stream_t* s, const char* base, size_t len) {
+  int ret = luv_stream_queue_tick(s);
+  if (ret < 0) return ret;
+  if (s->batch_len + len > s->batch_cap) {
+    size_t cap = s->batch_cap ? s->batch_cap * 2 : len;
+    char* p;
+    while (cap < s->batch_len + len) cap *= 2;
+    p = (char*)realloc(s->batch_base, cap);
+    if (!p) return UV_ENOMEM;
+    s->batch_base = p;
+    s->batch_cap = cap;
+  }
+  if (s->batch_count == s->batch_lens_cap) {
+    size_t cap = s->batch_lens_cap ? s->batch_lens_cap * 2 : 8;
+    size_t* p = (size_t*)realloc(s->batch_lens, cap * sizeof(*p));
+    if (!p) return UV_ENOMEM;
+    s->batch_lens = p;
+    s->batch_lens_cap = cap;
+  }
+  memcpy(s->batch_base + s->batch_len, base, len);
+  s->batch_len += len;
+  s->batch_lens[s->batch_count++] = len;
+  return 0;
+}
+
+// Hands everything read so far to the read callback in one call
+static void luv_stream_deliver_batch(lua_State* L, luv_stream_t* s) {
+  size_t i, offset;
+  lua_pushnil(L);
+  if (s->batch_mode == LUV_BATCH_ARRAY) {
+    lua_createtable(L, (int)s->batch_count, 0);
+    for (i = 0, offset = 0; i < s->batch_count; offset += s->batch_lens[i++]) {
+      lua_pushlstring(L, s->batch_base + offset, s->batch_lens[i]);
+      lua_rawseti(L, -2, i + 1);
+    }
+  }
+  else {
+    lua_pushlstring(L, s->batch_base, s->batch_len);
+  }
+  s->batch_len = 0;
+  s->batch_count = 0;
+  if (s->batch_cap > LUV_BATCH_KEEP_SIZE) {
+    free(s->batch_base);
+    s->batch_base = NULL;
+    s->batch_cap = 0;
+  }
+  luv_call_callback(L, (luv_handle_t*)s->handle->data, LUV_READ, 2);
+}
+
+// Hands the connections accepted so far to the connection callback.  If the
+// server was closed in the meantime they are closed instead.
+static void luv_stream_deliver_accepts(lua_State* L, luv_stream_t* s) {
+  int ref = s->accept_list_ref;
+  size_t i, count = s->accept_count;
+  s->accept_list_ref = LUA_NOREF;
+  s->accept_count = 0;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, ref);
+  if (uv_is_closing((uv_handle_t*)s->handle)) {
+    for (i = 1; i <= count; i++) {
+      lua_rawgeti(L, -1, i);
+      uv_close(*(uv_handle_t**)lua_touserdata(L, -1), luv_close_cb);
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return;
+  }
+  lua_pushnil(L);
+  lua_insert(L, -2);
+  luv_call_callback(L, (luv_handle_t*)s->handle->data, LUV_CONNECTION, 2);
+}
+
+// Passes one chunk or frame on to Lua, through the batch when enabled.
+// Frames are never queued by uv.batch_callbacks, the callback has to run
+// before the next frame so that stopping the stream keeps the rest.
+static void luv_stream_emit(lua_State* L, luv_stream_t* s, const char* base, size_t len) {
+  if (s->batch_mode && luv_stream_batch_append(s, base, len) == 0) return;
+  lua_pushnil(L);
+  lua_pushlstring(L, base, len);
+  if (s->frame.type != LUV_FRAME_NONE)
+    luv_call_callback_now(L, (luv_handle_t*)s->handle->data, LUV_READ, 2);
+  else
+    luv_call_callback(L, (luv_handle_t*)s->handle->data, LUV_READ, 2);
+}
+
+// Whether Lua is reading from the stream.  Tracked in the luv_handle_t so
+// that it is right for streams that started reading before they had a
+// luv_stream_t.
+static int luv_stream_reading(luv_stream_t* s) {
+  return ((luv_handle_t*)s->handle->data)->reading;
+}
+
+static int luv_stream_active(luv_stream_t* s) {
+  return luv_stream_reading(s) && !uv_is_closing((uv_handle_t*)s->handle);
+}
+
+// Emits every whole frame at the start of base and returns the number of
+// bytes consumed, or UV_EMSGSIZE.  Stops early when the callback stops the
+// stream, the rest is then kept until reading resumes.  The framing may be
+// changed from within the callback and applies to the next frame.
+static ssize_t luv_stream_parse_frames(lua_State* L, luv_stream_t* s, const char* base, size_t len, size_t scanned) {
+  size_t pos = 0;
+  size_t head, size, tail;
+  int ret;
+  while (pos < len && luv_stream_active(s)) {
+    if (s->frame.type == LUV_FRAME_NONE) {
+      luv_stream_emit(L, s, base + pos, len - pos);
+      return len;
+    }
+    ret = luv_frame_next(&s->frame, base + pos, len - pos, scanned, &head, &size, &tail);
+    if (ret < 0) return ret;
+    if (ret == 0) {
+      s->frame_scanned = 0;
+      if (s->frame.type == LUV_FRAME_DELIMITER && len - pos >= s->frame.delimiter_len)
+        s->frame_scanned = len - pos - s->frame.delimiter_len + 1;
+      return pos;
+    }
+    scanned = 0;
+    luv_stream_emit(L, s, base + pos + head, size);
+    pos += head + size + tail;
+  }
+  s->frame_scanned = 0;
+  return pos;
+}
+
+static int luv_stream_frame_reserve(luv_stream_t* s, size_t len) {
+  size_t cap;
+  char* p;
+  if (s->frame_len + len <= s->frame_cap) return 0;
+  cap = s->frame_cap ? s->frame_cap * 2 : len;
+  while (cap < s->frame_len + len) cap *= 2;
+  p = (char*)realloc(s->frame_base, cap);
+  if (!p) return UV_ENOMEM;
+  s->frame_base = p;
+  s->frame_cap = cap;
+  return 0;
+}
+
+// Runs the buffered partial frame data through the framing again
+static int luv_stream_drain_frames(lua_State* L, luv_stream_t* s) {
+  ssize_t used = luv_stream_parse_frames(L, s, s->frame_base, s->frame_len, s->frame_scanned);
+  if (used < 0) return used;
+  s->frame_len -= used;
+  memmove(s->frame_base, s->frame_base + used, s->frame_len);
+  if (s->frame_len == 0 && s->frame_cap > LUV_BATCH_KEEP_SIZE) {
+    free(s->frame_base);
+    s->frame_base = NULL;
+    s->frame_cap = 0;
+  }
+  return 0;
+}
+
+// Feeds a chunk read from the stream into its framing.  Chunks are parsed
+// in place when nothing is buffered, only leftovers get copied.
+static int luv_stream_frame_input(lua_State* L, luv_stream_t* s, const char* base, size_t len) {
+  ssize_t used;
+  int ret;
+  if (s->frame_len == 0) {
+    used = luv_stream_parse_frames(L, s, base, len, 0);
+    if (used < 0) return used;
+    base += used;
+    len -= used;
+    if (len == 0) return 0;
+    ret = luv_stream_frame_reserve(s, len);
+    if (ret < 0) return ret;
+    memcpy(s->frame_base, base, len);
+    s->frame_len = len;
+    return 0;
+  }
+  ret = luv_stream_frame_reserve(s, len);
+  if (ret < 0) return ret;
+  memcpy(s->frame_base + s->frame_len, base, len);
+  s->frame_len += len;
+  return luv_stream_drain_frames(L, s);
+}
+
+// An oversized frame or failing to buffer one leaves the framing out of
+// sync, so reading stops and the partial frame is dropped once the error
+// has been reported after any frames already batched.
+static void luv_stream_frame_error(lua_State* L, luv_stream_t* s, int status) {
+  uv_read_stop(s->handle);
+  ((luv_handle_t*)s->handle->data)->reading = 0;
+  s->frame_len = 0;
+  s->frame_scanned = 0;
+  if (s->batch_count) {
+    luv_stream_deliver_batch(L, s);
+  }
+  luv_status(L, status);
+  luv_call_callback(L, (luv_handle_t*)s->handle->data, LUV_READ, 1);
+}
+
+// Bytes written to the stream that have not reached the OS yet
+static size_t luv_stream_write_pending(luv_stream_t* s) {
+  return s->handle->write_queue_size + s->cork_bytes;
+}
+
+// Returns 0 once the stream is over its high watermark, 1 otherwise
+static int luv_stream_check_full(luv_stream_t* s) {
+  if (s->write_high && luv_stream_write_pending(s) > s->write_high)
+    s->write_full = 1;
+  return !s->write_full;
+}
+
+// Runs the drain callback when a full stream got back to its low watermark
+static void luv_stream_check_drain(uv_stream_t* handle) {
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_stream_t* s = (luv_stream_t*)data->extra;
+  lua_State* L = data->ctx->L;
+  if (!s || !s->write_full || uv_is_closing((uv_handle_t*)handle)) return;
+  if (luv_stream_write_pending(s) > s->write_low) return;
+  s->write_full = 0;
+  if (s->drain_ref == LUA_NOREF) return;
+  lua_rawgeti(L, LUA_REGISTRYINDEX, s->drain_ref);
+  data->ctx->cb_pcall(L, 0, 0, 0);
+}
+
+static void luv_stream_sweep_cb(uv_timer_t* handle);
+
+// Makes sure the loop's sweep runs no later than due.  The sweep timer is
+// unreferenced, the streams it watches decide whether the loop stays alive.
+static int luv_stream_sweep_at(luv_ctx_private_t* priv, uint64_t due) {
+  uint64_t now = uv_now(priv->ctx.loop);
+  if (!priv->sweep) {
+    int ret;
+    luv_stream_sweep_t* sweep = (luv_stream_sweep_t*)malloc(sizeof(*sweep));
+    if (!sweep) return UV_ENOMEM;
+    ret = uv_timer_init(priv->ctx.loop, &sweep->handle);
+    if (ret < 0) {
+      free(sweep);
+      return ret;
+    }
+    sweep->handle.data = NULL;
+    sweep->priv = priv;
+    uv_unref((uv_handle_t*)&sweep->handle);
+    priv->sweep = &sweep->handle;
+  }
+  if (uv_is_active((uv_handle_t*)priv->sweep) && priv->sweep_due <= due) return 0;
+  priv->sweep_due = due;
+  return uv_timer_start(priv->sweep, luv_stream_sweep_cb, due > now ? due - now : 0, 0);
+}
+
+// Starts a new write stall period, called when a write completes and when
+// one is queued on a stream that had nothing to write
+static void luv_stream_write_progress(luv_stream_t* s) {
+  s->last_write = uv_now(s->ctx->loop);
+  s->last_queue = s->handle->write_queue_size;
+  if (s->last_queue)
+    luv_stream_sweep_at(luv_ctx_private(s->ctx), s->last_write + s->write_stall);
+}
+
+// Returns the LUV_STREAM_* deadlines of the stream that passed.  Bytes
+// leaving the write queue count as progress even before the write they
+// belong to completes.
+static int luv_stream_timeout_check(luv_stream_t* s, uint64_t now) {
+  int fired = 0;
+  if (s->read_idle && luv_stream_reading(s) && now - s->last_read >= s->read_idle) {
+    s->last_read = now;
+    fired |= LUV_STREAM_READ_IDLE;
+  }
+  if (s->write_stall && s->handle->write_queue_size) {
+    // Queued by a write that didn't start a stall period of its own
+    if (!s->last_queue || s->handle->write_queue_size < s->last_queue) {
+      luv_stream_write_progress(s);
+    }
+    else if (now - s->last_write >= s->write_stall) {
+      s->last_write = now;
+      fired |= LUV_STREAM_WRITE_STALL;
+    }
+  }
+  return fired;
+}
+
+// Reports one passed deadline, to the timeout callback if there is one.
+// Otherwise the stream is closed.
+static void luv_stream_timeout_fire(lua_State* L, luv_stream_t* s, int kind) {
+  uv_handle_t* handle = (uv_handle_t*)s->handle;
+  if (uv_is_closing(handle)) return;
+  if (s->timeout_ref == LUA_NOREF) {
+    luv_stream_closing(handle);
+    uv_close(handle, luv_close_cb);
+    return;
+  }
+  lua_rawgeti(L, LUA_REGISTRYINDEX, s->timeout_ref);
+  lua_pushstring(L, kind == LUV_STREAM_READ_IDLE ? "read_idle" : "write_stall");
+  s->ctx->cb_pcall(L, 1, 0, 0);
+}
+
+// Checks the deadlines of every stream that has some, then reports the ones
+// that passed.  Streams are only freed by close callbacks, so the fired ones
+// can't go away before they are reported.  The next sweep is started for the
+// earliest deadline, but no sooner than an eighth of the shortest timeout so
+// that a busy loop sweeps a bounded number of times.
+static void luv_stream_sweep_cb(uv_timer_t* handle) {
+  luv_ctx_private_t* priv = ((luv_stream_sweep_t*)handle)->priv;
+  lua_State* L = priv->ctx.L;
+  uint64_t now = uv_now(priv->ctx.loop);
+  uint64_t next = UINT64_MAX;
+  uint64_t shortest = UINT64_MAX;
+  luv_stream_t* fired = NULL;
+  luv_stream_t** tail = &fired;
+  luv_stream_t* s;
+
+  for (s = priv->timeout_streams; s; s = s->timeout_next) {
+    int kind = luv_stream_timeout_check(s, now);
+    if (kind && !s->timeout_fired) {
+      *tail = s;
+      tail = &s->timeout_fired_next;
+    }
+    s->timeout_fired |= kind;
+    if (s->read_idle) {
+      if (luv_stream_reading(s) && s->last_read + s->read_idle < next)
+        next = s->last_read + s->read_idle;
+      if (s->read_idle < shortest) shortest = s->read_idle;
+    }
+    if (s->write_stall) {
+      if (s->handle->write_queue_size && s->last_write + s->write_stall < next)
+        next = s->last_write + s->write_stall;
+      if (s->write_stall < shortest) shortest = s->write_stall;
+    }
+  }
+  *tail = NULL;
+
+  if (next != UINT64_MAX) {
+    if (next < now + shortest / 8) next = now + shortest / 8;
+    luv_stream_sweep_at(priv, next);
+  }
+
+  while ((s = fired)) {
+    int kind;
+    fired = s->timeout_fired_next;
+    s->timeout_fired_next = NULL;
+    // Each one is checked again, the callbacks before may have changed them
+    for (kind = LUV_STREAM_READ_IDLE; kind <= LUV_STREAM_WRITE_STALL; kind <<= 1) {
+      if (!(s->timeout_fired & kind)) continue;
+      s->timeout_fired &= ~kind;
+      luv_stream_timeout_fire(L, s, kind);
+    }
+  }
+}
+
+static void luv_write_done(uv_write_t* req, int status) {
+  luv_req_t* data = (luv_req_t*)req->data;
+  lua_State* L = data->ctx->L;
+  luv_status(L, status);
+  luv_fulfill_req(L, (luv_req_t*)req->data, 1);
+  luv_cleanup_req(L, (luv_req_t*)req->data);
+  req->data = NULL;
+}
+
+// Called once writes to the stream completed
+static void luv_stream_written(uv_stream_t* handle) {
+  luv_stream_t* s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  if (s && s->write_stall) luv_stream_write_progress(s);
+  if (s && s->sendfile) luv_sendfile_poll_resume(s);
+  luv_stream_check_drain(handle);
+}
+
+static void luv_write_cb(uv_write_t* req, int status) {
+  uv_stream_t* handle = req->handle;
+  luv_write_done(req, status);
+  luv_stream_written(handle);
+}
+
+// Completes every write carried by a corked write, in the order they were
+// made, and frees it.
+static void luv_cork_write_done(luv_cork_write_t* cw, int status) {
+  size_t i;
+  for (i = 0; i < cw->count; i++) {
+    luv_write_done(cw->reqs[i], status);
+  }
+  free(cw);
+}
+
+static void luv_cork_write_cb(uv_write_t* req, int status) {
+  uv_stream_t* handle = ((luv_cork_write_t*)req)->handle;
+  luv_cork_write_done((luv_cork_write_t*)req, status);
+  luv_stream_written(handle);
+}
+
+// Completes the corked writes libuv refused, called from the tick hook
+static void luv_stream_complete_failed(luv_stream_t* s) {
+  luv_cork_write_t* cw;
+  while ((cw = s->cork_failed)) {
+    s->cork_failed = cw->next;
+    luv_cork_write_done(cw, cw->status);
+  }
+  luv_stream_written(s->handle);
+}
+
+// Holds a write until the stream is uncorked or, in auto mode, until the
+// end of the loop iteration.  The buffers stay valid through the refs the
+// request keeps on the written strings.
+static int luv_stream_cork_write(luv_stream_t* s, uv_write_t* req, const uv_buf_t* bufs, size_t count) {
+  size_t i;
+  int ret;
+  // Like uv_write once the stream is closed
+  if (uv_is_closing((uv_handle_t*)s->handle)) return UV_EBADF;
+  if (s->cork_count == s->cork_reqs_cap) {
+    size_t cap = s->cork_reqs_cap ? s->cork_reqs_cap * 2 : 8;
+    uv_write_t** p = (uv_write_t**)realloc(s->cork_reqs, cap * sizeof(*p));
+    if (!p) return UV_ENOMEM;
+    s->cork_reqs = p;
+    s->cork_reqs_cap = cap;
+  }
+  if (s->cork_nbufs + count > s->cork_bufs_cap) {
+    size_t cap = s->cork_bufs_cap ? s->cork_bufs_cap * 2 : 16;
+    uv_buf_t* p;
+    while (cap < s->cork_nbufs + count) cap *= 2;
+    p = (uv_buf_t*)realloc(s->cork_bufs, cap * sizeof(*p));
+    if (!p) return UV_ENOMEM;
+    s->cork_bufs = p;
+    s->cork_bufs_cap = cap;
+  }
+  if (s->cork_mode == LUV_CORK_AUTO) {
+    ret = luv_stream_queue_tick(s);
+    if (ret < 0) return ret;
+  }
+  memcpy(s->cork_bufs + s->cork_nbufs, bufs, count * sizeof(*bufs));
+  s->cork_nbufs += count;
+  for (i = 0; i < count; i++) s->cork_bytes += bufs[i].len;
+  s->cork_reqs[s->cork_count++] = req;
+  return 0;
+}
+
+// Issues all held writes as a single vectored uv_write.  If libuv refuses
+// it the held writes complete with the error at the end of the iteration.
+static int luv_stream_flush_writes(luv_stream_t* s) {
+  luv_cork_write_t* cw;
+  luv_cork_write_t** link;
+  size_t count = s->cork_count;
+  size_t queued = s->handle->write_queue_size;
+  int ret;
+  if (count == 0) return 0;
+  // Held until the file being sent is out
+  if (s->sendfile && !s->sendfile->status) return 0;
+  cw = (luv_cork_write_t*)malloc(sizeof(*cw) + (count - 1) * sizeof(uv_write_t*));
+  if (!cw) return UV_ENOMEM;
+  cw->handle = s->handle;
+  cw->status = 0;
+  cw->next = NULL;
+  cw->count = count;
+  memcpy(cw->reqs, s->cork_reqs, count * sizeof(uv_write_t*));
+  ret = uv_write(&cw->req, s->handle, s->cork_bufs, s->cork_nbufs, luv_cork_write_cb);
+  s->cork_count = 0;
+  s->cork_nbufs = 0;
+  s->cork_bytes = 0;
+  if (ret < 0) {
+    // Kept in order behind earlier failures; if the tick can't be scheduled
+    // they are completed when the stream is freed
+    cw->status = ret;
+    for (link = &s->cork_failed; *link; link = &(*link)->next);
+    *link = cw;
+    luv_stream_queue_tick(s);
+  }
+  else if (s->write_stall && !queued) {
+    luv_stream_write_progress(s);
+  }
+  return ret;
+}
+
+// Issues any writes held by cork on a stream handle.  Used before
+// operations that must be ordered after them, like shutdown and close.
+static int luv_stream_flush_corked(uv_handle_t* handle) {
+  luv_stream_t* s;
+  if (handle->type != UV_TCP && handle->type != UV_NAMED_PIPE && handle->type != UV_TTY)
+    return 0;
+  s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  if (!s || !s->cork_count) return 0;
+  return luv_stream_flush_writes(s);
+}
+
+// Ends the relay once its last write and the shutdown of dst are done and
+// reports how it went to the completion callback.
+static void luv_splice_check_done(luv_splice_t* sp) {
+  luv_ctx_t* ctx = sp->ctx;
+  lua_State* L = ctx->L;
+  luv_stream_t* s;
+  int cb_ref;
+  if (sp->pending || sp->shutting || !sp->src) return;
+  if (!sp->status && !sp->eof) return;
+  s = (luv_stream_t*)((luv_handle_t*)sp->src->data)->extra;
+  s->splice = NULL;
+  if (!uv_is_closing((uv_handle_t*)sp->src)) uv_read_stop(sp->src);
+  if (sp->dst) {
+    s = (luv_stream_t*)((luv_handle_t*)sp->dst->data)->extra;
+    s->splice_in = NULL;
+  }
+  sp->src = NULL;
+  sp->dst = NULL;
+  cb_ref = sp->cb_ref;
+  sp->cb_ref = LUA_NOREF;
+  if (cb_ref == LUA_NOREF) {
+    luv_splice_release(sp);
+    return;
+  }
+  lua_rawgeti(L, LUA_REGISTRYINDEX, cb_ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, cb_ref);
+  luv_status(L, sp->status);
+  lua_pushinteger(L, (lua_Integer)sp->bytes);
+  luv_splice_release(sp);
+  ctx->cb_pcall(L, 2, 0, 0);
+}
+
+// Records the error that ends the relay and stops reading from src
+static void luv_splice_fail(luv_splice_t* sp, int status) {
+  if (!sp->status) sp->status = status;
+  if (sp->src && !uv_is_closing((uv_handle_t*)sp->src)) uv_read_stop(sp->src);
+}
+
+static void luv_splice_shutdown_cb(uv_shutdown_t* req, int status) {
+  luv_splice_t* sp = (luv_splice_t*)req->data;
+  sp->shutting = 0;
+  if (!sp->src) {
+    luv_splice_release(sp);
+    return;
+  }
+  if (status < 0) luv_splice_fail(sp, status);
+  luv_splice_check_done(sp);
+}
+
+static void luv_splice_read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf);
+
+static void luv_splice_write_cb(uv_write_t* req, int status) {
+  luv_splice_write_t* w = (luv_splice_write_t*)req;
+  luv_splice_t* sp = w->splice;
+  luv_buf_pool_put(&luv_ctx_private(sp->ctx)->read_pool, w->base, w->size);
+  if (status == 0) sp->bytes += w->len;
+  free(w);
+  sp->pending--;
+  if (!sp->src) {
+    luv_splice_release(sp);
+    return;
+  }
+  if (status < 0) {
+    luv_splice_fail(sp, status);
+  }
+  else if (sp->paused && !sp->status && sp->dst->write_queue_size <= sp->low) {
+    int ret = uv_read_start(sp->src, luv_alloc_cb, luv_splice_read_cb);
+    if (ret < 0) luv_splice_fail(sp, ret);
+    sp->paused = 0;
+  }
+  // Watermarks and timeouts set on dst by Lua still see the relay's writes
+  if (sp->dst) luv_stream_written(sp->dst);
+  luv_splice_check_done(sp);
+}
+
+// Writes every chunk read from src to dst without handing it to Lua
+static void luv_splice_read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_splice_t* sp = ((luv_stream_t*)data->extra)->splice;
+  luv_buf_pool_t* pool = &luv_ctx_private(data->ctx)->read_pool;
+  luv_splice_write_t* w;
+  uv_buf_t out;
+  int ret;
+  if (!sp->dst) luv_splice_fail(sp, UV_ECANCELED);
+  if (nread > 0 && !sp->status) {
+    w = (luv_splice_write_t*)malloc(sizeof(*w));
+    if (!w) {
+      luv_buf_pool_put(pool, buf->base, buf->len);
+      luv_splice_fail(sp, UV_ENOMEM);
+      luv_splice_check_done(sp);
+      return;
+    }
+    w->splice = sp;
+    w->base = buf->base;
+    w->size = buf->len;
+    w->len = (size_t)nread;
+    out = uv_buf_init(buf->base, (unsigned int)nread);
+    luv_stream_flush_corked((uv_handle_t*)sp->dst);
+    ret = uv_write(&w->req, sp->dst, &out, 1, luv_splice_write_cb);
+    if (ret < 0) {
+      free(w);
+      luv_buf_pool_put(pool, buf->base, buf->len);
+      luv_splice_fail(sp, ret);
+      luv_splice_check_done(sp);
+      return;
+    }
+    sp->pending++;
+    if (sp->dst->write_queue_size > sp->high) {
+      uv_read_stop(handle);
+      sp->paused = 1;
+    }
+    return;
+  }
+  luv_buf_pool_put(pool, buf->base, buf->len);
+  if (nread == 0) return;
+  if (nread == UV_EOF) {
+    uv_read_stop(handle);
+    sp->eof = 1;
+    if (sp->shutdown) {
+      luv_stream_flush_corked((uv_handle_t*)sp->dst);
+      ret = uv_shutdown(&sp->shutdown_req, sp->dst, luv_splice_shutdown_cb);
+      if (ret < 0) luv_splice_fail(sp, ret);
+      else sp->shutting = 1;
+    }
+  }
+  else if (nread < 0) {
+    luv_splice_fail(sp, nread);
+  }
+  luv_splice_check_done(sp);
+}
+
+// Ends the transfer, issues the writes held meanwhile and reports how it
+// went to the callback.
+static void luv_sendfile_finish(luv_sendfile_t* sf) {
+  luv_ctx_t* ctx = sf->ctx;
+  lua_State* L = ctx->L;
+  luv_stream_t* s = (luv_stream_t*)((luv_handle_t*)sf->handle->data)->extra;
+  int cb_ref = sf->cb_ref;
+  luv_sendfile_poll_close(sf);
+  s->sendfile = NULL;
+  if (s->cork_count && s->cork_mode != LUV_CORK_MANUAL)
+    luv_stream_flush_writes(s);
+  if (cb_ref == LUA_NOREF) {
+    free(sf);
+    return;
+  }
+  lua_rawgeti(L, LUA_REGISTRYINDEX, cb_ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, cb_ref);
+  luv_status(L, sf->status);
+  lua_pushinteger(L, (lua_Integer)sf->sent);
+  free(sf);
+  ctx->cb_pcall(L, 2, 0, 0);
+}
+
+static int luv_sendfile_read(luv_sendfile_t* sf);
+
+static void luv_sendfile_write_cb(uv_write_t* req, int status) {
+  luv_sendfile_t* sf = (luv_sendfile_t*)req->data;
+  luv_buf_pool_put(&luv_ctx_private(sf->ctx)->read_pool, sf->base, sf->size);
+  sf->base = NULL;
+  sf->busy = 0;
+  if (!sf->handle) {
+    luv_sendfile_detach(sf);
+    return;
+  }
+  if (status < 0) {
+    if (!sf->status) sf->status = status;
+  }
+  else {
+    sf->offset += sf->len;
+    sf->sent += sf->len;
+    sf->remaining -= sf->len;
+  }
+  luv_stream_written(sf->handle);
+  if (!sf->status && sf->remaining) {
+    sf->status = luv_sendfile_read(sf);
+    if (sf->status == 0) return;
+  }
+  luv_sendfile_finish(sf);
+}
+
+static void luv_sendfile_read_cb(uv_fs_t* req) {
+  luv_sendfile_t* sf = (luv_sendfile_t*)req->data;
+  ssize_t nread = req->result;
+  uv_buf_t buf;
+  int ret;
+  uv_fs_req_cleanup(req);
+  sf->busy = 0;
+  if (!sf->handle) {
+    luv_buf_pool_put(&luv_ctx_private(sf->ctx)->read_pool, sf->base, sf->size);
+    sf->base = NULL;
+    luv_sendfile_detach(sf);
+    return;
+  }
+  if (nread < 0 && !sf->status) sf->status = nread;
+  // A file shorter than requested ends the transfer early
+  if (nread == 0) sf->remaining = 0;
+  if (sf->status || nread == 0) {
+    luv_buf_pool_put(&luv_ctx_private(sf->ctx)->read_pool, sf->base, sf->size);
+    sf->base = NULL;
+    luv_sendfile_finish(sf);
+    return;
+  }
+  sf->len = (size_t)nread;
+  buf = uv_buf_init(sf->base, (unsigned int)nread);
+  sf->write_req.data = sf;
+  ret = uv_write(&sf->write_req, sf->handle, &buf, 1, luv_sendfile_write_cb);
+  if (ret < 0) {
+    luv_buf_pool_put(&luv_ctx_private(sf->ctx)->read_pool, sf->base, sf->size);
+    sf->base = NULL;
+    sf->status = ret;
+    luv_sendfile_finish(sf);
+    return;
+  }
+  sf->busy = 1;
+}
+
+// Reads the next chunk of the file into a pooled buffer
+static int luv_sendfile_read(luv_sendfile_t* sf) {
+  luv_buf_pool_t* pool = &luv_ctx_private(sf->ctx)->read_pool;
+  uv_buf_t buf;
+  int ret;
+  sf->base = luv_buf_pool_get(pool);
+  if (!sf->base) return UV_ENOMEM;
+  sf->size = pool->size;
+  buf = uv_buf_init(sf->base, (unsigned int)(sf->remaining < sf->size ? sf->remaining : sf->size));
+  sf->fs_req.data = sf;
+  ret = uv_fs_read(sf->ctx->loop, &sf->fs_req, sf->fd, &buf, 1, sf->offset, luv_sendfile_read_cb);
+  if (ret < 0) {
+    luv_buf_pool_put(pool, sf->base, sf->size);
+    sf->base = NULL;
+    return ret;
+  }
+  sf->busy = 1;
+  return 0;
+}
+
+#ifdef __linux__
+static void luv_sendfile_poll_cb(uv_poll_t* handle, int status, int events) {
+  luv_sendfile_poll_t* p = (luv_sendfile_poll_t*)handle;
+  luv_sendfile_t* sf = p->sf;
+  off_t offset = (off_t)sf->offset;
+  ssize_t n;
+  (void)events;
+  if (status < 0) {
+    sf->status = status;
+    luv_sendfile_finish(sf);
+    return;
+  }
+  // What libuv still has queued for the stream goes out first, the poll
+  // is restarted by luv_sendfile_poll_resume
+  if (sf->handle->write_queue_size) {
+    uv_poll_stop(handle);
+    return;
+  }
+  if (sf->remaining == 0) {
+    luv_sendfile_finish(sf);
+    return;
+  }
+  n = sendfile(p->fd, sf->fd, &offset, sf->remaining < LUV_SENDFILE_MAX ? sf->remaining : LUV_SENDFILE_MAX);
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EINTR) return;
+    if (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP) {
+      // The fd can't be sent from the page cache, copy it instead
+      luv_sendfile_poll_close(sf);
+      sf->status = luv_sendfile_read(sf);
+      if (sf->status < 0) luv_sendfile_finish(sf);
+      return;
+    }
+    sf->status = uv_translate_sys_error(errno);
+    luv_sendfile_finish(sf);
+    return;
+  }
+  if (n == 0) sf->remaining = 0;
+  sf->offset += n;
+  sf->sent += n;
+  sf->remaining -= n;
+  if (sf->remaining == 0) luv_sendfile_finish(sf);
+}
+
+static int luv_sendfile_poll_start(luv_sendfile_t* sf) {
+  luv_sendfile_poll_t* p;
+  uv_os_fd_t fd;
+  int ret = uv_fileno((uv_handle_t*)sf->handle, &fd);
+  if (ret < 0) return ret;
+  p = (luv_sendfile_poll_t*)malloc(sizeof(*p));
+  if (!p) return UV_ENOMEM;
+  p->fd = dup(fd);
+  if (p->fd < 0) {
+    ret = uv_translate_sys_error(errno);
+    free(p);
+    return ret;
+  }
+  ret = uv_poll_init(sf->ctx->loop, &p->handle, p->fd);
+  if (ret < 0) {
+    close(p->fd);
+    free(p);
+    return ret;
+  }
+  p->handle.data = NULL;
+  p->sf = sf;
+  luv_internal_add(sf->ctx, &p->internal, (uv_handle_t*)&p->handle, luv_sendfile_poll_teardown);
+  sf->poll = p;
+  ret = uv_poll_start(&p->handle, UV_WRITABLE, luv_sendfile_poll_cb);
+  if (ret < 0) luv_sendfile_poll_close(sf);
+  return ret;
+}
+#endif
+
+// Closing either end of a relay cancels it.  The completion callback runs
+// from the tick hook rather than from within uv.close().
+static void luv_splice_cancel(luv_splice_t* sp) {
+  luv_splice_fail(sp, UV_ECANCELED);
+  luv_stream_queue_tick((luv_stream_t*)((luv_handle_t*)sp->src->data)->extra);
+}
+
+static void luv_stream_closing(uv_handle_t* handle) {
+  luv_stream_t* s;
+  if (handle->type != UV_TCP && handle->type != UV_NAMED_PIPE && handle->type != UV_TTY)
+    return;
+  s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  if (!s) return;
+  luv_stream_timeout_unlink(s);
+  // A file being sent is cancelled first so the writes held behind it are
+  // issued and cancelled by libuv with the rest
+  if (s->sendfile && !s->sendfile->status) {
+    s->sendfile->status = UV_ECANCELED;
+    luv_sendfile_poll_close(s->sendfile);
+    if (!s->sendfile->busy) luv_stream_queue_tick(s);
+  }
+  luv_stream_flush_writes(s);
+  if (s->splice) luv_splice_cancel(s->splice);
+  if (s->splice_in) luv_splice_cancel(s->splice_in);
+}
+
+// Called from the loop's tick hook once polling for this iteration is done.
+// Streams that stopped reading keep their data until reading resumes.
+// Writes made by the read callbacks are coalesced with the others.
+static void luv_stream_flush_tick(luv_ctx_t* ctx) {
+  luv_ctx_private_t* priv = luv_ctx_private(ctx);
+  lua_State* L = ctx->L;
+  luv_stream_t* s;
+  while ((s = priv->tick_streams)) {
+    priv->tick_streams = s->tick_next;
+    s->tick_next = NULL;
+    s->tick_queued = 0;
+    if (luv_stream_active(s) && s->frame_len) {
+      int ret = luv_stream_drain_frames(L, s);
+      if (ret < 0) {
+        luv_stream_frame_error(L, s, ret);
+      }
+    }
+    if (luv_stream_active(s) && s->batch_count) {
+      luv_stream_deliver_batch(L, s);
+    }
+    if (s->cork_mode == LUV_CORK_AUTO && s->cork_count) {
+      luv_stream_flush_writes(s);
+    }
+    if (s->cork_failed) {
+      luv_stream_complete_failed(s);
+    }
+    if (s->splice) {
+      luv_splice_check_done(s->splice);
+    }
+    if (s->sendfile && s->sendfile->status && !s->sendfile->busy) {
+      luv_sendfile_finish(s->sendfile);
+    }
+    if (s->accept_count) {
+      luv_stream_deliver_accepts(L, s);
+    }
+  }
 }
 
 static void luv_read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
   luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_stream_t* s = (luv_stream_t*)data->extra;
   lua_State* L = data->ctx->L;
   int nargs;
 
-  if (nread > 0) {
-    lua_pushnil(L);
-    lua_pushlstring(L, buf->base, nread);
-    nargs = 2;
+  if (s && s->read_idle && nread > 0) s->last_read = uv_now(data->ctx->loop);
+  if (s && s->read_buf && buf->base == s->read_buf->base + s->read_offset) {
+    // The data is already in the caller's buffer, only pass a view of it
+    if (nread > 0) {
+      lua_pushnil(L);
+      lua_rawgeti(L, LUA_REGISTRYINDEX, s->read_buf_ref);
+      lua_pushinteger(L, s->read_offset);
+      lua_pushinteger(L, nread);
+      nargs = 4;
+    }
+  }
+  else if (nread > 0 && s && (s->frame.type != LUV_FRAME_NONE || s->frame_len)) {
+    int ret = luv_stream_frame_input(L, s, buf->base, nread);
+    luv_buf_pool_put(&luv_ctx_private(data->ctx)->read_pool, buf->base, buf->len);
+    if (ret < 0) {
+      luv_stream_frame_error(L, s, ret);
+    }
+    return;
+  }
+  else {
+    if (nread > 0 && s && s->batch_mode) {
+      // Delivered from the tick hook, or right away if it can't be batched
+      nread = luv_stream_batch_append(s, buf->base, nread);
+    }
+    else if (nread > 0) {
+      lua_pushnil(L);
+      lua_pushlstring(L, buf->base, nread);
+      nargs = 2;
+    }
+    luv_buf_pool_put(&luv_ctx_private(data->ctx)->read_pool, buf->base, buf->len);
   }
-
-  free(buf->base);
   if (nread == 0) return;
 
+  if (nread < 0 && s) {
+    // A trailing line without delimiter still counts as a frame, partial
+    // length prefixed or fixed size frames are dropped.
+    if (s->frame_len && nread == UV_EOF &&
+        (s->frame.type == LUV_FRAME_DELIMITER || s->frame.type == LUV_FRAME_NONE)) {
+      luv_stream_emit(L, s, s->frame_base, s->frame_len);
+    }
+    s->frame_len = 0;
+    s->frame_scanned = 0;
+    // Pending batched data goes out before the EOF or error that ends it
+    if (s->batch_count) {
+      luv_stream_deliver_batch(L, s);
+    }
+  }
+
+  // libuv stops reading on EOF and read errors, not when out of buffers
+  if (nread < 0 && nread != UV_ENOBUFS) data->reading = 0;
   if (nread == UV_EOF) {
     nargs = 0;
   }
@@ -128,49 +1412,238 @@ static void luv_read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf)
     nargs = 1;
   }
 
-  luv_call_callback(L, (luv_handle_t*)handle->data, LUV_READ, nargs);
+  if (nargs == 4) {
+    // The next read overwrites the view, so it can't wait in a batch
+    luv_call_callback_now(L, (luv_handle_t*)handle->data, LUV_READ, nargs);
+  }
+  else {
+    luv_call_callback(L, (luv_handle_t*)handle->data, LUV_READ, nargs);
+  }
+}
+
+// Read callback of connections accepted in batches, it passes the
+// connection in front of what was read.
+static int luv_accept_read_cb(lua_State* L) {
+  int nargs = lua_gettop(L);
+  lua_pushvalue(L, lua_upvalueindex(1));
+  lua_insert(L, 1);
+  lua_pushvalue(L, lua_upvalueindex(2));
+  lua_insert(L, 2);
+  lua_call(L, nargs + 1, 0);
+  return 0;
+}
+
+// Accepts one pending connection into a handle created here and queues it
+// for delivery.  Runs protected since creating the handle may raise.
+static int luv_accept_pending(lua_State* L) {
+  uv_stream_t* server = (uv_stream_t*)lua_touserdata(L, 1);
+  luv_handle_t* data = (luv_handle_t*)server->data;
+  luv_stream_t* s = (luv_stream_t*)data->extra;
+  uv_stream_t* client;
+  int ret;
+  lua_settop(L, 0);
+  if (server->type == UV_TCP) {
+    client = (uv_stream_t*)luv_newhandle(L, UV_TCP);
+    ret = uv_tcp_init(data->ctx->loop, (uv_tcp_t*)client);
+  }
+  else {
+    client = (uv_stream_t*)luv_newhandle(L, UV_NAMED_PIPE);
+    ret = uv_pipe_init(data->ctx->loop, (uv_pipe_t*)client, ((uv_pipe_t*)server)->ipc);
+  }
+  if (ret < 0) {
+    lua_pushinteger(L, ret);
+    return 1;
+  }
+  client->data = luv_setup_handle(L, data->ctx);
+  ret = uv_accept(server, client);
+  if (ret == 0 && s->accept_read_ref != LUA_NOREF) {
+    lua_rawgeti(L, LUA_REGISTRYINDEX, s->accept_read_ref);
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, luv_accept_read_cb, 2);
+    luv_check_callback(L, (luv_handle_t*)client->data, LUV_READ, 2);
+    lua_pop(L, 1);
+    ret = uv_read_start(client, luv_stream_alloc_cb, luv_read_cb);
+    if (ret == 0) ((luv_handle_t*)client->data)->reading = 1;
+  }
+  if (ret < 0) {
+    uv_close((uv_handle_t*)client, luv_close_cb);
+    lua_pushinteger(L, ret);
+    return 1;
+  }
+  if (s->accept_list_ref == LUA_NOREF) {
+    lua_createtable(L, (int)s->accept_batch, 0);
+    s->accept_list_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  lua_rawgeti(L, LUA_REGISTRYINDEX, s->accept_list_ref);
+  lua_insert(L, 1);
+  lua_rawseti(L, 1, ++s->accept_count);
+  if (s->accept_count >= s->accept_batch || luv_stream_queue_tick(s) < 0)
+    luv_stream_deliver_accepts(L, s);
+  return 0;
+}
+
+static void luv_connection_batch_cb(uv_stream_t* handle, int status) {
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_stream_t* s = (luv_stream_t*)data->extra;
+  lua_State* L = data->ctx->L;
+  int top = lua_gettop(L);
+  if (status == 0) {
+    lua_pushcfunction(L, luv_accept_pending);
+    lua_pushlightuserdata(L, handle);
+    // Only allocation failures raise
+    if (lua_pcall(L, 1, 1, 0) != 0)
+      status = UV_ENOMEM;
+    else
+      status = (int)lua_tointeger(L, -1);
+    lua_settop(L, top);
+  }
+  if (status < 0) {
+    // Connections accepted before the error are delivered first
+    if (s->accept_count) luv_stream_deliver_accepts(L, s);
+    luv_status(L, status);
+    luv_call_callback(L, data, LUV_CONNECTION, 1);
+  }
+}
+
+// Parses the options table of read_start: the buffer reads land in, how
+// reads are cut into frames and whether they are batched per loop iteration.
+static void luv_check_read_options(lua_State* L, uv_stream_t* handle, int index) {
+  luv_stream_t* s = luv_stream_data(L, handle);
+  luv_buffer_t* buf;
+  lua_Integer offset;
+  const char* batch;
+  int batch_mode = LUV_BATCH_NONE;
+  luv_frame_t frame;
+
+  lua_getfield(L, index, "batch");
+  batch = lua_tostring(L, -1);
+  if (batch && strcmp(batch, "string") == 0) {
+    batch_mode = LUV_BATCH_STRING;
+  }
+  else if (batch && strcmp(batch, "array") == 0) {
+    batch_mode = LUV_BATCH_ARRAY;
+  }
+  else if (!lua_isnil(L, -1)) {
+    luaL_argerror(L, index, "batch option must be \"string\" or \"array\"");
+  }
+  lua_pop(L, 1);
+
+  memset(&frame, 0, sizeof(frame));
+  lua_getfield(L, index, "frame");
+  if (!lua_isnil(L, -1)) {
+    luv_check_frame(L, -1, index, &frame);
+    luaL_argcheck(L, batch_mode != LUV_BATCH_STRING, index, "framed reads can only be batched as \"array\"");
+  }
+  lua_pop(L, 1);
+
+  lua_getfield(L, index, "buffer");
+  buf = (luv_buffer_t*)luaL_testudata(L, -1, "uv_buffer");
+  if (!buf && !lua_isnil(L, -1)) {
+    luaL_argerror(L, index, "buffer option must be a uv_buffer");
+  }
+  luaL_argcheck(L, !buf || (batch_mode == LUV_BATCH_NONE && frame.type == LUV_FRAME_NONE), index,
+    "buffer option can't be combined with batch or frame");
+  lua_getfield(L, index, "offset");
+  offset = luaL_optinteger(L, -1, 0);
+  if (buf) {
+    luaL_argcheck(L, offset >= 0 && (size_t)offset < buf->size, index, "offset option out of range");
+  }
+  lua_pop(L, 1);
+
+  s->batch_mode = batch_mode;
+  s->frame = frame;
+  s->frame_scanned = 0;
+  luaL_unref(L, LUA_REGISTRYINDEX, s->read_buf_ref);
+  s->read_buf_ref = LUA_NOREF;
+  s->read_buf = buf;
+  s->read_offset = 0;
+  if (buf) {
+    // pops the buffer
+    s->read_buf_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    s->read_offset = (size_t)offset;
+  }
+  else {
+    lua_pop(L, 1);
+  }
 }
 
 static int luv_read_start(lua_State* L) {
   uv_stream_t* handle = luv_check_stream(L, 1);
+  luv_handle_t* data = (luv_handle_t*)handle->data;
+  luv_stream_t* s;
+  int cb_index = 2;
   int ret;
-  luv_check_callback(L, (luv_handle_t*)handle->data, LUV_READ, 2);
-  ret = uv_read_start(handle, luv_alloc_cb, luv_read_cb);
+  // Reads of a stream relayed by uv.pipe_streams never reach Lua
+  if (data->extra && ((luv_stream_t*)data->extra)->splice)
+    return luv_error(L, UV_EBUSY);
+  if (lua_type(L, 2) == LUA_TTABLE) {
+    cb_index = 3;
+    luv_check_callable(L, cb_index);
+    luv_check_read_options(L, handle, 2);
+  }
+  else if (data->extra) {
+    // Plain read_start goes back to copying reads into strings
+    s = (luv_stream_t*)data->extra;
+    luaL_unref(L, LUA_REGISTRYINDEX, s->read_buf_ref);
+    s->read_buf_ref = LUA_NOREF;
+    s->read_buf = NULL;
+    s->batch_mode = LUV_BATCH_NONE;
+    s->frame.type = LUV_FRAME_NONE;
+  }
+  luv_check_callback(L, data, LUV_READ, cb_index);
+  ret = uv_read_start(handle, luv_stream_alloc_cb, luv_read_cb);
+  s = (luv_stream_t*)data->extra;
+  // Restarting a stream that is reading only swaps callback and options
+  if (ret == UV_EALREADY && data->reading) ret = 0;
+  if (ret == 0) {
+    if (s && !data->reading && s->read_idle) {
+      s->last_read = uv_now(data->ctx->loop);
+      luv_stream_sweep_at(luv_ctx_private(data->ctx), s->last_read + s->read_idle);
+    }
+    data->reading = 1;
+    // Data held back by read_stop is delivered at the end of this tick
+    if (s && (s->batch_count || s->frame_len)) ret = luv_stream_queue_tick(s);
+  }
   return luv_result(L, ret);
 }
 
 static int luv_read_stop(lua_State* L) {
   uv_stream_t* handle = luv_check_stream(L, 1);
-  int ret = uv_read_stop(handle);
+  luv_stream_t* s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  int ret;
+  if (s && s->splice) return luv_error(L, UV_EBUSY);
+  ret = uv_read_stop(handle);
+  ((luv_handle_t*)handle->data)->reading = 0;
   return luv_result(L, ret);
 }
 
-static void luv_write_cb(uv_write_t* req, int status) {
-  luv_req_t* data = (luv_req_t*)req->data;
-  lua_State* L = data->ctx->L;
-  luv_status(L, status);
-  luv_fulfill_req(L, (luv_req_t*)req->data, 1);
-  luv_cleanup_req(L, (luv_req_t*)req->data);
-  req->data = NULL;
-}
-
 static int luv_write(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   uv_stream_t* handle = luv_check_stream(L, 1);
   uv_write_t* req;
   int ret, ref;
   ref = luv_check_continuation(L, 3);
-  req = (uv_write_t *)lua_newuserdata(L, uv_req_size(UV_WRITE));
+  req = (uv_write_t *)luv_newreq(L, UV_WRITE);
   req->data = (luv_req_t*)luv_setup_req(L, ctx, ref);
   size_t count;
   uv_buf_t* bufs = luv_check_bufs(L, 2, &count, (luv_req_t*)req->data);
-  ret = uv_write(req, handle, bufs, count, luv_write_cb);
+  luv_stream_t* s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  size_t queued = handle->write_queue_size;
+  if (s && (s->cork_mode || s->sendfile))
+    ret = luv_stream_cork_write(s, req, bufs, count);
+  else
+    ret = uv_write(req, handle, bufs, count, luv_write_cb);
   free(bufs);
   if (ret < 0) {
     luv_cleanup_req(L, (luv_req_t*)req->data);
     lua_pop(L, 1);
     return luv_error(L, ret);
   }
+  if (s && s->write_stall && !queued) luv_stream_write_progress(s);
+  if (s && s->write_high) {
+    lua_pushboolean(L, luv_stream_check_full(s));
+    return 2;
+  }
   return 1;
 }
 
@@ -180,12 +1653,16 @@ static int luv_write2(lua_State* L) {
   uv_write_t* req;
   int ret, ref;
   uv_stream_t* send_handle;
+  luv_stream_t* s;
+  size_t queued;
   send_handle = luv_check_stream(L, 3);
   ref = luv_check_continuation(L, 4);
-  req = (uv_write_t *)lua_newuserdata(L, uv_req_size(UV_WRITE));
+  req = (uv_write_t *)luv_newreq(L, UV_WRITE);
   req->data = luv_setup_req(L, ctx, ref);
   size_t count;
   uv_buf_t* bufs = luv_check_bufs(L, 2, &count, (luv_req_t*)req->data);
+  luv_stream_flush_corked((uv_handle_t*)handle);
+  queued = handle->write_queue_size;
   ret = uv_write2(req, handle, bufs, count, send_handle, luv_write_cb);
   free(bufs);
   if (ret < 0) {
@@ -193,6 +1670,12 @@ static int luv_write2(lua_State* L) {
     lua_pop(L, 1);
     return luv_error(L, ret);
   }
+  s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  if (s && s->write_stall && !queued) luv_stream_write_progress(s);
+  if (s && s->write_high) {
+    lua_pushboolean(L, luv_stream_check_full(s));
+    return 2;
+  }
   return 1;
 }
 
@@ -201,6 +1684,7 @@ static int luv_try_write(lua_State* L) {
   int err_or_num_bytes;
   size_t count;
   uv_buf_t* bufs = luv_check_bufs_noref(L, 2, &count);
+  luv_stream_flush_corked((uv_handle_t*)handle);
   err_or_num_bytes = uv_try_write(handle, bufs, count);
   free(bufs);
   if (err_or_num_bytes < 0) return luv_error(L, err_or_num_bytes);
@@ -215,6 +1699,7 @@ static int luv_try_write2(lua_State* L) {
   size_t count;
   uv_stream_t* send_handle = luv_check_stream(L, 3);
   uv_buf_t* bufs = luv_check_bufs_noref(L, 2, &count);
+  luv_stream_flush_corked((uv_handle_t*)handle);
   err_or_num_bytes = uv_try_write2(handle, bufs, count, send_handle);
   free(bufs);
   if (err_or_num_bytes < 0) return luv_error(L, err_or_num_bytes);
@@ -251,3 +1736,233 @@ static int luv_stream_get_write_queue_size(lua_State* L) {
   return 1;
 }
 #endif
+
+static int luv_stream_cork(lua_State* L) {
+  uv_stream_t* handle = luv_check_stream(L, 1);
+  int autoflush = lua_toboolean(L, 2);
+  luv_stream_t* s = luv_stream_data(L, handle);
+  int ret = 0;
+  s->cork_mode = autoflush ? LUV_CORK_AUTO : LUV_CORK_MANUAL;
+  if (autoflush && s->cork_count)
+    ret = luv_stream_queue_tick(s);
+  return luv_result(L, ret);
+}
+
+static int luv_stream_uncork(lua_State* L) {
+  uv_stream_t* handle = luv_check_stream(L, 1);
+  luv_stream_t* s = (luv_stream_t*)((luv_handle_t*)handle->data)->extra;
+  int ret = 0;
+  if (s) {
+    ret = luv_stream_flush_writes(s);
+    // Stay corked if the held writes could not be handed to libuv at all
+    if (ret != UV_ENOMEM)
+      s->cork_mode = LUV_CORK_NONE;
+  }
+  return luv_result(L, ret);
+}
+
+static int luv_stream_set_watermarks(lua_State* L) {
+  uv_stream_t* handle = luv_check_stream(L, 1);
+  lua_Integer high = luaL_checkinteger(L, 2);
+  lua_Integer low = luaL_optinteger(L, 3, 0);
+  luv_stream_t* s;
+  luaL_argcheck(L, high >= 0, 2, "high watermark must be a non-negative integer");
+  luaL_argcheck(L, low >= 0 && low <= high, 3, "low watermark must be between 0 and the high watermark");
+  if (!lua_isnoneornil(L, 4)) luaL_checktype(L, 4, LUA_TFUNCTION);
+  s = luv_stream_data(L, handle);
+  luaL_unref(L, LUA_REGISTRYINDEX, s->drain_ref);
+  s->drain_ref = LUA_NOREF;
+  if (!lua_isnoneornil(L, 4)) {
+    lua_pushvalue(L, 4);
+    s->drain_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  s->write_high = (size_t)high;
+  s->write_low = (size_t)low;
+  s->write_full = 0;
+  luv_stream_check_full(s);
+  lua_pushboolean(L, !s->write_full);
+  return 1;
+}
+
+static int luv_stream_set_timeouts(lua_State* L) {
+  uv_stream_t* handle = luv_check_stream(L, 1);
+  luv_ctx_private_t* priv = luv_ctx_private(((luv_handle_t*)handle->data)->ctx);
+  lua_Integer read_idle, write_stall;
+  luv_stream_t* s;
+  uint64_t now;
+  int ret = 0;
+  luaL_checktype(L, 2, LUA_TTABLE);
+  lua_getfield(L, 2, "read_idle");
+  read_idle = luaL_optinteger(L, -1, 0);
+  lua_getfield(L, 2, "write_stall");
+  write_stall = luaL_optinteger(L, -1, 0);
+  lua_pop(L, 2);
+  luaL_argcheck(L, read_idle >= 0, 2, "read_idle must be a non-negative integer");
+  luaL_argcheck(L, write_stall >= 0, 2, "write_stall must be a non-negative integer");
+  if (!lua_isnoneornil(L, 3)) luv_check_callable(L, 3);
+  s = luv_stream_data(L, handle);
+  luaL_unref(L, LUA_REGISTRYINDEX, s->timeout_ref);
+  s->timeout_ref = LUA_NOREF;
+  s->read_idle = (uint64_t)read_idle;
+  s->write_stall = (uint64_t)write_stall;
+  if (!read_idle && !write_stall) {
+    luv_stream_timeout_unlink(s);
+    return luv_result(L, 0);
+  }
+  if (!lua_isnoneornil(L, 3)) {
+    lua_pushvalue(L, 3);
+    s->timeout_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  if (!s->timeout_linked && !uv_is_closing((uv_handle_t*)handle)) {
+    s->timeout_next = priv->timeout_streams;
+    if (s->timeout_next) s->timeout_next->timeout_prev = s;
+    priv->timeout_streams = s;
+    s->timeout_linked = 1;
+  }
+  // Both periods start over
+  now = uv_now(priv->ctx.loop);
+  s->last_read = now;
+  s->last_write = now;
+  s->last_queue = handle->write_queue_size;
+  if (read_idle && luv_stream_reading(s))
+    ret = luv_stream_sweep_at(priv, now + s->read_idle);
+  if (ret == 0 && write_stall && s->last_queue)
+    ret = luv_stream_sweep_at(priv, now + s->write_stall);
+  return luv_result(L, ret);
+}
+
+static int luv_pipe_streams(lua_State* L) {
+  uv_stream_t* src = luv_check_stream(L, 1);
+  uv_stream_t* dst = luv_check_stream(L, 2);
+  lua_Integer high = LUV_SPLICE_HIGH;
+  lua_Integer low = LUV_SPLICE_HIGH / 2;
+  int shutdown = 0;
+  luv_stream_t* ss;
+  luv_stream_t* ds;
+  luv_splice_t* sp;
+  int ret;
+  luaL_argcheck(L, src != dst, 2, "can't pipe a stream into itself");
+  if (!lua_isnoneornil(L, 3)) {
+    luaL_checktype(L, 3, LUA_TTABLE);
+    lua_getfield(L, 3, "high");
+    high = luaL_optinteger(L, -1, high);
+    lua_getfield(L, 3, "low");
+    low = luaL_optinteger(L, -1, high / 2);
+    lua_getfield(L, 3, "shutdown");
+    shutdown = lua_toboolean(L, -1);
+    lua_pop(L, 3);
+    luaL_argcheck(L, high > 0, 3, "high option must be a positive integer");
+    luaL_argcheck(L, low >= 0 && low <= high, 3, "low option must be between 0 and high");
+  }
+  if (!lua_isnoneornil(L, 4)) luv_check_callable(L, 4);
+  ss = luv_stream_data(L, src);
+  ds = luv_stream_data(L, dst);
+  if (luv_stream_reading(ss) || ss->splice || ds->splice_in)
+    return luv_error(L, UV_EBUSY);
+  sp = (luv_splice_t*)malloc(sizeof(*sp));
+  if (!sp) return luaL_error(L, "Can't allocate luv stream relay");
+  memset(sp, 0, sizeof(*sp));
+  sp->ctx = ss->ctx;
+  sp->src = src;
+  sp->dst = dst;
+  sp->high = (size_t)high;
+  sp->low = (size_t)low;
+  sp->shutdown = shutdown;
+  sp->shutdown_req.data = sp;
+  ret = uv_read_start(src, luv_alloc_cb, luv_splice_read_cb);
+  if (ret < 0) {
+    free(sp);
+    return luv_error(L, ret);
+  }
+  // Both ends stay alive for as long as the relay runs
+  lua_pushvalue(L, 1);
+  sp->src_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  lua_pushvalue(L, 2);
+  sp->dst_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  sp->cb_ref = LUA_NOREF;
+  if (!lua_isnoneornil(L, 4)) {
+    lua_pushvalue(L, 4);
+    sp->cb_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  ss->splice = sp;
+  ds->splice_in = sp;
+  return luv_result(L, 0);
+}
+
+static int luv_stream_send_file(lua_State* L) {
+  uv_stream_t* handle = luv_check_stream(L, 1);
+  uv_file fd = luaL_checkinteger(L, 2);
+  lua_Integer offset = luaL_checkinteger(L, 3);
+  lua_Integer length = luaL_checkinteger(L, 4);
+  luv_stream_t* s;
+  luv_sendfile_t* sf;
+  int ret = UV_ENOTSUP;
+  luaL_argcheck(L, offset >= 0, 3, "offset must be a non-negative integer");
+  luaL_argcheck(L, length >= 0, 4, "length must be a non-negative integer");
+  if (!lua_isnoneornil(L, 5)) luv_check_callable(L, 5);
+  s = luv_stream_data(L, handle);
+  if (s->sendfile) return luv_error(L, UV_EBUSY);
+  sf = (luv_sendfile_t*)malloc(sizeof(*sf));
+  if (!sf) return luaL_error(L, "Can't allocate luv file transfer");
+  memset(sf, 0, sizeof(*sf));
+  sf->ctx = s->ctx;
+  sf->handle = handle;
+  sf->fd = fd;
+  sf->offset = offset;
+  sf->remaining = (uint64_t)length;
+  // Earlier writes go out before the file
+  luv_stream_flush_corked((uv_handle_t*)handle);
+#ifdef __linux__
+  if (handle->type != UV_TTY) ret = luv_sendfile_poll_start(sf);
+#endif
+  // Either way the callback can only run from the loop, never from here
+  if (ret < 0) ret = luv_sendfile_read(sf);
+  if (ret < 0) {
+    free(sf);
+    return luv_error(L, ret);
+  }
+  sf->cb_ref = LUA_NOREF;
+  if (!lua_isnoneornil(L, 5)) {
+    lua_pushvalue(L, 5);
+    sf->cb_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+  s->sendfile = sf;
+  return luv_result(L, 0);
+}
+
+static int luv_buffer_pool_configure(lua_State* L) {
+  luv_buf_pool_t* pool = &luv_ctx_private(luv_context(L))->read_pool;
+  lua_Integer size = luaL_optinteger(L, 1, pool->size);
+  lua_Integer max = luaL_optinteger(L, 2, pool->max);
+  luaL_argcheck(L, size >= LUV_BUF_POOL_MIN_SIZE, 1, "buffer size must be at least 64 bytes");
+  luaL_argcheck(L, max >= 0 && max <= UINT_MAX, 2, "cap must be a non-negative integer");
+  // Cached buffers of the old size class can never be handed out again
+  if ((size_t)size != pool->size || (unsigned int)max < pool->count)
+    luv_buf_pool_drain(pool);
+  pool->size = (size_t)size;
+  pool->max = (unsigned int)max;
+  return luv_result(L, 0);
+}
+
+static int luv_buffer_pool_stats(lua_State* L) {
+  luv_buf_pool_t* pool = &luv_ctx_private(luv_context(L))->read_pool;
+
+  lua_createtable(L, 0, 5);
+
+  lua_pushinteger(L, pool->size);
+  lua_setfield(L, -2, "size");
+
+  lua_pushinteger(L, pool->max);
+  lua_setfield(L, -2, "max");
+
+  lua_pushinteger(L, pool->count);
+  lua_setfield(L, -2, "cached");
+
+  lua_pushinteger(L, pool->hits);
+  lua_setfield(L, -2, "hits");
+
+  lua_pushinteger(L, pool->misses);
+  lua_setfield(L, -2, "misses");
+
+  return 1;
+}
@@ -24,7 +24,7 @@ static uv_timer_t* luv_check_timer(lua_State* L, int index) {
 
 static int luv_new_timer(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
-  uv_timer_t* handle = (uv_timer_t*) luv_newuserdata(L, uv_handle_size(UV_TIMER));
+  uv_timer_t* handle = (uv_timer_t*) luv_newhandle(L, UV_TIMER);
   int ret = uv_timer_init(ctx->loop, handle);
   if (ret < 0) {
     lua_pop(L, 1);
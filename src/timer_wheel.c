@@ -0,0 +1,439 @@
+/*
+ *  Copyright 2014 The Luvit Authors. All Rights Reserved.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "private.h"
+
+// A timer wheel keeps many timers in C and drives them with one uv_timer_t
+// that ticks every tick_ms while any is active.  Timers sit in the buckets of
+// a hierarchical wheel: 256 buckets one tick wide, then three levels of 64
+// buckets each 64 times wider than the level below.  Starting, stopping and
+// restarting a timer is a list operation, and a bucket of a higher level is
+// spread over the levels below when the ticks reach it.  Timers further out
+// than the wheel reaches wait in its last bucket and are placed again when
+// it cascades.
+#define LUV_WHEEL_ROOT_BITS 8
+#define LUV_WHEEL_LEVEL_BITS 6
+#define LUV_WHEEL_ROOT_SIZE (1 << LUV_WHEEL_ROOT_BITS)
+#define LUV_WHEEL_LEVEL_SIZE (1 << LUV_WHEEL_LEVEL_BITS)
+#define LUV_WHEEL_LEVELS 3
+#define LUV_WHEEL_BUCKETS (LUV_WHEEL_ROOT_SIZE + LUV_WHEEL_LEVELS * LUV_WHEEL_LEVEL_SIZE)
+#define LUV_WHEEL_RANGE ((uint64_t)1 << (LUV_WHEEL_ROOT_BITS + LUV_WHEEL_LEVELS * LUV_WHEEL_LEVEL_BITS))
+#define LUV_WHEEL_NONE UINT32_MAX
+#define LUV_WHEEL_MIN 64
+
+// Ids handed to Lua are the entry index plus one in the low bits and the
+// entry's generation above, so an id goes stale once its timer is gone.
+// With 64 bit integers that is 32 bits of index and twenty of generation,
+// which keeps ids exact in a double.  Narrower integers get 20 and 11 bits
+// so that ids stay positive.
+#define LUV_WHEEL_WIDE (sizeof(lua_Integer) >= 8)
+#define LUV_WHEEL_INDEX_BITS (LUV_WHEEL_WIDE ? 32 : 20)
+#define LUV_WHEEL_INDEX_MASK (((uint64_t)1 << LUV_WHEEL_INDEX_BITS) - 1)
+#define LUV_WHEEL_GEN_MASK (LUV_WHEEL_WIDE ? 0xfffff : 0x7ff)
+
+typedef struct {
+  uint64_t expires;  /* tick the timer fires at */
+  uint32_t next;     /* next entry in the bucket, or in the free list */
+  uint32_t prev;
+  uint32_t gen;
+  uint32_t bucket;   /* LUV_WHEEL_NONE when the entry isn't started */
+} luv_wheel_entry_t;
+
+typedef struct luv_timer_wheel_s {
+  uv_timer_t timer;  /* must be first */
+  luv_ctx_t* ctx;
+  struct luv_timer_wheel_s** udata; /* cleared when the wheel is closed */
+  luv_internal_t internal;
+  uint64_t tick_ms;
+  uint64_t start;    /* loop time of tick 0 */
+  uint64_t tick;     /* next tick to process */
+  luv_wheel_entry_t* entries;
+  uint32_t cap;
+  uint32_t count;    /* started timers */
+  uint32_t free;     /* first unused entry */
+  int ref;           /* keeps the userdata alive while timers are started */
+  uint32_t buckets[LUV_WHEEL_BUCKETS];
+} luv_timer_wheel_t;
+
+static luv_timer_wheel_t* luv_check_timer_wheel(lua_State* L, int index) {
+  luv_timer_wheel_t* wheel = *(luv_timer_wheel_t**)luaL_checkudata(L, index, "uv_timer_wheel");
+  luaL_argcheck(L, wheel != NULL, index, "timer wheel is closed");
+  return wheel;
+}
+
+static uint64_t luv_wheel_now(luv_timer_wheel_t* wheel) {
+  return (uv_now(wheel->ctx->loop) - wheel->start) / wheel->tick_ms;
+}
+
+static void luv_wheel_link(luv_timer_wheel_t* wheel, uint32_t index) {
+  luv_wheel_entry_t* e = &wheel->entries[index];
+  uint64_t expires = e->expires;
+  uint64_t delta;
+  uint32_t bucket;
+  // Late timers go in the bucket processed next
+  if (expires < wheel->tick) expires = wheel->tick;
+  delta = expires - wheel->tick;
+  if (delta >= LUV_WHEEL_RANGE) {
+    expires = wheel->tick + LUV_WHEEL_RANGE - 1;
+    delta = LUV_WHEEL_RANGE - 1;
+  }
+  if (delta < LUV_WHEEL_ROOT_SIZE) {
+    bucket = (uint32_t)(expires & (LUV_WHEEL_ROOT_SIZE - 1));
+  }
+  else {
+    int level = 0;
+    int shift = LUV_WHEEL_ROOT_BITS;
+    while (delta >= ((uint64_t)1 << (shift + LUV_WHEEL_LEVEL_BITS))) {
+      level++;
+      shift += LUV_WHEEL_LEVEL_BITS;
+    }
+    bucket = LUV_WHEEL_ROOT_SIZE + level * LUV_WHEEL_LEVEL_SIZE +
+             (uint32_t)((expires >> shift) & (LUV_WHEEL_LEVEL_SIZE - 1));
+  }
+  e->bucket = bucket;
+  e->prev = LUV_WHEEL_NONE;
+  e->next = wheel->buckets[bucket];
+  if (e->next != LUV_WHEEL_NONE)
+    wheel->entries[e->next].prev = index;
+  wheel->buckets[bucket] = index;
+}
+
+static void luv_wheel_unlink(luv_timer_wheel_t* wheel, uint32_t index) {
+  luv_wheel_entry_t* e = &wheel->entries[index];
+  if (e->prev == LUV_WHEEL_NONE)
+    wheel->buckets[e->bucket] = e->next;
+  else
+    wheel->entries[e->prev].next = e->next;
+  if (e->next != LUV_WHEEL_NONE)
+    wheel->entries[e->next].prev = e->prev;
+  e->bucket = LUV_WHEEL_NONE;
+}
+
+// Places the timers of a bucket again, returns the bucket's position in its
+// level so the caller knows whether the level above wrapped as well.
+static uint32_t luv_wheel_cascade(luv_timer_wheel_t* wheel, int level) {
+  int shift = LUV_WHEEL_ROOT_BITS + level * LUV_WHEEL_LEVEL_BITS;
+  uint32_t slot = (uint32_t)((wheel->tick >> shift) & (LUV_WHEEL_LEVEL_SIZE - 1));
+  uint32_t bucket = LUV_WHEEL_ROOT_SIZE + level * LUV_WHEEL_LEVEL_SIZE + slot;
+  uint32_t index = wheel->buckets[bucket];
+  wheel->buckets[bucket] = LUV_WHEEL_NONE;
+  while (index != LUV_WHEEL_NONE) {
+    uint32_t next = wheel->entries[index].next;
+    luv_wheel_link(wheel, index);
+    index = next;
+  }
+  return slot;
+}
+
+static void luv_wheel_free_entry(luv_timer_wheel_t* wheel, uint32_t index) {
+  luv_wheel_entry_t* e = &wheel->entries[index];
+  e->bucket = LUV_WHEEL_NONE;
+  e->gen = (e->gen + 1) & LUV_WHEEL_GEN_MASK;
+  e->next = wheel->free;
+  wheel->free = index;
+  wheel->count--;
+}
+
+static lua_Integer luv_wheel_id(luv_timer_wheel_t* wheel, uint32_t index) {
+  return (lua_Integer)(((uint64_t)wheel->entries[index].gen << LUV_WHEEL_INDEX_BITS) |
+                       (uint64_t)(index + 1));
+}
+
+// Returns the entry of a started timer, or LUV_WHEEL_NONE for a stale id
+static uint32_t luv_wheel_lookup(luv_timer_wheel_t* wheel, lua_Integer id) {
+  uint32_t index;
+  if (id <= 0) return LUV_WHEEL_NONE;
+  index = (uint32_t)((uint64_t)id & LUV_WHEEL_INDEX_MASK) - 1;
+  if (index >= wheel->cap) return LUV_WHEEL_NONE;
+  if (wheel->entries[index].gen != (uint32_t)((uint64_t)id >> LUV_WHEEL_INDEX_BITS)) return LUV_WHEEL_NONE;
+  if (wheel->entries[index].bucket == LUV_WHEEL_NONE) return LUV_WHEEL_NONE;
+  return index;
+}
+
+// Stops the driving timer and lets the userdata be collected once no timer
+// is started.
+static void luv_wheel_check_idle(lua_State* L, luv_timer_wheel_t* wheel) {
+  if (wheel->count) return;
+  uv_timer_stop(&wheel->timer);
+  luaL_unref(L, LUA_REGISTRYINDEX, wheel->ref);
+  wheel->ref = LUA_NOREF;
+}
+
+static void luv_timer_wheel_cb(uv_timer_t* handle) {
+  luv_timer_wheel_t* wheel = (luv_timer_wheel_t*)handle;
+  lua_State* L = wheel->ctx->L;
+  uint64_t now = luv_wheel_now(wheel);
+  int top = lua_gettop(L);
+  int values, expired = 0;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, wheel->ref);
+  luv_getslot(L, top + 1, 1);
+  luv_getslot(L, top + 1, 2);
+  values = top + 3;
+  lua_newtable(L);
+
+  while (wheel->tick <= now && wheel->count) {
+    uint32_t slot = (uint32_t)(wheel->tick & (LUV_WHEEL_ROOT_SIZE - 1));
+    uint32_t index;
+    int level;
+    // Spread the next bucket of each level that wrapped
+    for (level = 0; !slot && level < LUV_WHEEL_LEVELS; level++) {
+      if (luv_wheel_cascade(wheel, level)) break;
+    }
+    index = wheel->buckets[slot];
+    wheel->buckets[slot] = LUV_WHEEL_NONE;
+    wheel->tick++;
+    while (index != LUV_WHEEL_NONE) {
+      uint32_t next = wheel->entries[index].next;
+      if (wheel->entries[index].expires < wheel->tick) {
+        lua_rawgeti(L, values, index + 1);
+        if (lua_isnil(L, -1)) {
+          lua_pop(L, 1);
+          lua_pushinteger(L, luv_wheel_id(wheel, index));
+        }
+        else {
+          lua_pushnil(L);
+          lua_rawseti(L, values, index + 1);
+        }
+        lua_rawseti(L, -2, ++expired);
+        luv_wheel_free_entry(wheel, index);
+      }
+      else {
+        // Was beyond the wheel's reach when it was placed
+        luv_wheel_link(wheel, index);
+      }
+      index = next;
+    }
+  }
+  if (wheel->tick <= now) wheel->tick = now + 1;
+  luv_wheel_check_idle(L, wheel);
+
+  if (expired) {
+    lua_pushvalue(L, top + 2);
+    lua_insert(L, -2);
+    wheel->ctx->cb_pcall(L, 1, 0, 0);
+  }
+  lua_settop(L, top);
+}
+
+static void luv_timer_wheel_teardown(uv_handle_t* handle);
+
+static int luv_new_timer_wheel(lua_State* L) {
+  luv_ctx_t* ctx = luv_context(L);
+  lua_Integer tick_ms = luaL_checkinteger(L, 1);
+  luv_timer_wheel_t** udata;
+  luv_timer_wheel_t* wheel;
+  uint32_t i;
+  int ret;
+  luaL_argcheck(L, tick_ms > 0, 1, "tick must be a positive number of milliseconds");
+  luv_check_callable(L, 2);
+
+  udata = (luv_timer_wheel_t**)luv_newuserdata_slots(L, sizeof(*udata));
+  *udata = NULL;
+  luaL_getmetatable(L, "uv_timer_wheel");
+  lua_setmetatable(L, -2);
+
+  wheel = (luv_timer_wheel_t*)malloc(sizeof(*wheel));
+  if (!wheel) return luaL_error(L, "Failed to allocate timer wheel");
+  ret = uv_timer_init(ctx->loop, &wheel->timer);
+  if (ret < 0) {
+    free(wheel);
+    return luv_error(L, ret);
+  }
+  // Like the loop's internal handles, invisible to uv.walk, and closed by
+  // luv_tick_close if the loop goes away first
+  wheel->timer.data = NULL;
+  wheel->ctx = ctx;
+  wheel->udata = udata;
+  luv_internal_add(ctx, &wheel->internal, (uv_handle_t*)&wheel->timer, luv_timer_wheel_teardown);
+  wheel->tick_ms = (uint64_t)tick_ms;
+  wheel->start = uv_now(ctx->loop);
+  wheel->tick = 0;
+  wheel->entries = NULL;
+  wheel->cap = 0;
+  wheel->count = 0;
+  wheel->free = LUV_WHEEL_NONE;
+  wheel->ref = LUA_NOREF;
+  for (i = 0; i < LUV_WHEEL_BUCKETS; i++)
+    wheel->buckets[i] = LUV_WHEEL_NONE;
+  *udata = wheel;
+
+  lua_pushvalue(L, 2);
+  luv_setslot(L, -2, 1, 1);
+  lua_newtable(L);
+  luv_setslot(L, -2, 2, 0);
+  return 1;
+}
+
+static int luv_timer_wheel_start(lua_State* L) {
+  luv_timer_wheel_t* wheel = luv_check_timer_wheel(L, 1);
+  lua_Integer timeout = luaL_checkinteger(L, 2);
+  luv_wheel_entry_t* e;
+  uint32_t index;
+  luaL_argcheck(L, timeout >= 0, 2, "timeout must be non-negative");
+
+  if (wheel->free == LUV_WHEEL_NONE) {
+    uint32_t cap = wheel->cap ? wheel->cap * 2 : LUV_WHEEL_MIN;
+    luv_wheel_entry_t* entries;
+    // Index plus one has to fit the id, and LUV_WHEEL_NONE is no index
+    if (cap <= wheel->cap || cap > LUV_WHEEL_INDEX_MASK - 1)
+      return luaL_error(L, "Too many timers in the wheel");
+    entries = (luv_wheel_entry_t*)realloc(wheel->entries, cap * sizeof(*entries));
+    if (!entries) return luaL_error(L, "Failed to allocate timer wheel entries");
+    for (index = cap; index-- > wheel->cap;) {
+      entries[index].gen = 0;
+      entries[index].bucket = LUV_WHEEL_NONE;
+      entries[index].next = wheel->free;
+      wheel->free = index;
+    }
+    wheel->entries = entries;
+    wheel->cap = cap;
+  }
+
+  if (!wheel->count) {
+    // Nothing is waiting, the wheel can skip to the present
+    int ret = uv_timer_start(&wheel->timer, luv_timer_wheel_cb, wheel->tick_ms, wheel->tick_ms);
+    if (ret < 0) return luv_error(L, ret);
+    wheel->tick = luv_wheel_now(wheel);
+    lua_pushvalue(L, 1);
+    wheel->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  }
+
+  index = wheel->free;
+  e = &wheel->entries[index];
+  wheel->free = e->next;
+  wheel->count++;
+  // Rounded up so a timer never fires early
+  e->expires = (uv_now(wheel->ctx->loop) - wheel->start + (uint64_t)timeout +
+                wheel->tick_ms - 1) / wheel->tick_ms;
+  luv_wheel_link(wheel, index);
+
+  if (!lua_isnoneornil(L, 3)) {
+    luv_getslot(L, 1, 2);
+    lua_pushvalue(L, 3);
+    lua_rawseti(L, -2, index + 1);
+    lua_pop(L, 1);
+  }
+  lua_pushinteger(L, luv_wheel_id(wheel, index));
+  return 1;
+}
+
+static int luv_timer_wheel_restart(lua_State* L) {
+  luv_timer_wheel_t* wheel = luv_check_timer_wheel(L, 1);
+  uint32_t index = luv_wheel_lookup(wheel, luaL_checkinteger(L, 2));
+  lua_Integer timeout = luaL_checkinteger(L, 3);
+  luaL_argcheck(L, timeout >= 0, 3, "timeout must be non-negative");
+  if (index == LUV_WHEEL_NONE) {
+    lua_pushboolean(L, 0);
+    return 1;
+  }
+  luv_wheel_unlink(wheel, index);
+  wheel->entries[index].expires = (uv_now(wheel->ctx->loop) - wheel->start +
+                                   (uint64_t)timeout + wheel->tick_ms - 1) / wheel->tick_ms;
+  luv_wheel_link(wheel, index);
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+static int luv_timer_wheel_stop(lua_State* L) {
+  luv_timer_wheel_t* wheel = luv_check_timer_wheel(L, 1);
+  uint32_t index = luv_wheel_lookup(wheel, luaL_checkinteger(L, 2));
+  if (index == LUV_WHEEL_NONE) {
+    lua_pushboolean(L, 0);
+    return 1;
+  }
+  luv_wheel_unlink(wheel, index);
+  luv_wheel_free_entry(wheel, index);
+  luv_getslot(L, 1, 2);
+  lua_pushnil(L);
+  lua_rawseti(L, -2, index + 1);
+  lua_pop(L, 1);
+  luv_wheel_check_idle(L, wheel);
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+static int luv_timer_wheel_count(lua_State* L) {
+  luv_timer_wheel_t* wheel = luv_check_timer_wheel(L, 1);
+  lua_pushinteger(L, wheel->count);
+  return 1;
+}
+
+static void luv_timer_wheel_close_cb(uv_handle_t* handle) {
+  luv_timer_wheel_t* wheel = (luv_timer_wheel_t*)handle;
+  free(wheel->entries);
+  free(wheel);
+}
+
+// Drops the started timers without calling back and closes the driving
+// timer, the wheel is freed once that is done
+static void luv_timer_wheel_release(luv_timer_wheel_t* wheel) {
+  *wheel->udata = NULL;
+  luv_internal_remove(wheel->ctx, &wheel->internal);
+  if (wheel->ref != LUA_NOREF) {
+    luaL_unref(wheel->ctx->L, LUA_REGISTRYINDEX, wheel->ref);
+    wheel->ref = LUA_NOREF;
+  }
+  if (!uv_is_closing((uv_handle_t*)&wheel->timer))
+    uv_close((uv_handle_t*)&wheel->timer, luv_timer_wheel_close_cb);
+}
+
+static void luv_timer_wheel_teardown(uv_handle_t* handle) {
+  luv_timer_wheel_release((luv_timer_wheel_t*)handle);
+}
+
+static int luv_timer_wheel_close(lua_State* L) {
+  luv_timer_wheel_t* wheel = luv_check_timer_wheel(L, 1);
+  luv_timer_wheel_release(wheel);
+  // The values of the dropped timers go with it
+  lua_newtable(L);
+  luv_setslot(L, 1, 2, 0);
+  return 0;
+}
+
+// Only collected while no timer is started, or when the state is closed
+static int luv_timer_wheel_gc(lua_State* L) {
+  luv_timer_wheel_t** udata = (luv_timer_wheel_t**)lua_touserdata(L, 1);
+  if (*udata) luv_timer_wheel_release(*udata);
+  return 0;
+}
+
+static int luv_timer_wheel_tostring(lua_State* L) {
+  luv_timer_wheel_t** udata = (luv_timer_wheel_t**)luaL_checkudata(L, 1, "uv_timer_wheel");
+  lua_pushfstring(L, "uv_timer_wheel: %p", *udata);
+  return 1;
+}
+
+static const luaL_Reg luv_timer_wheel_methods[] = {
+  {"start", luv_timer_wheel_start},
+  {"restart", luv_timer_wheel_restart},
+  {"stop", luv_timer_wheel_stop},
+  {"count", luv_timer_wheel_count},
+  {"close", luv_timer_wheel_close},
+  {NULL, NULL}
+};
+
+static void luv_timer_wheel_init(lua_State* L) {
+  luaL_newmetatable(L, "uv_timer_wheel");
+  lua_pushcfunction(L, luv_timer_wheel_tostring);
+  lua_setfield(L, -2, "__tostring");
+  lua_pushcfunction(L, luv_timer_wheel_gc);
+  lua_setfield(L, -2, "__gc");
+  lua_newtable(L);
+  luaL_setfuncs(L, luv_timer_wheel_methods, 0);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+}
@@ -29,7 +29,7 @@ static int luv_new_tty(lua_State* L) {
   uv_file fd = luaL_checkinteger(L, 1);
   luaL_checktype(L, 2, LUA_TBOOLEAN);
   readable = lua_toboolean(L, 2);
-  handle = (uv_tty_t*)luv_newuserdata(L, uv_handle_size(UV_TTY));
+  handle = (uv_tty_t*)luv_newhandle(L, UV_TTY);
   ret = uv_tty_init(ctx->loop, handle, fd, readable);
   if (ret < 0) {
     lua_pop(L, 1);
@@ -25,7 +25,7 @@ static uv_udp_t* luv_check_udp(lua_State* L, int index) {
 static int luv_new_udp(lua_State* L) {
   luv_ctx_t* ctx = luv_context(L);
   lua_settop(L, 1);
-  uv_udp_t* handle = (uv_udp_t*)luv_newuserdata(L, uv_handle_size(UV_UDP));
+  uv_udp_t* handle = (uv_udp_t*)luv_newhandle(L, UV_UDP);
   int ret;
 #if LUV_UV_VERSION_GEQ(1, 39, 0)
   // TODO: This default can potentially be increased, but it's
@@ -103,9 +103,7 @@ static int luv_new_udp(lua_State* L) {
     // store the number of msgs to be received for use in alloc_cb
     int* extra_data = malloc(sizeof(int));
     if (!extra_data) {
-      uv_close((uv_handle_t*)handle, NULL);
-      free(handle->data);
-      free(handle);
+      uv_close((uv_handle_t*)handle, luv_close_cb);
       return luaL_error(L, "Failed to allocate UDP recvmmsg state");
     }
     *extra_data = mmsg_num_msgs;
@@ -330,7 +328,7 @@ static int luv_udp_send(lua_State* L) {
   luv_handle_t* lhandle = handle->data;
   addr_ptr = luv_check_addr(L, &addr, 3, 4);
   ref = luv_check_continuation(L, 5);
-  req = (uv_udp_send_t*)lua_newuserdata(L, uv_req_size(UV_UDP_SEND));
+  req = (uv_udp_send_t*)luv_newreq(L, UV_UDP_SEND);
   req->data = luv_setup_req(L, lhandle->ctx, ref);
   size_t count;
   uv_buf_t* bufs = luv_check_bufs(L, 2, &count, (luv_req_t*)req->data);
@@ -113,3 +113,43 @@ static int luv_optboolean(lua_State*L, int idx, int val) {
     val = lua_toboolean(L, idx);
   return val;
 }
+
+// Handles and requests keep the Lua values their C side needs, callbacks and
+// the data a request pins, in LUV_USERDATA_SLOTS user values of their
+// userdata rather than in the registry.  Lua 5.4 allocates them with the
+// userdata.  Older versions use a table set as its uservalue (its environment
+// on 5.1 and LuaJIT) that is created when the first slot is set.
+static void* luv_newuserdata_slots(lua_State* L, size_t sz) {
+#if LUA_VERSION_NUM >= 504
+  return lua_newuserdatauv(L, sz, LUV_USERDATA_SLOTS);
+#else
+  return lua_newuserdata(L, sz);
+#endif
+}
+
+static void luv_setslot(lua_State* L, int index, int n, int fresh) {
+#if LUA_VERSION_NUM >= 504
+  (void)fresh;
+  lua_setiuservalue(L, index, n);
+#else
+  index = lua_absindex(L, index);
+  if (fresh) {
+    lua_createtable(L, LUV_USERDATA_SLOTS, 0);
+    lua_setuservalue(L, index);
+  }
+  lua_getuservalue(L, index);
+  lua_insert(L, -2);
+  lua_rawseti(L, -2, n);
+  lua_pop(L, 1);
+#endif
+}
+
+static void luv_getslot(lua_State* L, int index, int n) {
+#if LUA_VERSION_NUM >= 504
+  lua_getiuservalue(L, index, n);
+#else
+  lua_getuservalue(L, index);
+  lua_rawgeti(L, -1, n);
+  lua_remove(L, -2);
+#endif
+}
@@ -25,6 +25,9 @@
 #define LUV_UV_VERSION_LEQ(major, minor, patch) \
   (((major)<<16 | (minor)<<8 | (patch)) >= UV_VERSION_HEX)
 
+/* User values every handle and request userdata has, see luv_setslot */
+#define LUV_USERDATA_SLOTS 2
+
 void luv_stack_dump(lua_State* L, const char* name);
 
 #endif
@@ -0,0 +1,39 @@
+-- Microbenchmarks for the fixed costs of a binding call: looking up the luv
+-- context, which almost every binding does, and checking handle arguments.
+-- uv.hrtime is the baseline as it never touches the context, uv.now and
+-- uv.loop_alive look it up once per call.  Not part of the automatic test
+-- runner since it only reports timings; run it against two builds to
+-- compare them.
+
+return require('lib/tap')(function (test)
+
+  local iterations = 5000000
+
+  local function bench(uv, name, fn)
+    -- warm up so the numbers don't include JIT or allocator start up costs
+    for _ = 1, iterations / 10 do fn() end
+    local start = uv.hrtime()
+    for _ = 1, iterations do fn() end
+    local ns = (uv.hrtime() - start) / iterations
+    print(string.format("%-16s %8.2f ns/call", name, ns))
+    return ns
+  end
+
+  test("binding call overhead", function (print, p, expect, uv)
+    local base = bench(uv, "uv.hrtime", uv.hrtime)
+    local now = bench(uv, "uv.now", uv.now)
+    local alive = bench(uv, "uv.loop_alive", uv.loop_alive)
+    print(string.format("context lookup ~ %.2f ns/call", ((now + alive) / 2) - base))
+  end)
+
+  test("handle check overhead", function (print, p, expect, uv)
+    local tcp = uv.new_tcp()
+    local timer = uv.new_timer()
+    -- luv_check_stream and luv_check_handle
+    bench(uv, "tcp:is_readable", function () return tcp:is_readable() end)
+    bench(uv, "timer:is_active", function () return timer:is_active() end)
+    tcp:close()
+    timer:close()
+  end)
+
+end)
@@ -0,0 +1,24 @@
+-- run `lua manual-test-loop-close.lua || echo $?`
+-- it should exit with status 0
+
+local uv = require('luv')
+
+-- queued work keeps the loop busy
+local ran = false
+uv.defer(function () ran = true end)
+local ok, _, name = uv.loop_close()
+assert(not ok and name == "EBUSY", name)
+
+-- so does the timer of a future timeout
+local timedout = false
+uv.future_timeout(uv.new_future(), 10):wait(function (err)
+  timedout = err ~= nil
+end)
+ok, _, name = uv.loop_close()
+assert(not ok and name == "EBUSY", name)
+
+uv.run()
+assert(ran and timedout)
+
+-- the handles uv.defer and the timeout used are closed by the run
+assert(uv.loop_close() == 0)
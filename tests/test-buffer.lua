@@ -0,0 +1,28 @@
+return require('lib/tap')(function (test)
+
+  test("buffer basics", function (print, p, expect, uv)
+    local buf = uv.new_buffer(8)
+    p(buf)
+    assert(buf:size() == 8)
+    assert(#buf == 8)
+    assert(uv.buffer_size(buf) == 8)
+    assert(buf:get_string() == string.rep("\0", 8))
+    assert(buf:set_string(2, "abc") == 3)
+    assert(buf:get_string(2, 3) == "abc")
+    assert(buf:get_string(5) == "\0\0\0")
+    assert(uv.buffer_get_string(buf, 0, 0) == "")
+    assert(uv.buffer_set_string(buf, 8, "") == 0)
+  end)
+
+  test("buffer argument checks", function (print, p, expect, uv)
+    assert(not pcall(uv.new_buffer, 0))
+    assert(not pcall(uv.new_buffer, -1))
+    local buf = uv.new_buffer(4)
+    assert(not pcall(buf.get_string, buf, 5))
+    assert(not pcall(buf.get_string, buf, 2, 3))
+    assert(not pcall(buf.get_string, buf, -1))
+    assert(not pcall(buf.set_string, buf, 2, "abc"))
+    assert(not pcall(uv.buffer_size, "abcd"))
+  end)
+
+end)
@@ -56,4 +56,30 @@ return require('lib/tap')(function (test)
     assert(uv.fs_stat('.', callable))
   end)
 
+  test("callbacks are released once the handle is closed", function (print, p, expect, uv)
+    local handle = uv.new_timer()
+    local weak = setmetatable({}, {__mode="v"})
+    local function replaced() end
+    weak.replaced = replaced
+    uv.timer_start(handle, 10, 0, replaced)
+    replaced = nil
+    local ontimeout = expect(function ()
+      uv.close(handle, expect(function ()
+        local timer = uv.new_timer()
+        timer:start(0, 0, expect(function ()
+          timer:close()
+          -- handle is still referenced, its callbacks must not be
+          assert(handle)
+          collectgarbage()
+          collectgarbage()
+          assert(weak.replaced == nil)
+          assert(weak.ontimeout == nil)
+        end))
+      end))
+    end)
+    weak.ontimeout = ontimeout
+    uv.timer_start(handle, 10, 0, ontimeout)
+    ontimeout = nil
+  end)
+
 end)
\ No newline at end of file
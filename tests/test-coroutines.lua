@@ -29,4 +29,32 @@ return require('lib/tap')(function (test)
     assert(touch==3)
   end)
 
+  test("requests resume a coroutine passed as callback", function (print, p, expect, uv)
+    local done = expect(function () end)
+    coroutine.wrap(function()
+      assert(uv.fs_stat(".", coroutine.running()))
+      local err, stat = coroutine.yield()
+      assert(not err, err)
+      assert(stat.type == "directory")
+
+      err, stat = uv.await(uv.fs_stat, "tests")
+      assert(not err, err)
+      assert(stat.type == "directory")
+
+      -- errors of the request arrive as arguments
+      err = uv.await(uv.fs_stat, "no/such/file")
+      assert(err:match("^ENOENT"))
+
+      -- optional arguments before the callback
+      local fd = assert(uv.fs_open("tests/test-coroutines.lua", "r", tonumber("644", 8)))
+      local data
+      err, data = uv.await(uv.fs_read, fd, 6, 0)
+      assert(not err, err)
+      assert(data == "return")
+      uv.fs_close(fd)
+      done()
+    end)()
+    assert(not pcall(uv.await, uv.fs_stat, "."))
+  end)
+
 end)
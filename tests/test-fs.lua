@@ -99,6 +99,42 @@ return require('lib/tap')(function (test)
     end)))
   end)
 
+  test("fs.stat selected fields", function (print, p, expect, uv)
+    local full = assert(uv.fs_stat("README.md"))
+    local stat = assert(uv.fs_stat("README.md", {"size", "type"}))
+    assert(stat.size == full.size and stat.type == "file")
+    assert(stat.mode == nil and stat.mtime == nil)
+    -- nanosecond timestamps need 64 bit integers, Lua 5.3 and later
+    if math.type then
+      stat = assert(uv.fs_stat("README.md", {"mtime_ns"}))
+      assert(stat.mtime_ns == full.mtime.sec * 1000000000 + full.mtime.nsec)
+    else
+      assert(not pcall(uv.fs_stat, "README.md", {"mtime_ns"}))
+    end
+    assert(next(assert(uv.fs_stat("README.md", {}))) == nil)
+    assert(not pcall(uv.fs_stat, "README.md", {"size", "bogus"}))
+
+    local fd = assert(uv.fs_open("README.md", "r", tonumber("644", 8)))
+    assert(uv.fs_fstat(fd, {"size"}).size == full.size)
+    assert(uv.fs_close(fd))
+    assert(uv.fs_lstat("README.md", {"mtime"}, expect(function (err, lstat)
+      assert(not err, err)
+      assert(lstat.mtime.sec == full.mtime.sec and lstat.size == nil)
+    end)))
+  end)
+
+  test("fs_poll selected fields", function (print, p, expect, uv)
+    local poll = uv.new_fs_poll()
+    -- a missing file is reported right away with a zeroed curr
+    assert(poll:start("BAD_FILE_POLL", 1000, {"size"}, expect(function (err, prev, curr)
+      assert(err)
+      assert(curr.size == 0 and curr.mode == nil and curr.mtime == nil)
+      assert(prev.size == 0 and prev.mode == nil)
+      poll:close()
+    end)))
+    assert(not pcall(poll.start, poll, "BAD_FILE_POLL", 1000, {"bogus"}, function () end))
+  end)
+
   test("fs.stat sync error", function (print, p, expect, uv)
     local stat, err, code = uv.fs_stat("BAD_FILE!")
     p{err=err,code=code,stat=stat}
@@ -580,4 +616,164 @@ return require('lib/tap')(function (test)
       assert(uv.fs_unlink(path))
     end)
   end, "1.36.0")
+
+  test("fs.readfile", function (print, p, expect, uv)
+    local stat = assert(uv.fs_stat("README.md"))
+    local data = assert(uv.fs_readfile("README.md"))
+    assert(#data == stat.size)
+    local ok, err, errname = uv.fs_readfile("no/such/file")
+    assert(not ok and errname == "ENOENT" and err:match("no/such/file"))
+
+    assert(uv.fs_readfile("README.md", expect(function (err, async_data)
+      assert(not err, err)
+      assert(async_data == data)
+    end)))
+    uv.fs_readfile("no/such/file", expect(function (err, nothing)
+      assert(err:match("^ENOENT") and nothing == nil)
+    end))
+  end)
+
+  test("fs.writefile", function (print, p, expect, uv)
+    local path = "_test_"
+    assert(uv.fs_writefile(path, "Hello") == 5)
+    assert(uv.fs_writefile(path, " World\n", "a"))
+    assert(uv.fs_readfile(path) == "Hello World\n")
+    uv.fs_writefile(path, "async", expect(function (err, n)
+      assert(not err, err)
+      assert(n == 5)
+      assert(uv.fs_readfile(path) == "async")
+      assert(uv.fs_unlink(path))
+    end))
+  end)
+
+  test("fs.writefile atomic", function (print, p, expect, uv)
+    local path = "_test_"
+    assert(uv.fs_writefile(path, "old"))
+    assert(uv.fs_chmod(path, tonumber("640", 8)))
+    uv.fs_writefile(path, "new content", { atomic = true, mode = tonumber("600", 8) }, expect(function (err)
+      assert(not err, err)
+      assert(uv.fs_readfile(path) == "new content")
+      if not isWindows then
+        -- the existing file's mode is kept
+        assert(uv.fs_stat(path).mode % 512 == tonumber("640", 8))
+      end
+      assert(uv.fs_unlink(path))
+    end))
+  end, "1.34.0")
+
+  test("fs.writefile atomic applies the umask to a new file", function (print, p, expect, uv)
+    local path, plain = "_test_", "_test_plain_"
+    local mode = tonumber("666", 8)
+    assert(uv.fs_writefile(plain, "", { mode = mode }))
+    assert(uv.fs_writefile(path, "new", { atomic = true, mode = mode }))
+    assert(uv.fs_readfile(path) == "new")
+    if not isWindows then
+      assert(uv.fs_stat(path).mode % 512 == uv.fs_stat(plain).mode % 512)
+    end
+    assert(uv.fs_unlink(path))
+    assert(uv.fs_unlink(plain))
+  end, "1.34.0")
+
+  test("fs.read_into", function (print, p, expect, uv)
+    local data = assert(uv.fs_readfile("README.md"))
+    local fd = assert(uv.fs_open("README.md", "r", tonumber("644", 8)))
+    local buf = uv.new_buffer(16)
+    assert(uv.fs_read_into(fd, buf, 4, 8, 0) == 8)
+    assert(buf:get_string(4, 8) == data:sub(1, 8))
+    assert(buf:get_string(0, 4) == "\0\0\0\0")
+    -- the same buffer for every chunk, from the current file offset
+    local chunks = {}
+    while true do
+      local n = assert(uv.fs_read_into(fd, buf, 0, 16))
+      if n == 0 then break end
+      chunks[#chunks + 1] = buf:get_string(0, n)
+    end
+    assert(table.concat(chunks) == data)
+    assert(not pcall(uv.fs_read_into, fd, buf, 8, 9))
+
+    uv.fs_read_into(fd, buf, 0, 16, 0, expect(function (err, n)
+      assert(not err, err)
+      assert(n == 16)
+      assert(buf:get_string() == data:sub(1, 16))
+      assert(uv.fs_close(fd))
+    end))
+  end)
+
+  test("fs.walk", function (print, p, expect, uv)
+    local root = assert(uv.fs_mkdtemp("_walk_XXXXXX"))
+    local tree = {
+      "a.lua", "b.txt", "sub/", "sub/c.lua", "sub/deep/", "sub/deep/d.lua", "other/", "other/e.txt",
+    }
+    for _, path in ipairs(tree) do
+      if path:sub(-1) == "/" then
+        assert(uv.fs_mkdir(root .. "/" .. path, tonumber("755", 8)))
+      else
+        assert(uv.fs_writefile(root .. "/" .. path, path))
+      end
+    end
+    local function cleanup()
+      for i = #tree, 1, -1 do
+        local path = root .. "/" .. tree[i]
+        if tree[i]:sub(-1) == "/" then assert(uv.fs_rmdir(path)) else assert(uv.fs_unlink(path)) end
+      end
+      assert(uv.fs_rmdir(root))
+    end
+
+    local function walk(opts, check)
+      local found = {}
+      uv.fs_walk(root, opts, function (err, names, types)
+        assert(not err, err)
+        if not names then return check(found) end
+        assert(#names == #types)
+        for i, name in ipairs(names) do
+          assert(not found[name])
+          found[name] = types[i]
+        end
+      end)
+    end
+    local function count(t)
+      local n = 0
+      for _ in pairs(t) do n = n + 1 end
+      return n
+    end
+
+    local pending = 5
+    local function done()
+      pending = pending - 1
+      if pending == 0 then cleanup() end
+    end
+    walk({}, expect(function (found)
+      assert(count(found) == #tree)
+      assert(found["sub/deep"] == "directory" and found["sub/deep/d.lua"] == "file")
+      done()
+    end))
+    walk({ max_depth = 1 }, expect(function (found)
+      assert(count(found) == 4 and found["sub"] and not found["sub/c.lua"])
+      done()
+    end))
+    walk({ glob = "*.lua" }, expect(function (found)
+      assert(count(found) == 3 and found["a.lua"] and found["sub/deep/d.lua"])
+      done()
+    end))
+    walk({ prefix = "sub/" }, expect(function (found)
+      assert(count(found) == 3 and found["sub/c.lua"] and not found["sub"])
+      done()
+    end))
+    walk({ parallel = 4, batch = 1 }, expect(function (found)
+      assert(count(found) == #tree)
+      done()
+    end))
+  end)
+
+  test("fs.walk error", function (print, p, expect, uv)
+    local errors = 0
+    assert(uv.fs_walk("no/such/dir", expect(function (err, names)
+      if err then
+        assert(err:match("^ENOENT"))
+        errors = errors + 1
+      else
+        assert(names == nil and errors == 1)
+      end
+    end, 2)))
+  end)
 end)
@@ -13,4 +13,34 @@ return require('lib/tap')(function (test)
     pipe:close()
   end, "1.19.0")
 
+  test("handle and stream arguments are type checked", function (print, p, expect, uv)
+    local timer = uv.new_timer()
+    local tcp = uv.new_tcp()
+    -- userdata that isn't a handle, and handles that aren't streams
+    assert(not pcall(uv.is_active, uv.new_buffer(8)))
+    assert(not pcall(uv.is_active, io.stdout))
+    assert(not pcall(uv.is_active, {}))
+    assert(not pcall(uv.is_readable, timer))
+    assert(not pcall(uv.write, timer, "data"))
+    assert(uv.is_active(timer) == false)
+    assert(uv.is_readable(tcp) == false)
+    -- Lua code can change the metatables, what is in them proves nothing
+    local buffer_mt, tcp_mt = getmetatable(uv.new_buffer(8)), getmetatable(tcp)
+    local saved = {}
+    for k, v in pairs(tcp_mt) do
+      if k ~= "__gc" then
+        saved[k] = rawget(buffer_mt, k)
+        rawset(buffer_mt, k, v)
+      end
+    end
+    local ok = pcall(uv.is_readable, uv.new_buffer(8))
+    local ok2 = pcall(uv.is_active, uv.new_buffer(8))
+    for k in pairs(tcp_mt) do
+      if k ~= "__gc" then rawset(buffer_mt, k, saved[k]) end
+    end
+    assert(not ok and not ok2)
+    timer:close()
+    tcp:close()
+  end)
+
 end)
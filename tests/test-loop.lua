@@ -23,6 +23,60 @@ return require('lib/tap')(function (test)
     end))
   end)
 
+  test("uv.batch_callbacks", function (print, p, expect, uv)
+    assert(uv.batch_callbacks(true) == false)
+    local order = {}
+    local timers = {}
+    for i = 1, 3 do
+      timers[i] = uv.new_timer()
+      uv.timer_start(timers[i], 10, 0, expect(function ()
+        order[#order + 1] = i
+        uv.close(timers[i], expect(function ()
+          order[#order + 1] = "closed " .. i
+          if i == 3 then
+            p(order)
+            assert(table.concat(order, ",") == "1,2,3,closed 1,closed 2,closed 3")
+            assert(uv.batch_callbacks(false) == true)
+          end
+        end))
+      end))
+    end
+    local async
+    async = uv.new_async(expect(function (a, b)
+      assert(a == "a" and b == nil)
+      uv.close(async)
+    end))
+    async:send("a", nil)
+  end)
+
+  test("uv.defer", function (print, p, expect, uv)
+    local order = {}
+    for i = 1, 200 do
+      assert(uv.defer(function (n, nothing, s)
+        assert(n == i and nothing == nil and s == "x")
+        order[#order + 1] = n
+      end, i, nil, "x") == 0)
+    end
+    coroutine.wrap(function ()
+      uv.defer(expect(function (n)
+        assert(n == 201 and #order == 200)
+      end), 201)
+    end)()
+    -- A function that keeps deferring itself leaves room for I/O
+    local spins, fired = 0, false
+    local function spin()
+      spins = spins + 1
+      if not fired then return uv.defer(spin) end
+      assert(spins > 1)
+    end
+    uv.defer(spin)
+    local timer = uv.new_timer()
+    timer:start(5, 0, expect(function ()
+      fired = true
+      timer:close()
+    end))
+  end)
+
   test("issue #437, crash without uv.run", function (print, p, expect, uv)
     local handle
     local stdout = uv.new_pipe(false)
@@ -45,6 +99,20 @@ return require('lib/tap')(function (test)
     end))
   end)
 
+  test("uv.loop_close with luv's internal handles", function (print, p, expect, uv)
+    local handle
+    handle = uv.spawn(cmd, {
+      args = { "tests/manual-test-loop-close.lua" },
+      cwd = cwd,
+    },
+    expect(function(status, signal)
+      print('loop_close', status, signal)
+      assert(status==0)
+      assert(signal==0)
+      handle:close()
+    end))
+  end)
+
   test("issue #599, crash during calling os.exit", function (print, p, expect, uv)
     local handle
     local stdout = uv.new_pipe(false)
@@ -31,4 +31,94 @@ return require('lib/tap')(function (test)
     assert(typeid == typeid_)
   end, "1.19.0")
 
+  test("request records are reused", function (print, p, expect, uv)
+    local before = uv.req_pool_stats()
+    p(before)
+    local function stat(n)
+      uv.fs_stat('.', expect(function(err)
+        assert(not err, err)
+        if n > 1 then return stat(n - 1) end
+        local after = uv.req_pool_stats()
+        p(after)
+        -- a record is returned once its callback finishes, so from the
+        -- third stat on each one reuses the record of an earlier one
+        assert(after.hits - before.hits >= 3)
+        assert(after.cached <= after.max)
+      end))
+    end
+    stat(5)
+  end)
+
+  test("req_pool_configure", function (print, p, expect, uv)
+    assert(not pcall(uv.req_pool_configure, -1))
+    local max = uv.req_pool_stats().max
+    assert(uv.req_pool_configure(0))
+    assert(uv.req_pool_stats().cached == 0)
+    assert(uv.req_pool_configure(max))
+  end)
+
+  test("futures", function (print, p, expect, uv)
+    local f = uv.new_future()
+    assert(uv.fs_stat(".", f))
+    assert(uv.future_get(f) == false)
+    f:wait(expect(function (err, stat)
+      assert(not err, err)
+      assert(stat.type == "directory")
+      assert(select(1, f:get()) == true)
+      -- resolved once, waiters that come late are still called
+      assert(not f:resolve("again"))
+      f:wait(expect(function (err2, stat2)
+        assert(stat2 == stat)
+      end))
+    end))
+  end)
+
+  test("future combinators", function (print, p, expect, uv)
+    local paths = { ".", "tests", "src" }
+    local list = {}
+    for i, path in ipairs(paths) do
+      list[i] = uv.new_future()
+      assert(uv.fs_stat(path, list[i]))
+    end
+    uv.future_all(list):wait(expect(function (err, stats)
+      assert(not err, err)
+      assert(stats.n == 3)
+      for i = 1, 3 do assert(stats[i].type == "directory") end
+    end))
+
+    local missing = uv.new_future()
+    assert(uv.fs_stat("no/such/file", missing))
+    uv.future_all({ list[1], missing }):wait(expect(function (err)
+      assert(err:match("^ENOENT"))
+    end))
+    uv.future_any({ missing, list[2] }):wait(expect(function (err, stat)
+      assert(not err, err)
+      assert(stat.type == "directory")
+    end))
+    uv.future_race({ uv.new_future(), list[3] }):wait(expect(function (err, stat)
+      assert(stat.type == "directory")
+    end))
+    uv.future_all({}):wait(expect(function (err, results)
+      assert(not err and results.n == 0)
+    end))
+    assert(not pcall(uv.future_any, {}))
+    assert(not pcall(uv.future_race, { 1 }))
+  end)
+
+  test("future timeout", function (print, p, expect, uv)
+    local never = uv.new_future()
+    uv.future_timeout(never, 10):wait(expect(function (err)
+      assert(err == "ETIMEDOUT")
+    end))
+    local soon = uv.new_future()
+    soon:timeout(1000):wait(expect(function (err, value)
+      assert(not err and value == 42)
+    end))
+    soon:resolve(nil, 42)
+    coroutine.wrap(function ()
+      local err, value = uv.await(uv.future_wait, soon)
+      assert(value == 42)
+    end)()
+  end)
+
 end)
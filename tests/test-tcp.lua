@@ -353,4 +353,722 @@ return require('lib/tap')(function (test)
       end))
     end))
   end, "1.41.0")
+
+  test("tcp reads reuse pooled buffers", function (print, p, expect, uv)
+    assert(uv.buffer_pool_configure(4096, 4))
+    local before = uv.buffer_pool_stats()
+    p(before)
+    assert(before.size == 4096)
+    assert(before.max == 4)
+
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local client = uv.new_tcp()
+      assert(server:accept(client))
+      assert(client:read_start(function (err, data)
+        assert(not err, err)
+        if data then
+          assert(client:write(data))
+        else
+          client:close()
+          server:close()
+        end
+      end))
+    end)))
+
+    local address = server:getsockname()
+    local socket = assert(uv.new_tcp())
+    local received = 0
+    assert(socket:connect("127.0.0.1", address.port, expect(function ()
+      assert(socket:read_start(function (err, data)
+        assert(not err, err)
+        if not data then return end
+        received = received + #data
+        if received == 15 then
+          local after = uv.buffer_pool_stats()
+          p(after)
+          assert(after.hits > before.hits)
+          assert(after.cached <= after.max)
+          socket:close()
+          assert(uv.buffer_pool_configure(64 * 1024, 16))
+        end
+      end))
+      socket:write("Hello", expect(function ()
+        socket:write("Hello", expect(function ()
+          socket:write("Hello", expect(function ()
+            socket:shutdown()
+          end))
+        end))
+      end))
+    end)))
+  end)
+
+  test("tcp reads into a caller-owned buffer", function (print, p, expect, uv)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local client = uv.new_tcp()
+      assert(server:accept(client))
+      assert(client:write("Hello"))
+      assert(client:shutdown(expect(function ()
+        client:close()
+        server:close()
+      end)))
+    end)))
+
+    local address = server:getsockname()
+    local socket = assert(uv.new_tcp())
+    local buf = uv.new_buffer(16)
+    local received = {}
+    assert(socket:connect("127.0.0.1", address.port, expect(function ()
+      assert(socket:read_start({buffer = buf, offset = 4}, function (err, data, offset, length)
+        assert(not err, err)
+        if not data then
+          assert(table.concat(received) == "Hello")
+          socket:close()
+          return
+        end
+        assert(rawequal(data, buf))
+        assert(offset == 4)
+        assert(length > 0 and offset + length <= #buf)
+        received[#received + 1] = buf:get_string(offset, length)
+      end))
+    end)))
+  end)
+
+  for _, mode in ipairs({"string", "array"}) do
+    test("tcp reads batched per loop iteration as " .. mode, function (print, p, expect, uv)
+      local chunk_size = 64
+      local server = uv.new_tcp()
+      assert(server:bind("127.0.0.1", 0))
+      assert(server:listen(1, expect(function ()
+        local client = uv.new_tcp()
+        assert(server:accept(client))
+        for i = 1, 10 do
+          assert(client:write(string.rep(tostring(i % 10), chunk_size)))
+        end
+        assert(client:shutdown(expect(function ()
+          client:close()
+          server:close()
+        end)))
+      end)))
+
+      -- Reads of one buffer each, so libuv needs ten reads in the same loop
+      -- iteration to get the data that is all waiting on the socket
+      local stats = uv.buffer_pool_stats()
+      assert(uv.buffer_pool_configure(chunk_size))
+      local address = server:getsockname()
+      local socket = assert(uv.new_tcp())
+      local received = {}
+      local calls = 0
+      assert(socket:connect("127.0.0.1", address.port, expect(function ()
+        local timer = uv.new_timer()
+        timer:start(50, 0, expect(function ()
+          timer:close()
+          assert(socket:read_start({batch = mode}, function (err, data)
+            assert(not err, err)
+            if not data then
+              p(calls, received)
+              assert(#table.concat(received) == 10 * chunk_size)
+              assert(calls == 1)
+              assert(uv.buffer_pool_configure(stats.size))
+              socket:close()
+              return
+            end
+            calls = calls + 1
+            if mode == "array" then
+              assert(type(data) == "table" and #data == 10)
+              for _, chunk in ipairs(data) do
+                received[#received + 1] = chunk
+              end
+            else
+              assert(type(data) == "string" and #data == 10 * chunk_size)
+              received[#received + 1] = data
+            end
+          end))
+        end))
+      end)))
+    end)
+  end
+
+  -- Serves a single connection that receives chunks one write at a time,
+  -- then shuts down. Calls fn with the port to connect to.
+  local function serve_chunks(uv, expect, chunks, fn)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local client = uv.new_tcp()
+      assert(server:accept(client))
+      for _, chunk in ipairs(chunks) do
+        assert(client:write(chunk))
+      end
+      assert(client:shutdown(expect(function ()
+        client:close()
+        server:close()
+      end)))
+    end)))
+    fn(server:getsockname().port)
+  end
+
+  -- Connects to port and collects the frames read with options until EOF
+  -- or an error, then calls done with them.
+  local function read_frames(uv, expect, port, options, done)
+    local socket = assert(uv.new_tcp())
+    local frames = {}
+    assert(socket:connect("127.0.0.1", port, expect(function ()
+      assert(socket:read_start(options, function (err, data)
+        if err or not data then
+          socket:close()
+          return done(frames, err)
+        end
+        if type(data) == "table" then
+          for _, frame in ipairs(data) do frames[#frames + 1] = frame end
+        else
+          frames[#frames + 1] = data
+        end
+      end))
+    end)))
+    return socket
+  end
+
+  test("tcp delimiter framed reads", function (print, p, expect, uv)
+    serve_chunks(uv, expect, {"one\r\ntw", "o\r", "\n\r\nthree"}, function (port)
+      read_frames(uv, expect, port, {frame = {delimiter = "\r\n"}}, expect(function (frames, err)
+        p(frames)
+        assert(not err, err)
+        assert(#frames == 4)
+        assert(frames[1] == "one" and frames[2] == "two")
+        assert(frames[3] == "" and frames[4] == "three")
+      end))
+    end)
+  end)
+
+  test("tcp length prefixed reads batched as array", function (print, p, expect, uv)
+    local chunks = {"\0\3abc\0", "\0\0\5he", "llo", "\0\9partial"}
+    serve_chunks(uv, expect, chunks, function (port)
+      local options = {frame = {length = "u16be"}, batch = "array"}
+      read_frames(uv, expect, port, options, expect(function (frames, err)
+        p(frames)
+        assert(not err, err)
+        assert(#frames == 3)
+        assert(frames[1] == "abc" and frames[2] == "" and frames[3] == "hello")
+      end))
+    end)
+  end)
+
+  test("tcp framed reads enforce max size", function (print, p, expect, uv)
+    serve_chunks(uv, expect, {"ok\n", "much too long\n"}, function (port)
+      read_frames(uv, expect, port, {frame = {delimiter = "\n", max = 4}}, expect(function (frames, err)
+        p(frames, err)
+        assert(err and err:match("^EMSGSIZE"))
+        assert(#frames == 1 and frames[1] == "ok")
+      end))
+    end)
+  end)
+
+  test("tcp framing can change between frames", function (print, p, expect, uv)
+    serve_chunks(uv, expect, {"HEAD\nBODYBODY"}, function (port)
+      local frames = {}
+      local socket = assert(uv.new_tcp())
+      local function on_read(err, data)
+        assert(not err, err)
+        if not data then
+          p(frames)
+          assert(#frames == 3)
+          assert(frames[1] == "HEAD" and frames[2] == "BODY" and frames[3] == "BODY")
+          socket:close()
+          return
+        end
+        frames[#frames + 1] = data
+        if #frames == 1 then
+          assert(socket:read_start({frame = {size = 4}}, on_read))
+        end
+      end
+      assert(socket:connect("127.0.0.1", port, expect(function ()
+        assert(socket:read_start({frame = {delimiter = "\n"}}, on_read))
+      end)))
+    end)
+  end)
+
+  test("tcp read_stop holds back frames when callbacks are batched", function (print, p, expect, uv)
+    serve_chunks(uv, expect, {"one\ntwo\nthree\n"}, function (port)
+      assert(uv.batch_callbacks(true) == false)
+      local frames = {}
+      local socket = assert(uv.new_tcp())
+      local function on_read(err, data)
+        assert(not err, err)
+        if not data then
+          p(frames)
+          assert(#frames == 3)
+          assert(frames[1] == "one" and frames[2] == "two" and frames[3] == "three")
+          assert(uv.batch_callbacks(false) == true)
+          socket:close()
+          return
+        end
+        frames[#frames + 1] = data
+        if #frames == 1 then
+          assert(socket:read_stop())
+          local timer = uv.new_timer()
+          timer:start(20, 0, expect(function ()
+            timer:close()
+            assert(#frames == 1)
+            assert(socket:read_start({frame = {delimiter = "\n"}}, on_read))
+          end))
+        end
+      end
+      assert(socket:connect("127.0.0.1", port, expect(function ()
+        assert(socket:read_start({frame = {delimiter = "\n"}}, on_read))
+      end)))
+    end)
+  end)
+
+  test("tcp read options can change on a stream that is reading", function (print, p, expect, uv)
+    serve_chunks(uv, expect, {"one\ntwo\n"}, function (port)
+      local socket = assert(uv.new_tcp())
+      local frames = {}
+      assert(socket:connect("127.0.0.1", port, expect(function (err)
+        assert(not err, err)
+        assert(socket:read_start(function ()
+          error("replaced before anything was read")
+        end))
+        -- the stream gets its extra state only after reading started
+        assert(socket:cork())
+        assert(socket:uncork())
+        local sink = uv.new_tcp()
+        local ok, _, name = uv.pipe_streams(socket, sink)
+        assert(not ok and name == "EBUSY", name)
+        sink:close()
+        assert(socket:read_start({frame = {delimiter = "\n"}, batch = "array"}, function (err, data)
+          assert(not err, err)
+          if not data then
+            p(frames)
+            assert(#frames == 2 and frames[1] == "one" and frames[2] == "two")
+            socket:close()
+            return
+          end
+          for _, frame in ipairs(data) do frames[#frames + 1] = frame end
+        end))
+      end)))
+    end)
+  end)
+
+  -- Accepts one connection and calls done with everything read from it
+  local function collect(uv, expect, done)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local client = uv.new_tcp()
+      local chunks = {}
+      assert(server:accept(client))
+      assert(client:read_start(function (err, data)
+        assert(not err, err)
+        if data then
+          chunks[#chunks + 1] = data
+          return
+        end
+        client:close()
+        server:close()
+        done(table.concat(chunks))
+      end))
+    end)))
+    return server:getsockname().port
+  end
+
+  test("tcp corked writes go out together", function (print, p, expect, uv)
+    local port = collect(uv, expect, expect(function (data)
+      assert(data == "headbodytrailer")
+    end))
+    local socket = uv.new_tcp()
+    assert(socket:connect("127.0.0.1", port, expect(function (err)
+      assert(not err, err)
+      local order = {}
+      assert(socket:cork())
+      for _, part in ipairs({"head", "body", "trailer"}) do
+        assert(socket:write(part, expect(function (err)
+          assert(not err, err)
+          order[#order + 1] = part
+        end)))
+      end
+      -- nothing was handed to libuv yet
+      assert(socket:get_write_queue_size() == 0)
+      assert(socket:uncork())
+      assert(socket:shutdown(expect(function ()
+        assert(table.concat(order, ",") == "head,body,trailer")
+        socket:close()
+      end)))
+    end)))
+  end)
+
+  test("tcp auto-corked writes flush at the end of the iteration", function (print, p, expect, uv)
+    local port = collect(uv, expect, expect(function (data)
+      assert(data == "onetwothree")
+    end))
+    local socket = uv.new_tcp()
+    assert(socket:connect("127.0.0.1", port, expect(function (err)
+      assert(not err, err)
+      assert(socket:cork(true))
+      socket:write("one", expect(function (err) assert(not err, err) end))
+      -- only completes once the tick hook has issued the held writes
+      socket:write({"two", "three"}, expect(function (err)
+        assert(not err, err)
+        assert(socket:shutdown(expect(function ()
+          socket:close()
+        end)))
+      end))
+    end)))
+  end)
+
+  test("tcp corked writes are cancelled by close", function (print, p, expect, uv)
+    local port = collect(uv, expect, expect(function (data)
+      assert(data == "")
+    end))
+    local socket = uv.new_tcp()
+    assert(socket:connect("127.0.0.1", port, expect(function (err)
+      assert(not err, err)
+      local closing = false
+      assert(socket:cork())
+      assert(socket:write("held", expect(function (err)
+        -- completed by the loop, not from within close()
+        assert(not closing)
+        assert(err == "ECANCELED", err)
+      end)))
+      closing = true
+      socket:close()
+      closing = false
+      local ok, _, name = socket:write("late", function ()
+        error("write after close must not be queued")
+      end)
+      assert(not ok and name == "EBADF", name)
+    end)))
+  end)
+
+  test("tcp write watermarks report backpressure and drain", function (print, p, expect, uv)
+    local port = collect(uv, expect, expect(function (data)
+      assert(data == "aaaabbbbcccc")
+    end))
+    local socket = uv.new_tcp()
+    assert(not pcall(socket.set_watermarks, socket, 4, 8))
+    assert(socket:connect("127.0.0.1", port, expect(function (err)
+      assert(not err, err)
+      assert(socket:set_watermarks(8, 0, expect(function ()
+        assert(socket:get_write_queue_size() == 0)
+        assert(socket:shutdown(expect(function ()
+          socket:close()
+        end)))
+      end)))
+      -- held writes count towards the queue, so the third one crosses `high`
+      assert(socket:cork())
+      local _, ok = socket:write("aaaa")
+      assert(ok == true)
+      _, ok = socket:write("bbbb")
+      assert(ok == true)
+      _, ok = socket:write("cccc")
+      assert(ok == false)
+      assert(socket:uncork())
+    end)))
+  end)
+
+  test("tcp read idle timeout", function (print, p, expect, uv)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local conn = uv.new_tcp()
+      assert(server:accept(conn))
+      local start = uv.now()
+      assert(conn:read_start(expect(function (err, data)
+        assert(not err, err)
+        assert(data == "ping")
+        start = uv.now()
+      end)))
+      assert(not pcall(conn.set_timeouts, conn, {read_idle = -1}))
+      assert(conn:set_timeouts({read_idle = 50}, expect(function (kind)
+        assert(kind == "read_idle")
+        -- the period started over with the data that arrived
+        assert(uv.now() - start >= 50)
+        conn:close()
+        server:close()
+      end)))
+    end)))
+    local client = uv.new_tcp()
+    assert(client:connect("127.0.0.1", server:getsockname().port, expect(function (err)
+      assert(not err, err)
+      local timer = uv.new_timer()
+      timer:start(20, 0, expect(function ()
+        timer:close()
+        assert(client:write("ping"))
+        assert(client:read_start(expect(function (err, data)
+          assert(not err, err)
+          assert(not data)
+          client:close()
+        end)))
+      end))
+    end)))
+  end)
+
+  test("tcp timeouts without callback close the stream", function (print, p, expect, uv)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local conn = uv.new_tcp()
+      assert(server:accept(conn))
+      assert(conn:read_start(function () end))
+      assert(conn:set_timeouts({read_idle = 20}))
+      server:close()
+    end)))
+    local client = uv.new_tcp()
+    assert(client:connect("127.0.0.1", server:getsockname().port, expect(function (err)
+      assert(not err, err)
+      assert(client:read_start(expect(function (err, data)
+        assert(not err, err)
+        assert(not data)
+        client:close()
+      end)))
+    end)))
+  end)
+
+  test("tcp read idle only counts while reading", function (print, p, expect, uv)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local conn = uv.new_tcp()
+      assert(server:accept(conn))
+      server:close()
+      -- set before reading starts, and nothing is due while stopped
+      local restarted
+      assert(conn:set_timeouts({read_idle = 20}, expect(function (kind)
+        assert(kind == "read_idle")
+        assert(restarted and uv.now() - restarted >= 20)
+        conn:close()
+      end)))
+      local timer = uv.new_timer()
+      timer:start(60, 0, expect(function ()
+        timer:close()
+        assert(conn:read_start(function () end))
+        assert(conn:read_stop())
+        timer = uv.new_timer()
+        timer:start(60, 0, expect(function ()
+          timer:close()
+          restarted = uv.now()
+          assert(conn:read_start(function () end))
+        end))
+      end))
+    end)))
+    local client = uv.new_tcp()
+    assert(client:connect("127.0.0.1", server:getsockname().port, expect(function (err)
+      assert(not err, err)
+      assert(client:read_start(expect(function (err, data)
+        assert(not err, err)
+        assert(not data)
+        client:close()
+      end)))
+    end)))
+  end)
+
+  test("tcp write stall timeout", function (print, p, expect, uv)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local conn = uv.new_tcp()
+      assert(server:accept(conn))
+      assert(conn:set_timeouts({write_stall = 50}, expect(function (kind)
+        assert(kind == "write_stall")
+        assert(conn:get_write_queue_size() > 0)
+        conn:close()
+        server:close()
+      end)))
+      -- more than the socket buffers hold while the client isn't reading
+      assert(conn:write(string.rep("x", 32 * 1024 * 1024), expect(function (err)
+        assert(err == "ECANCELED", err)
+      end)))
+    end)))
+    local client = uv.new_tcp()
+    assert(client:connect("127.0.0.1", server:getsockname().port, expect(function (err)
+      assert(not err, err)
+      local timer = uv.new_timer()
+      timer:start(200, 0, expect(function ()
+        timer:close()
+        client:close()
+      end))
+    end)))
+  end)
+
+  test("tcp pipe_streams relays until EOF and shuts the target down", function (print, p, expect, uv)
+    local payload = string.rep("0123456789abcdef", 64 * 1024)
+    local sink = collect(uv, expect, expect(function (data)
+      assert(data == payload)
+    end))
+    local proxy = uv.new_tcp()
+    assert(proxy:bind("127.0.0.1", 0))
+    assert(proxy:listen(1, expect(function ()
+      local inbound = uv.new_tcp()
+      assert(proxy:accept(inbound))
+      local outbound = uv.new_tcp()
+      assert(outbound:connect("127.0.0.1", sink, expect(function (err)
+        assert(not err, err)
+        -- small watermarks so the relay has to pause and resume
+        assert(uv.pipe_streams(inbound, outbound, {high = 4096, shutdown = true}, expect(function (err, bytes)
+          assert(not err, err)
+          assert(bytes == #payload)
+          inbound:close()
+          outbound:close()
+          proxy:close()
+        end)))
+        local _, _, code = inbound:read_start(function () end)
+        assert(code == "EBUSY")
+      end)))
+    end)))
+    local client = uv.new_tcp()
+    assert(client:connect("127.0.0.1", proxy:getsockname().port, expect(function (err)
+      assert(not err, err)
+      assert(client:write(payload))
+      assert(client:shutdown(expect(function ()
+        client:close()
+      end)))
+    end)))
+  end)
+
+  test("tcp pipe_streams is cancelled by closing the source", function (print, p, expect, uv)
+    local a, b = uv.new_tcp(), uv.new_tcp()
+    assert(not pcall(uv.pipe_streams, a, a))
+    assert(not pcall(uv.pipe_streams, a, b, {high = 8, low = 16}))
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(server:listen(1, expect(function ()
+      local conn = uv.new_tcp()
+      assert(server:accept(conn))
+      assert(uv.pipe_streams(conn, b, nil, expect(function (err, bytes)
+        assert(err == "ECANCELED")
+        assert(bytes == 0)
+        a:close()
+        b:close()
+        server:close()
+      end)))
+      conn:close()
+    end)))
+    assert(a:connect("127.0.0.1", server:getsockname().port, expect(function (err)
+      assert(not err, err)
+    end)))
+  end)
+
+  test("tcp send_file streams a file and holds writes behind it", function (print, p, expect, uv)
+    local fd = assert(uv.fs_open("README.md", "r", tonumber("644", 8)))
+    local size = assert(uv.fs_fstat(fd)).size
+    local content = assert(uv.fs_read(fd, size, 0))
+    local port = collect(uv, expect, expect(function (data)
+      assert(data == content:sub(11) .. "trailer")
+    end))
+    local socket = uv.new_tcp()
+    assert(socket:connect("127.0.0.1", port, expect(function (err)
+      assert(not err, err)
+      -- asks for more than the file has, the transfer stops at EOF
+      assert(socket:send_file(fd, 10, size, expect(function (err, bytes)
+        assert(not err, err)
+        assert(bytes == size - 10)
+        assert(uv.fs_close(fd))
+      end)))
+      local _, _, code = socket:send_file(fd, 0, 1)
+      assert(code == "EBUSY")
+      assert(socket:write("trailer", expect(function (err)
+        assert(not err, err)
+        assert(socket:shutdown(expect(function ()
+          socket:close()
+        end)))
+      end)))
+    end)))
+  end)
+
+  test("tcp send_file waits for writes libuv has queued", function (print, p, expect, uv)
+    local fd = assert(uv.fs_open("README.md", "r", tonumber("644", 8)))
+    local size = assert(uv.fs_fstat(fd)).size
+    local content = assert(uv.fs_read(fd, size, 0))
+    -- large enough to stay in libuv's write queue for a while
+    local header = string.rep("h", 4 * 1024 * 1024)
+    local port = collect(uv, expect, expect(function (data)
+      assert(#data == #header + size)
+      assert(data == header .. content)
+    end))
+    local socket = uv.new_tcp()
+    assert(socket:connect("127.0.0.1", port, expect(function (err)
+      assert(not err, err)
+      assert(socket:write(header, expect(function (err)
+        assert(not err, err)
+      end)))
+      assert(socket:send_file(fd, 0, size, expect(function (err, bytes)
+        assert(not err, err)
+        assert(bytes == size)
+        assert(uv.fs_close(fd))
+        assert(socket:shutdown(expect(function ()
+          socket:close()
+        end)))
+      end)))
+    end)))
+  end)
+
+  test("tcp listen batch accepts connections in C", function (print, p, expect, uv)
+    local server = uv.new_tcp()
+    assert(server:bind("127.0.0.1", 0))
+    assert(not pcall(server.listen, server, 128, {batch = -1}, function () end))
+    assert(not pcall(server.listen, server, 128, {read = function () end}, function () end))
+    local accepted, reads = 0, 0
+    local seen = {}
+    assert(server:listen(128, {batch = 8, read = function (client, err, data)
+      assert(not err, err)
+      if data then
+        assert(data == "hi")
+        assert(seen[client])
+        reads = reads + 1
+        return
+      end
+      client:close()
+      if reads == 3 and not server:is_closing() then server:close() end
+    end}, function (err, clients)
+      assert(not err, err)
+      assert(#clients >= 1 and #clients <= 8)
+      for _, client in ipairs(clients) do
+        assert(client:is_readable())
+        seen[client] = true
+      end
+      accepted = accepted + #clients
+    end))
+    local port = server:getsockname().port
+    for _ = 1, 3 do
+      local client = uv.new_tcp()
+      assert(client:connect("127.0.0.1", port, expect(function (err)
+        assert(not err, err)
+        assert(client:write("hi"))
+        assert(client:shutdown(expect(function ()
+          client:close()
+        end)))
+      end)))
+    end
+    uv.run()
+    assert(accepted == 3)
+    assert(reads == 3)
+  end)
+
+  test("tcp read_start option checks", function (print, p, expect, uv)
+    local tcp = uv.new_tcp()
+    assert(not pcall(tcp.read_start, tcp, {buffer = "nope"}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {buffer = uv.new_buffer(4), offset = 4}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {}, nil))
+    assert(not pcall(tcp.read_start, tcp, {batch = "lines"}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {batch = "string", buffer = uv.new_buffer(4)}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {frame = {}}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {frame = {delimiter = "\n", size = 4}}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {frame = {length = "u24be"}}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {frame = {size = 8, max = 4}}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {frame = {delimiter = ""}}, function () end))
+    assert(not pcall(tcp.read_start, tcp, {frame = {size = 4}, batch = "string"}, function () end))
+    tcp:close()
+  end)
+
+  test("buffer_pool_configure argument checks", function (print, p, expect, uv)
+    assert(not pcall(uv.buffer_pool_configure, 1))
+    assert(not pcall(uv.buffer_pool_configure, nil, -1))
+    local stats = uv.buffer_pool_stats()
+    assert(uv.buffer_pool_configure(stats.size, 0))
+    assert(uv.buffer_pool_stats().cached == 0)
+    assert(uv.buffer_pool_configure(stats.size, stats.max))
+  end)
 end)
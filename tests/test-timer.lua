@@ -115,4 +115,111 @@ return require('lib/tap')(function (test)
     assert(huge_timer:get_due_in()==0xffff)
   end, "1.40.0")
 
+  test("timer wheel", function(print, p, expect, uv)
+    local start = uv.now()
+    local fired = {}
+    local anon
+    local wheel = uv.new_timer_wheel(5, function(expired)
+      for _, value in ipairs(expired) do
+        fired[#fired + 1] = value
+        -- never early
+        assert(value == anon or uv.now() - start >= value)
+      end
+    end)
+    local ids = {}
+    for _, timeout in ipairs({40, 10, 300, 20, 30}) do
+      ids[timeout] = wheel:start(timeout, timeout)
+    end
+    anon = wheel:start(15)
+    assert(wheel:count() == 6)
+    assert(wheel:stop(ids[30]))
+    assert(not wheel:stop(ids[30]))
+    -- pushed out past the others
+    assert(wheel:restart(ids[10], 60))
+    assert(uv.timer_wheel_count(wheel) == 5)
+
+    local timer = uv.new_timer()
+    timer:start(400, 0, expect(function()
+      p(fired)
+      assert(table.concat(fired, ",") == anon .. ",20,40,10,300")
+      assert(wheel:count() == 0)
+      -- ids of expired timers are stale
+      assert(not wheel:restart(anon, 10))
+      timer:close()
+    end))
+  end)
+
+  test("timer wheel close", function(print, p, expect, uv)
+    local wheel = uv.new_timer_wheel(5, function()
+      error("closed wheels don't call back")
+    end)
+    wheel:start(10, "dropped")
+    wheel:close()
+    assert(not pcall(wheel.count, wheel))
+    assert(not pcall(uv.timer_wheel_close, wheel))
+    assert(tostring(wheel):find("uv_timer_wheel"))
+    -- nothing keeps the loop alive, or the loop from closing
+    local timer = uv.new_timer()
+    timer:start(30, 0, expect(function()
+      timer:close()
+    end))
+  end)
+
+  test("timer wheel cascades far timers", function(print, p, expect, uv)
+    -- 1ms ticks put 1500ms in the second level of the wheel
+    local wheel
+    wheel = uv.new_timer_wheel(1, expect(function(expired)
+      assert(#expired == 2 and expired[1] ~= expired[2])
+    end))
+    wheel:start(1500, "a")
+    wheel:start(1500, "b")
+  end)
+
+  test("hrtimer", function(print, p, expect, uv)
+    local timer = uv.new_hrtimer()
+    local start = uv.hrtime()
+    assert(timer:get_due_in() == 0)
+    timer:start(1500000, 0, expect(function(count)
+      local elapsed = uv.hrtime() - start
+      p("timeout", elapsed, count)
+      assert(count == 1)
+      assert(elapsed >= 1500000)
+      assert(timer:get_due_in() == 0)
+      timer:close()
+      assert(not pcall(timer.start, timer, 0, 0, function() end))
+    end))
+    assert(timer:get_due_in() > 0)
+  end)
+
+  test("hrtimer periodic", function(print, p, expect, uv)
+    local timer = uv.new_hrtimer()
+    local period = 2000000
+    local start = uv.hrtime()
+    local ticks = 0
+    local done = expect(function() end)
+    timer:start(period, period, function(count)
+      ticks = ticks + count
+      -- Deadlines stay on the grid however late a callback runs
+      assert(uv.hrtime() - start >= ticks * period)
+      if ticks >= 5 then
+        p("periodic", ticks, uv.hrtime() - start)
+        timer:stop()
+        done()
+      end
+    end)
+  end)
+
+  test("hrtimer stop", function(print, p, expect, uv)
+    local timer = uv.new_hrtimer()
+    timer:start(1000000, 0, function()
+      error("stopped hrtimer fired")
+    end)
+    timer:stop()
+    assert(timer:get_due_in() == 0)
+    local check = uv.new_timer()
+    check:start(10, 0, expect(function()
+      check:close()
+    end))
+  end)
+
 end)